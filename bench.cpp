@@ -0,0 +1,305 @@
+/*
+    MIT License
+
+    Copyright (c) 2020 George Prosser
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+/*
+    Benchmarks for the Quadrillion solver library: the bitboard engine's placement test, in each version the compiler
+    targets, and full solves of a board file with each engine.
+
+    usage: quadrillion_bench [board file] [--filter=TEXT] [--min-time=SECONDS] [--max-boards=N]
+*/
+
+#include "quadrillion.h"
+
+#include <cstdlib>
+#include <memory>
+
+typedef u64 find_free_placements_fn(const u64* Placements, const s32 NumPlacements, const u64 OccupiedMask);
+
+struct placement_kernel
+{
+    const char* Name;
+    find_free_placements_fn* Function;
+};
+
+const placement_kernel PLACEMENT_KERNELS[] =
+{
+    { "FindFreePlacementsScalar", FindFreePlacementsScalar },
+#if defined(__AVX2__)
+    { "FindFreePlacementsAVX2", FindFreePlacementsAVX2 },
+#endif
+#if defined(__AVX512F__)
+    { "FindFreePlacementsAVX512", FindFreePlacementsAVX512 },
+#endif
+};
+
+// a range of placements and the board it's tested against, as the search would see them
+struct placement_query
+{
+    s32 FirstPlacementIdx;
+    s32 NumPlacements;
+    u64 OccupiedMask;
+};
+
+constexpr s32 NUM_PLACEMENT_QUERIES = 4096;
+constexpr s32 PLACEMENT_PADDING = 7; // as in quadrillion.cpp
+
+volatile u64 BenchmarkSink;
+
+// splitmix64, as used by solver::GenerateBoards
+u64 NextQueryRandom(u64& State)
+{
+    u64 Value = (State += 0x9E3779B97F4A7C15ull);
+    Value = (Value ^ (Value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    Value = (Value ^ (Value >> 27)) * 0x94D049BB133111EBull;
+    return Value ^ (Value >> 31);
+}
+
+f64 GetElapsedTimeSec(const std::chrono::steady_clock::time_point Start)
+{
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now() - Start).count();
+}
+
+void PrintResult(const char* Name, const u64 NumIterations, const f64 TimePerIterationSec, const char* Extra)
+{
+    printf("%-40s %12llu %14.1f ns%s%s\n", Name, (unsigned long long)NumIterations, TimePerIterationSec * 1e9,
+        (Extra[0] != '\0') ? " " : "", Extra);
+    fflush(stdout);
+}
+
+bool MatchesFilter(const char* Name, const std::string& Filter)
+{
+    return Filter.empty() || (strstr(Name, Filter.c_str()) != nullptr);
+}
+
+// random ranges of up to 64 placements of 5 balls each, tested against boards that are about half full. returns false
+// if the versions don't all give the same answers
+bool RunPlacementBenchmarks(const std::string& Filter, const f64 MinTimeSec)
+{
+    u64 RandomState = 1;
+    std::vector<u64> Placements;
+    std::vector<placement_query> Queries(NUM_PLACEMENT_QUERIES);
+    for (placement_query& Query : Queries)
+    {
+        // always include a full range, which has no bits to drop at the end
+        Query.FirstPlacementIdx = (s32)Placements.size();
+        Query.NumPlacements = (&Query == &Queries[0]) ? 64 : 1 + (s32)(NextQueryRandom(RandomState) % 64);
+        for (s32 PlacementIdx = 0; PlacementIdx < Query.NumPlacements; PlacementIdx++)
+        {
+            u64 Mask = 0u;
+            for (s32 NumBalls = 0; NumBalls < MAX_BALLS;)
+            {
+                const u64 Ball = 1ull << (NextQueryRandom(RandomState) % 64);
+                NumBalls += (Mask & Ball) ? 0 : 1;
+                Mask |= Ball;
+            }
+            Placements.push_back(Mask);
+        }
+        Query.OccupiedMask = NextQueryRandom(RandomState) & NextQueryRandom(RandomState);
+        Query.OccupiedMask |= NextQueryRandom(RandomState) & NextQueryRandom(RandomState);
+    }
+    Placements.resize(Placements.size() + PLACEMENT_PADDING, ~0ull); // padding that overlaps everything
+
+    // every version must agree with the scalar one
+    bool IsConsistent = true;
+    for (const placement_kernel& Kernel : PLACEMENT_KERNELS)
+    {
+        for (const placement_query& Query : Queries)
+        {
+            const u64* QueryPlacements = Placements.data() + Query.FirstPlacementIdx;
+            const u64 Expected = FindFreePlacementsScalar(QueryPlacements, Query.NumPlacements, Query.OccupiedMask);
+            const u64 Actual = Kernel.Function(QueryPlacements, Query.NumPlacements, Query.OccupiedMask);
+            if (Actual != Expected)
+            {
+                fprintf(stderr, "%s: %d placements against %016llx gave %016llx, expected %016llx\n",
+                    Kernel.Name, Query.NumPlacements, (unsigned long long)Query.OccupiedMask,
+                    (unsigned long long)Actual, (unsigned long long)Expected);
+                IsConsistent = false;
+                break;
+            }
+        }
+    }
+
+    for (const placement_kernel& Kernel : PLACEMENT_KERNELS)
+    {
+        if (!MatchesFilter(Kernel.Name, Filter))
+        {
+            continue;
+        }
+
+        // the results are summed and stored so the calls can't be optimized away
+        u64 NumIterations = 0;
+        u64 Checksum = 0u;
+        f64 ElapsedTimeSec = 0.f;
+        const std::chrono::steady_clock::time_point ClockStart = std::chrono::steady_clock::now();
+        do
+        {
+            for (const placement_query& Query : Queries)
+            {
+                Checksum += Kernel.Function(Placements.data() + Query.FirstPlacementIdx, Query.NumPlacements, Query.OccupiedMask);
+            }
+            NumIterations += NUM_PLACEMENT_QUERIES;
+            ElapsedTimeSec = GetElapsedTimeSec(ClockStart);
+        } while (ElapsedTimeSec < MinTimeSec);
+
+        BenchmarkSink = Checksum;
+        PrintResult(Kernel.Name, NumIterations, ElapsedTimeSec / (f64)NumIterations, "");
+    }
+
+    return IsConsistent;
+}
+
+// solves every board once per iteration with each engine configuration. returns false if a solve fails
+bool RunSolveBenchmarks(
+    const solver& Solver,
+    const std::vector<board>& Boards,
+    const std::string& Filter,
+    const f64 MinTimeSec)
+{
+    struct solve_benchmark
+    {
+        const char* Name;
+        solve_options Options;
+        bool UseCache;
+    };
+
+    std::vector<solve_benchmark> Benchmarks(5);
+    Benchmarks[0].Name = "SolveBitboard";
+    Benchmarks[1].Name = "SolveBitboardCached";
+    Benchmarks[1].UseCache = true;
+    Benchmarks[2].Name = "CountBitboard";
+    Benchmarks[2].Options.CountOnly = true;
+    Benchmarks[3].Name = "SolveExactCover";
+    Benchmarks[3].Options.Engine = search_engine::ExactCover;
+    Benchmarks[4].Name = "SolveGrid";
+    Benchmarks[4].Options.Engine = search_engine::Grid;
+
+    for (solve_benchmark& Benchmark : Benchmarks)
+    {
+        if (!MatchesFilter(Benchmark.Name, Filter))
+        {
+            continue;
+        }
+
+        // the cache is made for each benchmark, so the first iteration searches it cold
+        std::unique_ptr<solution_cache> Cache;
+        if (Benchmark.UseCache)
+        {
+            Cache.reset(new solution_cache(64ull << 20));
+            Benchmark.Options.Cache = Cache.get();
+        }
+
+        u64 NumIterations = 0;
+        u64 NumSolutions = 0;
+        f64 ElapsedTimeSec = 0.f;
+        const std::chrono::steady_clock::time_point ClockStart = std::chrono::steady_clock::now();
+        do
+        {
+            NumSolutions = 0;
+            for (const board& Board : Boards)
+            {
+                solve_result Result;
+                std::string Error;
+                if (!Solver.SolveBoard(Board, Benchmark.Options, nullptr, Result, Error, nullptr))
+                {
+                    fprintf(stderr, "%s: %s\n", Benchmark.Name, Error.c_str());
+                    return false;
+                }
+                NumSolutions += Result.NumSolutions;
+            }
+            NumIterations++;
+            ElapsedTimeSec = GetElapsedTimeSec(ClockStart);
+        } while (ElapsedTimeSec < MinTimeSec);
+
+        char Extra[64];
+        snprintf(Extra, sizeof(Extra), "(%zu boards, %llu solutions)", Boards.size(), (unsigned long long)NumSolutions);
+        PrintResult(Benchmark.Name, NumIterations, ElapsedTimeSec / (f64)NumIterations, Extra);
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    std::string BoardInputFilename;
+    std::string Filter;
+    f64 MinTimeSec = 0.5f;
+    size_t MaxBoards = 0;
+
+    for (s32 ArgIdx = 1; ArgIdx < argc; ArgIdx++)
+    {
+        const std::string Arg = argv[ArgIdx];
+        if (Arg.compare(0, 9, "--filter=") == 0)
+        {
+            Filter = Arg.substr(9);
+        }
+        else if (Arg.compare(0, 11, "--min-time=") == 0)
+        {
+            MinTimeSec = atof(Arg.c_str() + 11);
+        }
+        else if (Arg.compare(0, 13, "--max-boards=") == 0)
+        {
+            MaxBoards = (size_t)atoll(Arg.c_str() + 13);
+        }
+        else if (Arg.compare(0, 2, "--") == 0)
+        {
+            fprintf(stderr, "unknown option '%s'\n", Arg.c_str());
+            return EXIT_FAILURE;
+        }
+        else
+        {
+            BoardInputFilename = Arg;
+        }
+    }
+
+    printf("%-40s %12s %17s\n", "benchmark", "iterations", "time/iteration");
+
+    if (!RunPlacementBenchmarks(Filter, MinTimeSec))
+    {
+        return EXIT_FAILURE;
+    }
+
+    // the solves are only timed if there are boards to solve
+    if (!BoardInputFilename.empty())
+    {
+        const solver Solver;
+        std::vector<board> Boards;
+        std::string Error;
+        if (!LoadBoards(BoardInputFilename, Solver, Boards, Error))
+        {
+            fprintf(stderr, "%s\n", Error.c_str());
+            return EXIT_FAILURE;
+        }
+        if (MaxBoards > 0 && Boards.size() > MaxBoards)
+        {
+            Boards.resize(MaxBoards);
+        }
+
+        if (!RunSolveBenchmarks(Solver, Boards, Filter, MinTimeSec))
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -23,808 +23,1527 @@
 */
 
 /*
-    Solver for Quadrillion puzzle by SmartGames.
-    https://www.smartgamesandpuzzles.com/quadrillion.html
+    Command line front end for the Quadrillion solver library.
 */
 
-#define FAST 1
-#define WITH_STATS !FAST
-
-#if FAST
-#define NDEBUG
+#include "quadrillion.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <csignal>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 #endif
 
-#include <cstdio>
-#include <cstdint>
-#include <vector>
-#include <ctime>
-#include <cassert>
-#include <string>
-
-typedef uint8_t u8;
-typedef uint16_t u16;
-typedef uint32_t u32;
-typedef uint64_t u64;
-typedef int32_t s32;
-typedef float f32;
-typedef double f64;
-
-constexpr s32 MAX_BOARD_SIZE = 16; // max width/height of a puzzle board
-constexpr s32 NUM_VALID_CELLS = 64; // number of valid cells on a puzzle board (4 * 16)
-constexpr s32 NUM_PIECES = 12; // number of puzzle pieces
-constexpr s32 MAX_PIECE_SIZE = 4; // max horizontal/vertical size of piece
-constexpr s32 MAX_BALLS = 5; // max number of 'balls' that make up a piece
-constexpr s32 NUM_ROTATIONS = 4; // 4 x 90 degree rotations
-
-enum cell_value : u8
-{
-    Empty = 0u,
-    Invalid,
-    Blocked,
-    Piece01,
-    Piece02,
-    Piece03,
-    Piece04,
-    Piece05,
-    Piece06,
-    Piece07,
-    Piece08,
-    Piece09,
-    Piece10,
-    Piece11,
-    Piece12
-};
-
-bool IsPiece(const cell_value CellValue)
-{
-    return CellValue >= Piece01 && CellValue <= Piece12;
-}
-
-s32 CellValueToPieceIndex(const cell_value CellValue)
-{
-    return (s32) (CellValue - cell_value::Piece01);
-}
-
-cell_value PieceIndexToCellValue(const s32 PieceIdx)
-{
-    return (cell_value) (cell_value::Piece01 + PieceIdx);
-}
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
 
-char CellValueToOutputChar(const cell_value CellValue)
+const char* EngineNames[] = { "grid", "bitboard", "dlx" };
+const char* SearchStatusNames[] = { "complete", "cancelled", "time limit reached", "state limit reached", "solution limit reached" };
+const char* ServiceStatusNames[] = { "complete", "cancelled", "time-limit", "state-limit", "solution-limit" };
+
+// parses a --serve request: "ID [count|hint] [max-solutions=N] [max-states=N] [time-limit=SEC] : BOARD", where the board is
+// written as in a board file but on one line, with its rows separated by '/'. limits not given are taken from Defaults,
+// and the board is checked against the solver's pieces
+bool ParseServiceRequest(
+    const std::string& Line,
+    const solver& Solver,
+    const solve_service::request& Defaults,
+    solve_service::request& OutRequest,
+    std::string& OutError)
 {
-    switch (CellValue)
-    {
-        case cell_value::Invalid:
-            return ' ';
-        case cell_value::Empty: 
-            return '.';
-        case cell_value::Blocked:
-            return '*';
-        case cell_value::Piece01:
-        case cell_value::Piece02:
-        case cell_value::Piece03:
-        case cell_value::Piece04:
-        case cell_value::Piece05:
-        case cell_value::Piece06:
-        case cell_value::Piece07:
-        case cell_value::Piece08:
-        case cell_value::Piece09:
-        case cell_value::Piece10:
-        case cell_value::Piece11:
-        case cell_value::Piece12:
-            return 'A' + CellValueToPieceIndex(CellValue);
-        default:
-            assert(false);
-            return '?';
-    }
-}
+    OutRequest = Defaults;
 
-cell_value InputCharToCellValue(const char InputChar)
-{
-    switch (InputChar)
-    {
-        case ' ':
-            return cell_value::Invalid;
-        case '.':
-            return cell_value::Empty;
-        case '*':
-            return cell_value::Blocked;
-        case 'A':
-        case 'B':
-        case 'C':
-        case 'D':
-        case 'E':
-        case 'F':
-        case 'G':
-        case 'H':
-        case 'I':
-        case 'J':
-        case 'K':
-        case 'L':
-            return PieceIndexToCellValue(InputChar - 'A');
-        default:
-            assert(false);
-            return cell_value::Invalid;
+    const size_t BoardBegin = Line.find(':');
+    if (BoardBegin == std::string::npos)
+    {
+        OutError = "expected ':' before the board";
+        return false;
     }
-}
-
-struct piece_definition
-{
-    u8 Balls[MAX_PIECE_SIZE][MAX_PIECE_SIZE];
-};
-
-struct board
-{
-    cell_value Cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE];
-};
 
-void SetCells(board& Board, const cell_value CellValue)
-{
-    for (s32 RowIdx = 0; RowIdx < MAX_BOARD_SIZE; RowIdx++)
+    std::vector<std::string> Fields;
+    for (size_t FieldBegin = 0; FieldBegin < BoardBegin; )
     {
-        for (s32 ColIdx = 0; ColIdx < MAX_BOARD_SIZE; ColIdx++)
+        const size_t FieldEnd = std::min(Line.find(' ', FieldBegin), BoardBegin);
+        if (FieldEnd > FieldBegin)
         {
-            Board.Cells[RowIdx][ColIdx] = CellValue;
+            Fields.push_back(Line.substr(FieldBegin, FieldEnd - FieldBegin));
         }
+        FieldBegin = FieldEnd + 1;
     }
-}
 
-void PrintBoard(const board& Board, const s32 NumRows = MAX_BOARD_SIZE, const s32 NumCols = MAX_BOARD_SIZE)
-{
-    for (s32 RowIdx = 0; RowIdx < NumRows; RowIdx++)
+    if (Fields.empty() || Fields[0].find_first_not_of("0123456789") != std::string::npos)
     {
-        for (s32 ColIdx = 0; ColIdx < NumCols; ColIdx++)
-        {
-            printf("%c", CellValueToOutputChar(Board.Cells[RowIdx][ColIdx]));
-        }
-        printf("\n");
+        OutError = "expected a numeric request id";
+        return false;
     }
-}
+    OutRequest.Id = strtoull(Fields[0].c_str(), nullptr, 10);
 
-void Rotate(const piece_definition& From, piece_definition& To)
-{
-    // rotate clockwise by 90 degrees
-    for (s32 fromRowIdx = 0; fromRowIdx < MAX_PIECE_SIZE; fromRowIdx++)
+    for (size_t FieldIdx = 1; FieldIdx < Fields.size(); FieldIdx++)
     {
-        for (s32 fromColIdx = 0; fromColIdx < MAX_PIECE_SIZE; fromColIdx++)
+        const std::string& Field = Fields[FieldIdx];
+        if (Field == "count")
         {
-            To.Balls[fromColIdx][(MAX_PIECE_SIZE - 1) - fromRowIdx] = From.Balls[fromRowIdx][fromColIdx];
+            OutRequest.CountOnly = true;
         }
-    }
-}
-
-void Flip(const piece_definition& From, piece_definition& To)
-{
-    // flip vertically
-    for (s32 fromRowIdx = 0; fromRowIdx < MAX_PIECE_SIZE; fromRowIdx++)
-    {
-        for (s32 fromColIdx = 0; fromColIdx < MAX_PIECE_SIZE; fromColIdx++)
+        else if (Field == "hint")
+        {
+            OutRequest.Hint = true;
+        }
+        else if (Field.compare(0, 14, "max-solutions=") == 0)
+        {
+            OutRequest.MaxSolutions = strtoull(Field.c_str() + 14, nullptr, 10);
+        }
+        else if (Field.compare(0, 11, "max-states=") == 0)
+        {
+            OutRequest.MaxBoardStates = strtoull(Field.c_str() + 11, nullptr, 10);
+        }
+        else if (Field.compare(0, 11, "time-limit=") == 0)
+        {
+            OutRequest.MaxTimeSec = atof(Field.c_str() + 11);
+        }
+        else
         {
-            To.Balls[(MAX_PIECE_SIZE - 1) - fromRowIdx][fromColIdx] = From.Balls[fromRowIdx][fromColIdx];
+            OutError = "unknown option '" + Field + "'";
+            return false;
         }
     }
+
+    std::string BoardText = Line.substr(BoardBegin + 1);
+    std::replace(BoardText.begin(), BoardText.end(), '/', '\n');
+    return ParseBoard(BoardText, Solver, OutRequest.Board, OutError);
 }
 
-void PushUpAndLeft(piece_definition& Definition)
+// one client of --serve, which sends requests one per line and is sent back a line for each solution as it's found
+// (or the suggestion, for a hint), then one for the result: "ID solution BOARD" or "ID suggestion BOARD", then
+// "ID done SOLUTIONS STATUS SECONDS" or "ID error MESSAGE". the
+// connection waits for the answers to all its requests before it's closed
+struct service_connection : solve_service::responder
 {
-    // find the first row and column with a set bit
-    s32 MinRowIdx = MAX_PIECE_SIZE - 1;
-    s32 MinColIdx = MAX_PIECE_SIZE - 1;
-    for (s32 RowIdx = 0; RowIdx < MAX_PIECE_SIZE; RowIdx++)
-    {
-        for (s32 ColIdx = 0; ColIdx < MAX_PIECE_SIZE; ColIdx++)
-        {
-            if (Definition.Balls[RowIdx][ColIdx])
-            {
-                if (RowIdx <= MinRowIdx)
-                {
-                    MinRowIdx = RowIdx;
-                }
+    FILE* In;
+    FILE* Out;
 
-                if (ColIdx <= MinColIdx)
-                {
-                    MinColIdx = ColIdx;
-                }
-            }
-        }
-    }
+    std::mutex OutLock;
+    std::mutex PendingLock;
+    std::condition_variable PendingChanged;
+    u64 NumPending = 0;
 
-    // shift set bits up and to the left as much as possible
-    for (s32 RowIdx = MinRowIdx; RowIdx < MAX_PIECE_SIZE; RowIdx++)
+    service_connection(FILE* InFile, FILE* OutFile) : In(InFile), Out(OutFile) {}
+
+    void WriteLine(const std::string& Line)
     {
-        for (s32 ColIdx = MinColIdx; ColIdx < MAX_PIECE_SIZE; ColIdx++)
-        {
-            Definition.Balls[RowIdx - MinRowIdx][ColIdx - MinColIdx] = Definition.Balls[RowIdx][ColIdx];
-        }
+        std::lock_guard<std::mutex> Lock(OutLock);
+        fwrite(Line.data(), 1, Line.size(), Out);
+        fflush(Out);
     }
 
-    // clear remaining bits
-    for (s32 RowIdx = MAX_PIECE_SIZE - MinRowIdx; RowIdx < MAX_PIECE_SIZE; RowIdx++)
+    void WriteBoardLine(const u64 RequestId, const char* Kind, const board& Board, const s32 NumRows, const s32 NumCols)
     {
-        for (s32 ColIdx = 0; ColIdx < MAX_PIECE_SIZE; ColIdx++)
-        {
-            Definition.Balls[RowIdx][ColIdx] = 0;
-        }
+        char Text[MAX_BOARD_TEXT_SIZE];
+        const s32 Length = FormatBoard(Board, NumRows, NumCols, Text);
+        std::string Line = std::to_string(RequestId) + " " + Kind + " " + std::string(Text, Length - 1) + "\n";
+        std::replace(Line.begin(), Line.end() - 1, '\n', '/');
+        WriteLine(Line);
     }
 
-    for (s32 ColIdx = MAX_PIECE_SIZE - MinColIdx; ColIdx < MAX_PIECE_SIZE; ColIdx++)
+    void OnSolution(const u64 RequestId, const board& Solution, const s32 NumRows, const s32 NumCols) override
     {
-        for (s32 RowIdx = 0; RowIdx < MAX_PIECE_SIZE; RowIdx++)
-        {
-            Definition.Balls[RowIdx][ColIdx] = 0;
-        }
+        WriteBoardLine(RequestId, "solution", Solution, NumRows, NumCols);
     }
-}
 
-u32 ComputePackedRepresentation(piece_definition& Definition)
-{
-    u32 Packed = 0;
-    for (s32 RowIdx = 0; RowIdx < MAX_PIECE_SIZE; RowIdx++)
+    void OnSuggestion(const u64 RequestId, const board& Suggestion, const s32 NumRows, const s32 NumCols) override
     {
-        for (s32 ColIdx = 0; ColIdx < MAX_PIECE_SIZE; ColIdx++)
-        {
-            Packed <<= 1;
-            Packed |= Definition.Balls[RowIdx][ColIdx];
-        }
+        WriteBoardLine(RequestId, "suggestion", Suggestion, NumRows, NumCols);
     }
-    return Packed;
-}
 
-struct solver
-{
-private:
-    struct cell_ref
+    void OnResult(const u64 RequestId, const solve_result& Result, const std::string& Error) override
     {
-        u8 RowIdx, ColIdx;
-    };
+        char Line[256];
+        if (Error.empty())
+        {
+            snprintf(Line, sizeof(Line), "%llu done %llu %s %.6f\n", RequestId, Result.NumSolutions, ServiceStatusNames[Result.Status], Result.ElapsedTimeSec);
+        }
+        else
+        {
+            snprintf(Line, sizeof(Line), "%llu error %s\n", RequestId, Error.c_str());
+        }
+        WriteLine(Line);
 
-    struct piece_orientation
-    {
-        cell_ref Balls[MAX_BALLS];
-    };
+        // notify while holding the lock, as the connection may be freed as soon as the last answer is written
+        std::lock_guard<std::mutex> Lock(PendingLock);
+        NumPending--;
+        PendingChanged.notify_all();
+    }
 
-    struct search_piece
+    void Run(solve_service& Service, const solver& Solver, const solve_service::request& Defaults)
     {
-        piece_orientation Orientations[2 * NUM_ROTATIONS];
-        s32 NumOrientations;
-        s32 NumBalls;
-    };
-
-    search_piece SearchPieces[NUM_PIECES];
+        std::string Line;
+        for (s32 Char = fgetc(In); Char != EOF; Char = fgetc(In))
+        {
+            if (Char != '\n')
+            {
+                Line.push_back((char)Char);
+                continue;
+            }
+            if (!Line.empty() && Line.back() == '\r')
+            {
+                Line.pop_back();
+            }
 
-public:
-    void Initialize(const piece_definition (&Pieces)[NUM_PIECES]);
+            if (!Line.empty())
+            {
+                solve_service::request Request;
+                std::string Error;
+                if (ParseServiceRequest(Line, Solver, Defaults, Request, Error))
+                {
+                    {
+                        std::lock_guard<std::mutex> Lock(PendingLock);
+                        NumPending++;
+                    }
+                    Request.Responder = this;
+                    Service.Submit(Request);
+                }
+                else
+                {
+                    WriteLine(Line.substr(0, Line.find(' ')) + " error " + Error + "\n");
+                }
+            }
+            Line.clear();
+        }
 
-    void Solve(
-        const board& InputBoard,
-        const s32 NumRows,
-        const s32 NumCols,
-        std::vector<board>& OutSolutions,
-        u64& OutNumBoardStatesTested,
-        u64& OutNumOrientationsTested,
-        u64& OutNumBallsTested) const;
+        std::unique_lock<std::mutex> Lock(PendingLock);
+        PendingChanged.wait(Lock, [this]() { return NumPending == 0; });
+    }
 };
 
-void solver::Initialize(const piece_definition (&Pieces)[NUM_PIECES])
+#if !defined(_WIN32)
+// listens on "unix:PATH" or "tcp:PORT" (on the loopback address only), serving each connection on its own thread.
+// only returns, with OutError set, if the socket can't be set up
+bool ServeSocket(
+    const std::string& Address,
+    solve_service& Service,
+    const solver& Solver,
+    const solve_service::request& Defaults,
+    std::string& OutError)
 {
-    // expand each piece out into its orientations
-    struct expanded_representation
-    {
-        piece_definition Definition;
-        u32 Packed;
-    };
-
-    expanded_representation PieceOrientations[NUM_PIECES][2 * NUM_ROTATIONS];
+    // a client that disconnects early shouldn't stop the server
+    signal(SIGPIPE, SIG_IGN);
 
-    for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+    s32 ListenFd = -1;
+    if (Address.compare(0, 5, "unix:") == 0)
     {
-        // orientation 0 is unchanged
-        PieceOrientations[PieceIdx][0].Definition = Pieces[PieceIdx];
-
-        // repeatedly rotate by 90 to get orientations 1, 2, 3
-        for (s32 OrientationIdx = 0; OrientationIdx < NUM_ROTATIONS - 1; OrientationIdx++)
+        sockaddr_un SocketAddress = {};
+        SocketAddress.sun_family = AF_UNIX;
+        const std::string Path = Address.substr(5);
+        if (Path.empty() || Path.size() >= sizeof(SocketAddress.sun_path))
         {
-            Rotate(PieceOrientations[PieceIdx][OrientationIdx].Definition, PieceOrientations[PieceIdx][OrientationIdx + 1].Definition);
+            OutError = "bad socket path '" + Path + "'";
+            return false;
         }
+        strcpy(SocketAddress.sun_path, Path.c_str());
+        unlink(Path.c_str());
 
-        // orientation 4 is orientation 0, flipped vertically
-        Flip(PieceOrientations[PieceIdx][0].Definition, PieceOrientations[PieceIdx][NUM_ROTATIONS].Definition);
-
-        // repeatedly rotate by 90 to get orientations 5, 6, 7
-        for (s32 OrientationIdx = 0; OrientationIdx < NUM_ROTATIONS - 1; OrientationIdx++)
+        ListenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (ListenFd < 0 || bind(ListenFd, (const sockaddr*)&SocketAddress, sizeof(SocketAddress)) != 0)
         {
-            Rotate(PieceOrientations[PieceIdx][NUM_ROTATIONS + OrientationIdx].Definition, PieceOrientations[PieceIdx][NUM_ROTATIONS + OrientationIdx + 1].Definition);
+            OutError = "can't bind to '" + Path + "': " + strerror(errno);
+            return false;
         }
     }
-
-    // move the set bits up and to the left as far as possible
-    for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+    else if (Address.compare(0, 4, "tcp:") == 0)
     {
-        for (s32 OrientationIdx = 0; OrientationIdx < 2 * NUM_ROTATIONS; OrientationIdx++)
+        sockaddr_in SocketAddress = {};
+        SocketAddress.sin_family = AF_INET;
+        SocketAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        SocketAddress.sin_port = htons((u16)atoi(Address.c_str() + 4));
+
+        ListenFd = socket(AF_INET, SOCK_STREAM, 0);
+        const int ReuseAddress = 1;
+        setsockopt(ListenFd, SOL_SOCKET, SO_REUSEADDR, &ReuseAddress, sizeof(ReuseAddress));
+        if (ListenFd < 0 || bind(ListenFd, (const sockaddr*)&SocketAddress, sizeof(SocketAddress)) != 0)
         {
-            PushUpAndLeft(PieceOrientations[PieceIdx][OrientationIdx].Definition);
+            OutError = "can't bind to port " + Address.substr(4) + ": " + strerror(errno);
+            return false;
         }
     }
-
-    // store a packed representation of each orientation to aid de-duplication
-    for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+    else
     {
-        for (s32 OrientationIdx = 0; OrientationIdx < 2 * NUM_ROTATIONS; OrientationIdx++)
-        {
-            PieceOrientations[PieceIdx][OrientationIdx].Packed = ComputePackedRepresentation(PieceOrientations[PieceIdx][OrientationIdx].Definition);
-        }
+        OutError = "expected unix:PATH or tcp:PORT, not '" + Address + "'";
+        return false;
     }
 
-
-    // convert from list of all orientations into a list of unique orientations
-    struct intermediate_representation
+    if (listen(ListenFd, 64) != 0)
     {
-        expanded_representation Orientations[2 * NUM_ROTATIONS];
-        u8 NumOrientations;
-    };
-
-    intermediate_representation IntermediatePieces[NUM_PIECES];
+        OutError = std::string("can't listen: ") + strerror(errno);
+        return false;
+    }
 
-    for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+    while (1)
     {
-        intermediate_representation& IntermediatePiece = IntermediatePieces[PieceIdx];
-        IntermediatePiece.NumOrientations = 0;
-        for (s32 OrientationIdx = 0; OrientationIdx < 2 * NUM_ROTATIONS; OrientationIdx++)
+        const s32 ConnectionFd = accept(ListenFd, nullptr, nullptr);
+        if (ConnectionFd < 0)
         {
-            const expanded_representation& Orientation = PieceOrientations[PieceIdx][OrientationIdx];
+            continue;
+        }
 
-            bool IsOrientationUnique = true;
-            for (s32 OtherOrientationIdx = 0; OtherOrientationIdx < IntermediatePiece.NumOrientations; OtherOrientationIdx++)
+        std::thread([&Service, &Solver, &Defaults, ConnectionFd]()
+        {
+            FILE* In = fdopen(ConnectionFd, "rb");
+            FILE* Out = In ? fdopen(dup(ConnectionFd), "wb") : nullptr;
+            if (Out)
             {
-                const expanded_representation& OtherOrientation = IntermediatePiece.Orientations[OtherOrientationIdx];
-                if (Orientation.Packed == OtherOrientation.Packed)
-                {
-                    IsOrientationUnique = false;
-                    break;
-                }
+                service_connection Connection(In, Out);
+                Connection.Run(Service, Solver, Defaults);
+                fclose(Out);
             }
-
-            if (IsOrientationUnique)
+            if (In)
             {
-                IntermediatePiece.Orientations[IntermediatePiece.NumOrientations++] = Orientation;
+                fclose(In);
             }
-        }
-    }
-
-
-    // convert from intermediate representation to the representation used for searching
-    for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
-    {
-        intermediate_representation& IntermediatePiece = IntermediatePieces[PieceIdx];
-        search_piece& SearchPiece = SearchPieces[PieceIdx];
-        SearchPiece.NumOrientations = IntermediatePiece.NumOrientations;
-
-        for (s32 OrientationIdx = 0; OrientationIdx < IntermediatePiece.NumOrientations; OrientationIdx++)
-        {
-            SearchPiece.NumBalls = 0;
-            piece_orientation& SearchOrientation = SearchPiece.Orientations[OrientationIdx];
-            expanded_representation& IntermediateOrientation = IntermediatePiece.Orientations[OrientationIdx];
-            for (s32 RowIdx = 0; RowIdx < MAX_PIECE_SIZE; RowIdx++)
+            else
             {
-                for (s32 ColIdx = 0; ColIdx < MAX_PIECE_SIZE; ColIdx++)
-                {
-                    if (IntermediateOrientation.Definition.Balls[RowIdx][ColIdx])
-                    {
-                        // store the row and column of each ball that makes up this piece
-                        cell_ref& CellRef = SearchOrientation.Balls[SearchPiece.NumBalls++];
-                        CellRef.RowIdx = (u8)RowIdx;
-                        CellRef.ColIdx = (u8)ColIdx;
-                    }
-                }
+                close(ConnectionFd);
             }
-        }
+        }).detach();
     }
 }
+#endif
 
-
-void solver::Solve(
-    const board& InputBoard,
-    const s32 NumRows,
-    const s32 NumCols,
-    std::vector<board>& OutSolutions,
-    u64& OutNumBoardStatesTested,
-    u64& OutNumOrientationsTested,
-    u64& OutNumBallsTested) const
+// hardware counters for this process, from Linux perf events (user space only, so they work without extra privileges).
+// each one counts the thread that opened it and every thread that thread starts afterwards, but a thread's counts are
+// only added in once it exits. the solves join their threads before they return, so reading the counters around a
+// solve covers every thread it used
+struct perf_counters
 {
-    // pre-compute the empty cells
-    cell_ref InputBoardEmptyCells[NUM_VALID_CELLS];
-    s32 InputBoardNumEmptyCells = 0;
+    static constexpr s32 NUM_COUNTERS = 5;
+
+    s32 Fds[NUM_COUNTERS] = { -1, -1, -1, -1, -1 }; // -1 if the counter isn't supported
+
+    ~perf_counters()
     {
-        for (s32 RowIdx = 0; RowIdx < MAX_BOARD_SIZE; RowIdx++)
+#if defined(__linux__)
+        for (const s32 Fd : Fds)
         {
-            for (s32 ColIdx = 0; ColIdx < MAX_BOARD_SIZE; ColIdx++)
+            if (Fd >= 0)
             {
-                if (InputBoard.Cells[RowIdx][ColIdx] == cell_value::Empty)
-                {
-                    cell_ref& CellRef = InputBoardEmptyCells[InputBoardNumEmptyCells++];
-                    CellRef.RowIdx = RowIdx;
-                    CellRef.ColIdx = ColIdx;
-                }
+                close(Fd);
             }
         }
+#endif
     }
 
-    struct search_state
-    {
-        board Board;
-        u16 RemainingPieceBitFlags : NUM_PIECES;
-        u8 EmptyCellIdx;
-    };
-
-    // construct the initial search state
-    search_state InitialSearchState;
+    // fails if none of the counters could be opened
+    bool Open(std::string& OutError)
     {
-        InitialSearchState.Board = InputBoard;
-        InitialSearchState.EmptyCellIdx = 0;
-
-        InitialSearchState.RemainingPieceBitFlags = 0u;
-        for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+#if defined(__linux__)
+        const u32 Types[NUM_COUNTERS] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE };
+        const u64 Configs[NUM_COUNTERS] =
         {
-            InitialSearchState.RemainingPieceBitFlags |= (1u << PieceIdx);
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_BRANCH_MISSES,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_HW_CACHE_MISSES, // the last level cache, on most CPUs
+        };
+
+        s32 FirstErrno = 0;
+        for (s32 CounterIdx = 0; CounterIdx < NUM_COUNTERS; CounterIdx++)
+        {
+            perf_event_attr Attr;
+            memset(&Attr, 0, sizeof(Attr));
+            Attr.size = sizeof(Attr);
+            Attr.type = Types[CounterIdx];
+            Attr.config = Configs[CounterIdx];
+            Attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            Attr.inherit = 1;
+            Attr.exclude_kernel = 1;
+            Attr.exclude_hv = 1;
+
+            Fds[CounterIdx] = (s32)syscall(SYS_perf_event_open, &Attr, 0, -1, -1, 0);
+            if (Fds[CounterIdx] < 0 && !FirstErrno)
+            {
+                FirstErrno = errno;
+            }
         }
 
-        for (s32 RowIdx = 0; RowIdx < NumRows; RowIdx++)
+        for (const s32 Fd : Fds)
         {
-            for (s32 ColIdx = 0; ColIdx < NumCols; ColIdx++)
+            if (Fd >= 0)
             {
-                const cell_value CellValue = InputBoard.Cells[RowIdx][ColIdx];
-                if (IsPiece(CellValue))
-                {
-                    const s32 PieceIdx = CellValueToPieceIndex(CellValue);
-                    InitialSearchState.RemainingPieceBitFlags &= ~(1u << PieceIdx);
-                }
+                return true;
             }
         }
-    }
-
-#if WITH_STATS
-    OutNumOrientationsTested = 0;
-    OutNumBoardStatesTested = 0;
-    OutNumBallsTested = 0;
+        OutError = std::string("couldn't open any perf counters: ") + strerror(FirstErrno);
+        return false;
+#else
+        OutError = "perf counters are only supported on Linux";
+        return false;
 #endif
+    }
 
-    OutSolutions.clear();
-    OutSolutions.reserve(1024);
-
-    std::vector<search_state> SearchStates;
-    SearchStates.reserve(1024);
-    SearchStates.push_back(InitialSearchState);
-
-    while (!SearchStates.empty())
+    // counts since the counters were opened, scaled up if the kernel had to share the hardware between them. counters
+    // that aren't supported read as 0
+    void Read(u64 (&OutCounts)[NUM_COUNTERS]) const
     {
-#if WITH_STATS
-        OutNumBoardStatesTested++;
-#endif
-        search_state SearchState = SearchStates.back();
-        SearchStates.pop_back();
-
-        // find the next empty cell on the board
-        s32 EmptyCellIdx;
-        s32 RowIdx, ColIdx;
-
-        for (EmptyCellIdx = SearchState.EmptyCellIdx; EmptyCellIdx < InputBoardNumEmptyCells; EmptyCellIdx++)
+        for (s32 CounterIdx = 0; CounterIdx < NUM_COUNTERS; CounterIdx++)
         {
-            cell_ref Cell = InputBoardEmptyCells[EmptyCellIdx];
-            if (SearchState.Board.Cells[Cell.RowIdx][Cell.ColIdx] == cell_value::Empty)
+            OutCounts[CounterIdx] = 0;
+#if defined(__linux__)
+            u64 Values[3]; // count, time enabled, time running
+            if (Fds[CounterIdx] >= 0 && read(Fds[CounterIdx], Values, sizeof(Values)) == sizeof(Values) && Values[2] > 0)
             {
-                RowIdx = (s32)Cell.RowIdx;
-                ColIdx = (s32)Cell.ColIdx;
-                break;
+                OutCounts[CounterIdx] = (Values[2] < Values[1]) ? (u64)((f64)Values[0] * ((f64)Values[1] / (f64)Values[2])) : Values[0];
             }
+#endif
         }
+    }
 
-        assert(EmptyCellIdx < InputBoardNumEmptyCells);
+    // prints the counts between two reads
+    void Print(const char* Label, const u64 (&BeginCounts)[NUM_COUNTERS], const u64 (&EndCounts)[NUM_COUNTERS]) const
+    {
+        const char* Names[NUM_COUNTERS] = { "cycles", "instructions", "branch misses", "L1d read misses", "LLC misses" };
 
-        // determine which pieces are available
-        s32 RemainingPieceIdxs[NUM_PIECES];
-        s32 NumRemainingPieces = 0;
-        for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+        u64 Counts[NUM_COUNTERS];
+        printf("%s:", Label);
+        for (s32 CounterIdx = 0; CounterIdx < NUM_COUNTERS; CounterIdx++)
         {
-            if ((SearchState.RemainingPieceBitFlags >> PieceIdx) & 1u)
+            Counts[CounterIdx] = EndCounts[CounterIdx] - BeginCounts[CounterIdx];
+            if (Fds[CounterIdx] >= 0)
             {
-                RemainingPieceIdxs[NumRemainingPieces++] = PieceIdx;
+                printf("%s %llu %s", (CounterIdx > 0) ? "," : "", Counts[CounterIdx], Names[CounterIdx]);
             }
         }
-
-        const bool IsLastPiece = (NumRemainingPieces == 1);
-
-        // try to fill the empty cell with every available piece...
-        for (s32 RemainingIdx = 0; RemainingIdx < NumRemainingPieces; RemainingIdx++)
+        if (Fds[0] >= 0 && Fds[1] >= 0 && Counts[0] > 0)
         {
-            const s32 PieceIdx = RemainingPieceIdxs[RemainingIdx];
-            const search_piece& Piece = SearchPieces[PieceIdx];
-
-            // ... in every orientation ...
-            for (s32 OrientationIdx = 0; OrientationIdx < Piece.NumOrientations; OrientationIdx++)
-            {
-                const piece_orientation& Orientation = Piece.Orientations[OrientationIdx];
-
-                // ... with every ball of that piece
-                for (s32 PlacedBallIdx = 0; PlacedBallIdx < Piece.NumBalls; PlacedBallIdx++)
-                {
-                    const s32 OffsetRowIdx = -Orientation.Balls[PlacedBallIdx].RowIdx;
-                    const s32 OffsetColIdx = -Orientation.Balls[PlacedBallIdx].ColIdx;
-#if WITH_STATS
-                    OutNumOrientationsTested++;
-#endif
-                    bool CanPlace = true;
-                    for (s32 TestBallIdx = 0; TestBallIdx < Piece.NumBalls; TestBallIdx++)
-                    {
-#if WITH_STATS
-                        OutNumBallsTested++;
-#endif
-                        const s32 BallRowIdx = RowIdx + OffsetRowIdx + Orientation.Balls[TestBallIdx].RowIdx;
-                        const s32 BallColIdx = ColIdx + OffsetColIdx + Orientation.Balls[TestBallIdx].ColIdx;
-                        const bool IsValidCellIdx = (BallRowIdx >= 0) && (BallRowIdx < NumRows) && (BallColIdx >= 0) && (BallColIdx < NumCols);
-
-                        if (!(IsValidCellIdx && SearchState.Board.Cells[BallRowIdx][BallColIdx] == cell_value::Empty))
-                        {
-                            CanPlace = false;
-                            break;
-                        }
-                    }
-
-                    if (CanPlace)
-                    {
-                        search_state NewSearchState = SearchState;
-
-                        const cell_value NewCellValue = PieceIndexToCellValue(PieceIdx);
-                        for (s32 BallIdx = 0; BallIdx < Piece.NumBalls; BallIdx++)
-                        {
-                            const s32 BallRowIdx = RowIdx + OffsetRowIdx + Orientation.Balls[BallIdx].RowIdx;
-                            const s32 BallColIdx = ColIdx + OffsetColIdx + Orientation.Balls[BallIdx].ColIdx;
-                            NewSearchState.Board.Cells[BallRowIdx][BallColIdx] = NewCellValue;
-                        }
-                        NewSearchState.RemainingPieceBitFlags &= ~(1u << PieceIdx);
-                        NewSearchState.EmptyCellIdx++;
-
-                        if (!IsLastPiece)
-                        {
-                            SearchStates.push_back(NewSearchState);
-                        }
-                        else
-                        {
-                            OutSolutions.push_back(NewSearchState.Board);
-                        }
-                    }
-                }
-            }
+            printf(" (%.2f instructions per cycle)", (f64)Counts[1] / (f64)Counts[0]);
         }
+        printf("\n");
     }
-}
+};
 
-int main(int argc, char* argv[])
+struct stat_data
 {
-    std::string PieceInputFilename = "pieces.txt";
-    std::string BoardInputFilename = "boards.txt";
+    search_stats Stats; // only filled in with --stats
+    u64 NumSolutions = 0;
+    f64 ElapsedTimeSec = 0.f; // median, when benchmarking
+    f64 MinElapsedTimeSec = 0.f;
+    f64 P95ElapsedTimeSec = 0.f;
+    u64 SolutionDigest = 0; // only computed with --verify or --write-golden, and not with --count-only
+};
+
+// the expected results of one board, for --verify
+struct golden_result
+{
+    u64 NumSolutions;
+    u64 SolutionDigest; // see digest_solution_sink
+};
 
-    if (argc >= 2)
+// golden files have one line per board, in the order of the board file: the board number, its solution count and its
+// solution digest in hex. lines starting with '#' are comments
+bool LoadGoldenResults(const std::string& Filename, std::vector<golden_result>& OutResults, std::string& OutError)
+{
+    FILE* InputFilePtr = fopen(Filename.c_str(), "rb");
+    if (InputFilePtr == NULL)
     {
-        // override board input filename by command line
-        BoardInputFilename = argv[1];
+        OutError = "can't open '" + Filename + "' for reading";
+        return false;
     }
 
-    // read piece definitions from input
-    piece_definition PieceDefinitions[NUM_PIECES];
+    OutResults.clear();
+    char Line[256];
+    s32 LineIdx = 0;
+    while (fgets(Line, sizeof(Line), InputFilePtr))
     {
-        printf("reading pieces from '%s'... ", PieceInputFilename.c_str());
-        fflush(stdout);
-        FILE* PieceInputFilePtr = fopen(PieceInputFilename.c_str(), "rb");
-        assert(PieceInputFilePtr != NULL);
-
-        for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+        LineIdx++;
+        if (Line[0] == '#' || Line[0] == '\n' || Line[0] == '\r')
         {
-            for (s32 bitRowIdx = 0; bitRowIdx < MAX_PIECE_SIZE; bitRowIdx++)
-            {
-                for (s32 bitColIdx = 0; bitColIdx < MAX_PIECE_SIZE; bitColIdx++)
-                {
-                    s32 InputBit;
-                    const s32 Result = fscanf(PieceInputFilePtr, "%d", &InputBit);
-                    assert(Result == 1);
-                    PieceDefinitions[PieceIdx].Balls[bitRowIdx][bitColIdx] = (u8)InputBit;
-                }
-            }
+            continue;
         }
 
-        fclose(PieceInputFilePtr);
-        printf("done\n");
+        unsigned long long BoardNumber, NumSolutions, SolutionDigest;
+        if (sscanf(Line, "%llu %llu %llx", &BoardNumber, &NumSolutions, &SolutionDigest) != 3 || BoardNumber != OutResults.size() + 1)
+        {
+            OutError = "line " + std::to_string(LineIdx) + " of '" + Filename + "' isn't the result of board " + std::to_string(OutResults.size() + 1);
+            fclose(InputFilePtr);
+            return false;
+        }
+        OutResults.push_back({ NumSolutions, SolutionDigest });
     }
 
-    // read in the initial board state
-    // note: there is no validation on input board, puzzle pieces etc.
-    std::vector<board> InputBoards;
-    InputBoards.reserve(128);
-    {
-        printf("reading boards from '%s'... ", BoardInputFilename.c_str());
-        fflush(stdout);
-        FILE* BoardInputFilePtr = fopen(BoardInputFilename.c_str(), "rb");
-        assert(BoardInputFilePtr != NULL);
+    fclose(InputFilePtr);
+    return true;
+}
 
-        bool EndOfFileReached = false;
-        while (!EndOfFileReached)
-        {
-            board InputBoard;
-            SetCells(InputBoard, cell_value::Invalid);
+bool WriteGoldenResults(const std::string& Filename, const std::string& BoardFilename, const std::vector<stat_data>& StatDataArray)
+{
+    FILE* OutputFilePtr = fopen(Filename.c_str(), "wb");
+    if (OutputFilePtr == NULL)
+    {
+        return false;
+    }
 
-            s32 RowIdx = 0;
-            s32 ColIdx = 0;
-            s32 NumValidCells = 0;
+    fprintf(OutputFilePtr, "# results of '%s': board, solutions, solution digest\n", BoardFilename.c_str());
+    for (size_t BoardIdx = 0; BoardIdx < StatDataArray.size(); BoardIdx++)
+    {
+        fprintf(OutputFilePtr, "%zu %llu %016llx\n", BoardIdx + 1, StatDataArray[BoardIdx].NumSolutions, StatDataArray[BoardIdx].SolutionDigest);
+    }
 
-            while (1)
-            {
-                char InputChar;
-                const s32 Result = fscanf(BoardInputFilePtr, "%c", &InputChar);
-                if (!feof(BoardInputFilePtr))
-                {
-                    assert(Result == 1);
-                }
-                else
-                {
-                    // if this is the last line of the last board, don't require a newline
-                    assert(NumValidCells == NUM_VALID_CELLS);
-                    EndOfFileReached = true;
-                    break;
-                }
+    fclose(OutputFilePtr);
+    return true;
+}
 
-                if (InputChar == '\n')
-                {
-                    ColIdx = 0;
-                    RowIdx++;
-                    assert(RowIdx <= MAX_BOARD_SIZE);
-                    if (NumValidCells >= NUM_VALID_CELLS)
-                    {
-                        break;
-                    }
-                }
-                else
-                {
-                    assert(ColIdx < MAX_BOARD_SIZE);
-                    const cell_value CellValue = InputCharToCellValue(InputChar);
-                    InputBoard.Cells[RowIdx][ColIdx] = CellValue;
-                    ColIdx++;
+// writes one row per board, as JSON if the filename ends in ".json" and as CSV otherwise. the board state counters are
+// only recorded if HasStats, otherwise they are left empty (CSV) or null (JSON)
+bool WriteBenchmarkReport(
+    const std::string& Filename,
+    const char* EngineName,
+    const s32 NumThreads,
+    const s32 NumRuns,
+    const bool HasStats,
+    const std::vector<stat_data>& StatDataArray)
+{
+    FILE* OutputFilePtr = fopen(Filename.c_str(), "wb");
+    if (OutputFilePtr == NULL)
+    {
+        return false;
+    }
 
-                    if (CellValue != cell_value::Invalid)
-                    {
-                        NumValidCells++;
-                        assert(NumValidCells <= NUM_VALID_CELLS);
-                    }
-                }
-            }
+    const bool IsJson = Filename.size() >= 5 && Filename.compare(Filename.size() - 5, 5, ".json") == 0;
+    if (IsJson)
+    {
+        fprintf(OutputFilePtr, "[\n");
+    }
+    else
+    {
+        fprintf(OutputFilePtr, "board,engine,threads,runs,solutions,min_sec,median_sec,p95_sec,board_states,states_per_sec,ns_per_state\n");
+    }
 
-            InputBoards.push_back(InputBoard);
+    for (size_t BoardIdx = 0; BoardIdx < StatDataArray.size(); BoardIdx++)
+    {
+        const stat_data& StatData = StatDataArray[BoardIdx];
 
-            if (!EndOfFileReached)
+        char StateFields[3][32] = { "", "", "" };
+        if (HasStats)
+        {
+            const u64 NumBoardStatesTested = StatData.Stats.NumBoardStatesTested;
+            snprintf(StateFields[0], sizeof(StateFields[0]), "%llu", NumBoardStatesTested);
+            snprintf(StateFields[1], sizeof(StateFields[1]), "%.1f", NumBoardStatesTested / StatData.ElapsedTimeSec);
+            snprintf(StateFields[2], sizeof(StateFields[2]), "%.3f", (1e9 * StatData.ElapsedTimeSec) / (f64)NumBoardStatesTested);
+        }
+        if (IsJson)
+        {
+            for (char (&StateField)[32] : StateFields)
             {
-                // boards deliminated with a newline
-                char NewlineChar;
-                const s32 Result = fscanf(BoardInputFilePtr, "%c", &NewlineChar);
-                if (feof(BoardInputFilePtr))
+                if (!StateField[0])
                 {
-                    // allow trailing newline after final board
-                    EndOfFileReached = true;
-                }
-                else
-                {
-                    assert(Result == 1);
-                    assert(NewlineChar == '\n');
+                    strcpy(StateField, "null");
                 }
             }
-        }
 
-        fclose(BoardInputFilePtr);
-        printf("done\n");
+            fprintf(OutputFilePtr,
+                "  { \"board\": %zu, \"engine\": \"%s\", \"threads\": %d, \"runs\": %d, \"solutions\": %llu, "
+                "\"min_sec\": %.6f, \"median_sec\": %.6f, \"p95_sec\": %.6f, "
+                "\"board_states\": %s, \"states_per_sec\": %s, \"ns_per_state\": %s }%s\n",
+                BoardIdx + 1, EngineName, NumThreads, NumRuns, StatData.NumSolutions,
+                StatData.MinElapsedTimeSec, StatData.ElapsedTimeSec, StatData.P95ElapsedTimeSec,
+                StateFields[0], StateFields[1], StateFields[2], (BoardIdx + 1 < StatDataArray.size()) ? "," : "");
+        }
+        else
+        {
+            fprintf(OutputFilePtr, "%zu,%s,%d,%d,%llu,%.6f,%.6f,%.6f,%s,%s,%s\n",
+                BoardIdx + 1, EngineName, NumThreads, NumRuns, StatData.NumSolutions,
+                StatData.MinElapsedTimeSec, StatData.ElapsedTimeSec, StatData.P95ElapsedTimeSec,
+                StateFields[0], StateFields[1], StateFields[2]);
+        }
     }
 
-    struct stat_data
+    if (IsJson)
     {
-        u64 NumOrientationsTested = 0;
-        u64 NumBoardStatesTested = 0;
-        u64 NumBallsTested = 0;
-        f64 ElapsedTimeSec = 0.f;
-    };
-
-    std::vector<stat_data> StatDataArray(InputBoards.size());
+        fprintf(OutputFilePtr, "]\n");
+    }
 
-    solver Solver;
-    Solver.Initialize(PieceDefinitions);
+    fclose(OutputFilePtr);
+    return true;
+}
 
-    printf("input boards: %lu\n", InputBoards.size());
+int main(int argc, char* argv[])
+{
+    std::string PieceInputFilename; // the standard pieces are used if empty
+    std::string BoardInputFilename = "boards.txt";
 
-    for (s32 InputBoardIdx = 0; InputBoardIdx < InputBoards.size(); InputBoardIdx++)
+    search_engine Engine = search_engine::Grid;
+    s32 NumThreads = 1;
+    bool DeterministicOrder = false;
+    s32 CacheSizeMB = 0;
+    bool CountOnly = false;
+    bool CompareCellOrders = false;
+    bool CrossCheck = false;
+    std::string VerifyFilename;
+    std::string TraceFilename;
+    bool UsePerfCounters = false;
+    std::string GoldenOutputFilename;
+    bool CollectStats = false;
+    bool InPlace = false;
+    bool BatchMode = false;
+    s32 NumBenchmarkRuns = 0;
+    s32 NumWarmupRuns = 1;
+    std::string BenchmarkOutputFilename;
+    std::string OutputFilename;
+    bool BinaryOutput = false;
+    std::string DatabaseFilename;
+    generate_options GenerateOptions;
+    bool GenerateMode = false;
+    bool ArrangementMode = false;
+    u64 FirstArrangementIdx = 0;
+    u64 NumArrangements = 0;
+    search_options SearchOptions;
+    u64 MaxSolutions = 0;
+    f64 MaxTimeSec = 0.f;
+    u64 MaxBoardStates = 0;
+    bool ServeMode = false;
+    std::string ServeAddress; // stdin/stdout if empty
+
+    for (s32 ArgIdx = 1; ArgIdx < argc; ArgIdx++)
     {
-        const board& InputBoard = InputBoards[InputBoardIdx];
-
-        // pre-compute the board size
-        s32 NumRows = 0;
-        s32 NumCols = 0;
+        const std::string Arg = argv[ArgIdx];
+        if (Arg == "--engine=grid")
         {
-            for (s32 RowIdx = 0; RowIdx < MAX_BOARD_SIZE; RowIdx++)
-            {
-                for (s32 ColIdx = 0; ColIdx < MAX_BOARD_SIZE; ColIdx++)
-                {
-                    if (InputBoard.Cells[RowIdx][ColIdx] != cell_value::Invalid)
-                    {
-                        if (RowIdx + 1 > NumRows)
-                        {
-                            NumRows = RowIdx + 1;
-                        }
-                        if (ColIdx + 1 > NumCols)
-                        {
-                            NumCols = ColIdx + 1;
-                        }
-                    }
-                }
-            }
+            Engine = search_engine::Grid;
         }
-
-        printf("board %d/%lu:\n", InputBoardIdx+1, InputBoards.size());
-        PrintBoard(InputBoard, NumRows, NumCols);
-        printf("\n");
-
-        stat_data& StatData = StatDataArray[InputBoardIdx];
-        std::vector<board> Solutions;
-
-        printf("solving... ");
-        fflush(stdout);
-        const std::clock_t ClockStart = std::clock();
-
-        Solver.Solve(
-            InputBoard,
-            NumRows,
-            NumCols,
-            Solutions,
-            StatData.NumBoardStatesTested,
-            StatData.NumOrientationsTested,
-            StatData.NumBallsTested);
-
-        const std::clock_t ClockEnd = std::clock();
+        else if (Arg == "--engine=bitboard")
+        {
+            Engine = search_engine::Bitboard;
+        }
+        else if (Arg == "--engine=dlx")
+        {
+            Engine = search_engine::ExactCover;
+        }
+        else if (Arg.compare(0, 9, "--pieces=") == 0)
+        {
+            PieceInputFilename = Arg.substr(9);
+        }
+        else if (Arg.compare(0, 12, "--benchmark=") == 0)
+        {
+            NumBenchmarkRuns = atoi(Arg.c_str() + 12);
+        }
+        else if (Arg.compare(0, 9, "--warmup=") == 0)
+        {
+            NumWarmupRuns = atoi(Arg.c_str() + 9);
+        }
+        else if (Arg.compare(0, 19, "--benchmark-output=") == 0)
+        {
+            BenchmarkOutputFilename = Arg.substr(19);
+        }
+        else if (Arg.compare(0, 15, "--arrangements=") == 0)
+        {
+            // 0 for every arrangement
+            ArrangementMode = true;
+            NumArrangements = strtoull(Arg.c_str() + 15, nullptr, 10);
+        }
+        else if (Arg.compare(0, 20, "--arrangements-from=") == 0)
+        {
+            FirstArrangementIdx = strtoull(Arg.c_str() + 20, nullptr, 10);
+        }
+        else if (Arg.compare(0, 11, "--generate=") == 0)
+        {
+            GenerateMode = true;
+            GenerateOptions.NumBoards = strtoull(Arg.c_str() + 11, nullptr, 10);
+        }
+        else if (Arg.compare(0, 21, "--generate-solutions=") == 0)
+        {
+            GenerateOptions.NumSolutions = strtoull(Arg.c_str() + 21, nullptr, 10);
+        }
+        else if (Arg.compare(0, 18, "--generate-pieces=") == 0)
+        {
+            GenerateOptions.NumPlacedPieces = atoi(Arg.c_str() + 18);
+        }
+        else if (Arg.compare(0, 17, "--max-candidates=") == 0)
+        {
+            GenerateOptions.MaxCandidates = strtoull(Arg.c_str() + 17, nullptr, 10);
+        }
+        else if (Arg.compare(0, 7, "--seed=") == 0)
+        {
+            GenerateOptions.Seed = strtoull(Arg.c_str() + 7, nullptr, 10);
+        }
+        else if (Arg.compare(0, 5, "--db=") == 0)
+        {
+            DatabaseFilename = Arg.substr(5);
+        }
+        else if (Arg.compare(0, 9, "--output=") == 0)
+        {
+            // '-' writes the solutions to stdout
+            OutputFilename = Arg.substr(9);
+        }
+        else if (Arg == "--output-format=text")
+        {
+            BinaryOutput = false;
+        }
+        else if (Arg == "--output-format=binary")
+        {
+            BinaryOutput = true;
+        }
+        else if (Arg == "--serve")
+        {
+            ServeMode = true;
+        }
+        else if (Arg.compare(0, 8, "--serve=") == 0)
+        {
+            ServeMode = true;
+            ServeAddress = Arg.substr(8);
+        }
+        else if (Arg == "--batch")
+        {
+            BatchMode = true;
+        }
+        else if (Arg == "--in-place")
+        {
+            InPlace = true;
+        }
+        else if (Arg == "--stats")
+        {
+            CollectStats = true;
+        }
+        else if (Arg == "--cross-check")
+        {
+            CrossCheck = true;
+        }
+        else if (Arg.compare(0, 9, "--verify=") == 0)
+        {
+            VerifyFilename = Arg.substr(9);
+        }
+        else if (Arg.compare(0, 8, "--trace=") == 0)
+        {
+            TraceFilename = Arg.substr(8);
+        }
+        else if (Arg == "--perf-counters")
+        {
+            UsePerfCounters = true;
+        }
+        else if (Arg.compare(0, 15, "--write-golden=") == 0)
+        {
+            GoldenOutputFilename = Arg.substr(15);
+        }
+        else if (Arg.compare(0, 10, "--threads=") == 0)
+        {
+            // 0 uses every available hardware thread
+            NumThreads = atoi(Arg.c_str() + 10);
+            if (NumThreads <= 0)
+            {
+                NumThreads = (s32)std::thread::hardware_concurrency();
+                NumThreads = (NumThreads > 0) ? NumThreads : 1;
+            }
+        }
+        else if (Arg.compare(0, 11, "--cache-mb=") == 0)
+        {
+            CacheSizeMB = atoi(Arg.c_str() + 11);
+        }
+        else if (Arg == "--cell-order=row-major")
+        {
+            SearchOptions.CellOrder = cell_order::RowMajor;
+        }
+        else if (Arg == "--cell-order=fewest-neighbors")
+        {
+            SearchOptions.CellOrder = cell_order::FewestEmptyNeighbors;
+        }
+        else if (Arg == "--cell-order=fewest-placements")
+        {
+            SearchOptions.CellOrder = cell_order::FewestPlacements;
+        }
+        else if (Arg == "--piece-order=index")
+        {
+            SearchOptions.PieceOrder = piece_order::ByIndex;
+        }
+        else if (Arg == "--piece-order=largest-first")
+        {
+            SearchOptions.PieceOrder = piece_order::LargestFirst;
+        }
+        else if (Arg == "--piece-order=fail-first")
+        {
+            SearchOptions.PieceOrder = piece_order::FailFirst;
+        }
+        else if (Arg.compare(0, 14, "--frontier-mb=") == 0)
+        {
+            SearchOptions.FrontierMemoryMB = atoi(Arg.c_str() + 14);
+        }
+        else if (Arg == "--prune-dead-regions")
+        {
+            SearchOptions.PruneDeadRegions = true;
+        }
+        else if (Arg == "--symmetry")
+        {
+            SearchOptions.UseSymmetry = true;
+        }
+        else if (Arg == "--compare-cell-orders")
+        {
+            CompareCellOrders = true;
+        }
+        else if (Arg == "--count-only")
+        {
+            CountOnly = true;
+        }
+        else if (Arg.compare(0, 16, "--max-solutions=") == 0)
+        {
+            MaxSolutions = strtoull(Arg.c_str() + 16, nullptr, 10);
+        }
+        else if (Arg.compare(0, 13, "--time-limit=") == 0)
+        {
+            // in seconds, per board
+            MaxTimeSec = atof(Arg.c_str() + 13);
+        }
+        else if (Arg.compare(0, 13, "--max-states=") == 0)
+        {
+            MaxBoardStates = strtoull(Arg.c_str() + 13, nullptr, 10);
+        }
+        else if (Arg == "--deterministic")
+        {
+            DeterministicOrder = true;
+        }
+        else if (Arg.compare(0, 2, "--") == 0)
+        {
+            fprintf(stderr, "unknown option '%s'\n", Arg.c_str());
+            return 1;
+        }
+        else
+        {
+            // override board input filename by command line
+            BoardInputFilename = Arg;
+        }
+    }
+
+    if (GenerateMode && (Engine != search_engine::Bitboard || BatchMode || CountOnly || CompareCellOrders || CrossCheck ||
+        NumBenchmarkRuns > 0 || !DatabaseFilename.empty() || MaxSolutions > 0 || MaxTimeSec > 0.f || BinaryOutput || OutputFilename.empty()))
+    {
+        fprintf(stderr, "--generate is only supported by the bitboard engine, with a text --output and without --batch, --count-only, --compare-cell-orders, --cross-check, --benchmark, --db, --max-solutions or --time-limit\n");
+        return 1;
+    }
+
+    if (ServeMode && (BatchMode || GenerateMode || ArrangementMode || CountOnly || CompareCellOrders || CrossCheck ||
+        NumBenchmarkRuns > 0 || CollectStats || !OutputFilename.empty()))
+    {
+        fprintf(stderr, "--serve can't be used with --batch, --generate, --arrangements, --count-only, --compare-cell-orders, --cross-check, --benchmark, --stats or --output\n");
+        return 1;
+    }
+
+    // note: serving solves each request on one thread, and --threads is how many requests are solved at once
+    if (NumThreads > 1 && Engine != search_engine::Bitboard && !ServeMode)
+    {
+        fprintf(stderr, "--threads is only supported by the bitboard engine\n");
+        return 1;
+    }
+
+    if (BatchMode && (Engine != search_engine::Bitboard || CountOnly || CacheSizeMB > 0 || NumBenchmarkRuns > 0 || CompareCellOrders))
+    {
+        fprintf(stderr, "--batch is only supported by the bitboard engine, without --count-only, --cache-mb, --benchmark or --compare-cell-orders\n");
+        return 1;
+    }
+
+    if (InPlace && Engine != search_engine::Grid)
+    {
+        fprintf(stderr, "--in-place is only supported by the grid engine\n");
+        return 1;
+    }
+
+    const search_options DefaultSearchOptions;
+    if (Engine != search_engine::Bitboard && (SearchOptions.CellOrder != DefaultSearchOptions.CellOrder ||
+        SearchOptions.PieceOrder != DefaultSearchOptions.PieceOrder || SearchOptions.PruneDeadRegions || SearchOptions.UseSymmetry))
+    {
+        fprintf(stderr, "--cell-order, --piece-order, --prune-dead-regions and --symmetry are only supported by the bitboard engine\n");
+        return 1;
+    }
+
+    const bool HasLimits = (MaxSolutions > 0 || MaxTimeSec > 0.f || MaxBoardStates > 0);
+
+    if (HasLimits && (BatchMode || CompareCellOrders))
+    {
+        fprintf(stderr, "--max-solutions, --time-limit and --max-states can't be used with --batch or --compare-cell-orders\n");
+        return 1;
+    }
+
+    if (CountOnly && (Engine != search_engine::Bitboard || NumThreads > 1))
+    {
+        fprintf(stderr, "--count-only is only supported by the single-threaded bitboard engine\n");
+        return 1;
+    }
+
+    if (NumBenchmarkRuns > 0 && CompareCellOrders)
+    {
+        fprintf(stderr, "--benchmark can't be used with --compare-cell-orders\n");
+        return 1;
+    }
+
+    if (!BenchmarkOutputFilename.empty() && NumBenchmarkRuns <= 0)
+    {
+        fprintf(stderr, "--benchmark-output requires --benchmark=N\n");
+        return 1;
+    }
+
+    if (CrossCheck && HasLimits)
+    {
+        fprintf(stderr, "--cross-check can't be used with --max-solutions, --time-limit or --max-states\n");
+        return 1;
+    }
+
+    const bool IsVerifying = !VerifyFilename.empty() || !GoldenOutputFilename.empty();
+    if (IsVerifying && (HasLimits || CompareCellOrders || GenerateMode || ServeMode))
+    {
+        fprintf(stderr, "--verify and --write-golden can't be used with --max-solutions, --time-limit, --max-states, --compare-cell-orders, --generate or --serve\n");
+        return 1;
+    }
+
+    // both would need to be written out while the run is still going
+    if ((!TraceFilename.empty() || UsePerfCounters) && (GenerateMode || ServeMode))
+    {
+        fprintf(stderr, "--trace and --perf-counters can't be used with --generate or --serve\n");
+        return 1;
+    }
+
+    // a count doesn't say which solutions were found
+    if (!GoldenOutputFilename.empty() && CountOnly)
+    {
+        fprintf(stderr, "--write-golden can't be used with --count-only\n");
+        return 1;
+    }
+
+    if (SearchOptions.FrontierMemoryMB > 0 && !CountOnly)
+    {
+        fprintf(stderr, "--frontier-mb requires --count-only\n");
+        return 1;
+    }
+
+    // note: generating and serving share the cache between every thread, as each one searches a different board
+    if (CacheSizeMB > 0 && (Engine != search_engine::Bitboard || (NumThreads > 1 && !GenerateMode && !ServeMode)))
+    {
+        fprintf(stderr, "--cache-mb is only supported by the single-threaded bitboard engine\n");
+        return 1;
+    }
+
+    if (!OutputFilename.empty() && (CountOnly || CompareCellOrders || NumBenchmarkRuns > 0))
+    {
+        fprintf(stderr, "--output can't be used with --count-only, --compare-cell-orders or --benchmark\n");
+        return 1;
+    }
+
+    if (!DatabaseFilename.empty() && (BatchMode || CompareCellOrders))
+    {
+        fprintf(stderr, "--db can't be used with --batch or --compare-cell-orders\n");
+        return 1;
+    }
+
+    // when serving on stdin/stdout, stdout only holds the responses
+    FILE* LogFile = ServeMode ? stderr : stdout;
+
+    // note: the counters have to be opened before any of the solves' threads are started
+    std::unique_ptr<trace_recorder> Trace;
+    if (!TraceFilename.empty())
+    {
+        Trace.reset(new trace_recorder());
+        SearchOptions.Trace = Trace.get();
+    }
+    perf_counters PerfCounters;
+    if (UsePerfCounters)
+    {
+        std::string Error;
+        if (!PerfCounters.Open(Error))
+        {
+            fprintf(stderr, "%s\n", Error.c_str());
+            return 1;
+        }
+    }
+
+    // the standard pieces are built in, a custom set can be read from a file instead
+    solver Solver;
+    piece_definition PieceDefinitions[NUM_PIECES];
+    memcpy(PieceDefinitions, STANDARD_PIECES, sizeof(PieceDefinitions));
+    if (!PieceInputFilename.empty())
+    {
+        fprintf(LogFile, "reading pieces from '%s'... ", PieceInputFilename.c_str());
+        fflush(LogFile);
+
+        trace_scope ReadScope(Trace.get(), "read pieces");
+        std::string Error;
+        if (!LoadPieces(PieceInputFilename, PieceDefinitions, Error))
+        {
+            fprintf(LogFile, "\n");
+            fflush(LogFile);
+            fprintf(stderr, "%s\n", Error.c_str());
+            return 1;
+        }
+        fprintf(LogFile, "done\n");
+
+        trace_scope InitializeScope(Trace.get(), "initialize solver");
+        Solver.Initialize(PieceDefinitions);
+    }
+
+    // read in the initial board states, or lay them out from the standard tiles
+    std::vector<board> InputBoards;
+    if (ArrangementMode)
+    {
+        printf("enumerating tile arrangements... ");
+        fflush(stdout);
+        trace_scope EnumerateScope(Trace.get(), "enumerate arrangements");
+        EnumerateArrangements(STANDARD_TILES, FirstArrangementIdx, NumArrangements, InputBoards);
         printf("done\n");
+    }
+    else if (!ServeMode)
+    {
+        printf("reading boards from '%s'... ", BoardInputFilename.c_str());
+        fflush(stdout);
+
+        trace_scope ReadScope(Trace.get(), "read boards");
+        std::string Error;
+        if (!LoadBoards(BoardInputFilename, Solver, InputBoards, Error))
+        {
+            printf("\n");
+            fflush(stdout);
+            fprintf(stderr, "%s\n", Error.c_str());
+            return 1;
+        }
+        printf("done\n");
+    }
 
-        StatData.ElapsedTimeSec = (ClockEnd - ClockStart) / (f32)CLOCKS_PER_SEC;
+    // boards solved by earlier runs are answered from the database, and the boards this run solves are added to it
+    solution_database Database(PieceDefinitions);
+    if (!DatabaseFilename.empty())
+    {
+        fprintf(LogFile, "opening solution database '%s'... ", DatabaseFilename.c_str());
+        fflush(LogFile);
+
+        trace_scope OpenScope(Trace.get(), "open database");
+        std::string Error;
+        if (!Database.Open(DatabaseFilename, Error))
+        {
+            fprintf(LogFile, "\n");
+            fflush(LogFile);
+            fprintf(stderr, "%s\n", Error.c_str());
+            return 1;
+        }
+        fprintf(LogFile, "done (%llu boards)\n", Database.NumEntries);
+    }
+
+    std::vector<golden_result> GoldenResults;
+    if (!VerifyFilename.empty())
+    {
+        std::string Error;
+        if (!LoadGoldenResults(VerifyFilename, GoldenResults, Error))
+        {
+            fprintf(stderr, "%s\n", Error.c_str());
+            return 1;
+        }
+        if (GoldenResults.size() != InputBoards.size())
+        {
+            fprintf(stderr, "'%s' has the results of %zu boards, but there are %zu input boards\n",
+                VerifyFilename.c_str(), GoldenResults.size(), InputBoards.size());
+            return 1;
+        }
+    }
+
+    std::vector<stat_data> StatDataArray(InputBoards.size());
+
+    // a single cache is shared by every board, as sub-problems are often repeated across boards
+    std::unique_ptr<solution_cache> Cache;
+    if (CacheSizeMB > 0)
+    {
+        Cache.reset(new solution_cache((size_t)CacheSizeMB * 1024 * 1024));
+    }
+
+    // boards are read from the clients instead, and solved as they arrive until the input ends (or forever, on a socket)
+    if (ServeMode)
+    {
+        solve_options ServiceOptions;
+        ServiceOptions.Engine = Engine;
+        ServiceOptions.Search = SearchOptions;
+        ServiceOptions.InPlace = InPlace;
+        ServiceOptions.Cache = Cache.get();
+        ServiceOptions.Database = DatabaseFilename.empty() ? nullptr : &Database;
+
+        solve_service::request Defaults;
+        Defaults.MaxSolutions = MaxSolutions;
+        Defaults.MaxBoardStates = MaxBoardStates;
+        Defaults.MaxTimeSec = MaxTimeSec;
+
+        solve_service Service(Solver, ServiceOptions, NumThreads);
+        if (ServeAddress.empty())
+        {
+            fprintf(stderr, "serving on stdin/stdout with %d threads\n", NumThreads);
+            service_connection Connection(stdin, stdout);
+            Connection.Run(Service, Solver, Defaults);
+            return 0;
+        }
+
+#if !defined(_WIN32)
+        fprintf(stderr, "serving on %s with %d threads\n", ServeAddress.c_str(), NumThreads);
+        std::string Error;
+        ServeSocket(ServeAddress, Service, Solver, Defaults, Error);
+        fprintf(stderr, "%s\n", Error.c_str());
+#else
+        fprintf(stderr, "--serve=ADDRESS isn't supported on Windows, only --serve on stdin/stdout\n");
+#endif
+        return 1;
+    }
+
+    // the input boards are only the templates that new boards are made from
+    if (GenerateMode)
+    {
+        FILE* GenerateFilePtr = (OutputFilename == "-") ? stdout : fopen(OutputFilename.c_str(), "wb");
+        if (!GenerateFilePtr)
+        {
+            fprintf(stderr, "can't open '%s' for writing\n", OutputFilename.c_str());
+            return 1;
+        }
+
+        GenerateOptions.MaxCandidateStates = MaxBoardStates;
+        GenerateOptions.NumThreads = NumThreads;
+        GenerateOptions.Search = SearchOptions;
+        GenerateOptions.Cache = Cache.get();
+
+        printf("generating %llu boards with %llu solutions from %lu templates on %d threads...\n",
+            GenerateOptions.NumBoards, GenerateOptions.NumSolutions, InputBoards.size(), NumThreads);
+        fflush(stdout);
+
+        generate_result GenerateResult;
+        std::string Error;
+        bool IsGenerated;
+        {
+            text_solution_sink GeneratedBoards(GenerateFilePtr);
+            IsGenerated = Solver.GenerateBoards(InputBoards, GenerateOptions, GeneratedBoards, GenerateResult, Error);
+        }
+        if (GenerateFilePtr != stdout)
+        {
+            fclose(GenerateFilePtr);
+        }
+        if (!IsGenerated)
+        {
+            fprintf(stderr, "%s\n", Error.c_str());
+            return 1;
+        }
+
+        printf("boards accepted: %llu\n", GenerateResult.NumAccepted);
+        printf("candidates tested: %llu\n", GenerateResult.NumCandidates);
+        printf("pieces didn't fit: %llu\n", GenerateResult.NumUnplaceable);
+        printf("unsolvable: %llu\n", GenerateResult.NumUnsolvable);
+        printf("wrong number of solutions: %llu\n", GenerateResult.NumWrongSolutionCount);
+        printf("abandoned: %llu\n", GenerateResult.NumAbandoned);
+        printf("duplicates: %llu\n", GenerateResult.NumDuplicates);
+        printf("time taken: %.5f seconds\n", GenerateResult.ElapsedTimeSec);
+        if (Cache)
+        {
+            printf("cache hits: %llu\n", Cache->NumHits.load());
+            printf("cache misses: %llu\n", Cache->NumMisses.load());
+        }
+        return 0;
+    }
+
+    // the limits apply to each board's search separately
+    search_control Control;
+    Control.MaxTimeSec = MaxTimeSec;
+    Control.MaxBoardStates = MaxBoardStates;
+    Control.MaxSolutions = MaxSolutions;
+
+    solve_options SolveOptions;
+    SolveOptions.Engine = Engine;
+    SolveOptions.Search = SearchOptions;
+    SolveOptions.InPlace = InPlace;
+    SolveOptions.NumThreads = NumThreads;
+    SolveOptions.DeterministicOrder = DeterministicOrder;
+    SolveOptions.Cache = Cache.get();
+    SolveOptions.CountOnly = CountOnly;
+    SolveOptions.Control = HasLimits ? &Control : nullptr;
+    SolveOptions.Database = DatabaseFilename.empty() ? nullptr : &Database;
+    SolveOptions.CollectStats = CollectStats;
+    SolveOptions.KeepSolutions = (SolveOptions.Database && !CountOnly); // to be added to the database
+
+    constexpr s32 NUM_CELL_ORDERS = 3;
+    const char* CellOrderNames[NUM_CELL_ORDERS] = { "row-major", "fewest-neighbors", "fewest-placements" };
+    u64 CellOrderTotalNumBoardStatesTested[NUM_CELL_ORDERS] = {};
+    f64 CellOrderTotalElapsedTimeSec[NUM_CELL_ORDERS] = {};
+
+    // solutions are only counted, unless they are to be written out
+    std::unique_ptr<solution_sink> SolutionSink(new solution_sink());
+    FILE* OutputFilePtr = nullptr;
+    if (!OutputFilename.empty())
+    {
+        OutputFilePtr = (OutputFilename == "-") ? stdout : fopen(OutputFilename.c_str(), "wb");
+        if (!OutputFilePtr)
+        {
+            fprintf(stderr, "can't open '%s' for writing\n", OutputFilename.c_str());
+            return 1;
+        }
 
-        constexpr bool PRINT_SOLUTIONS = false;
-        if (PRINT_SOLUTIONS)
+        if (BinaryOutput)
+        {
+            SolutionSink.reset(new binary_solution_sink(OutputFilePtr));
+        }
+        else
         {
-            printf("solutions:\n");
-            const s32 SolutionCount = Solutions.size();
-            for (s32 SolIdx = 0; SolIdx < SolutionCount; SolIdx++)
+            SolutionSink.reset(new text_solution_sink(OutputFilePtr));
+        }
+    }
+
+    // when verifying, every solution is hashed on its way to the sink. this needs the solutions, so engines that can
+    // only count them take the slower path that finds each one
+    std::unique_ptr<digest_solution_sink> DigestSink;
+    if (IsVerifying)
+    {
+        DigestSink.reset(new digest_solution_sink(SolutionSink.get()));
+    }
+    solution_sink* Sink = DigestSink ? DigestSink.get() : SolutionSink.get();
+
+    printf("input boards: %lu\n", InputBoards.size());
+
+    // in batch mode every board is solved up front, several at once, and the results are reported afterwards
+    std::vector<solver::batch_result> BatchResults;
+    if (BatchMode)
+    {
+        printf("solving batch on %d threads... ", NumThreads);
+        fflush(stdout);
+
+        // the boards are solved at once, so the counters can only be read for the whole batch
+        u64 BeginCounts[perf_counters::NUM_COUNTERS], EndCounts[perf_counters::NUM_COUNTERS];
+        PerfCounters.Read(BeginCounts);
+        const std::chrono::steady_clock::time_point ClockStart = std::chrono::steady_clock::now();
+        {
+            trace_scope BatchScope(Trace.get(), "solve batch");
+            Solver.SolveBatch(InputBoards, SearchOptions, NumThreads, DeterministicOrder, CollectStats, *Sink, BatchResults);
+        }
+        const std::chrono::steady_clock::time_point ClockEnd = std::chrono::steady_clock::now();
+        PerfCounters.Read(EndCounts);
+        printf("done\nbatch time taken: %.5f seconds\n", std::chrono::duration<f64>(ClockEnd - ClockStart).count());
+        if (UsePerfCounters)
+        {
+            PerfCounters.Print("batch perf counters", BeginCounts, EndCounts);
+        }
+        printf("\n");
+    }
+
+    s32 NumCrossCheckMismatches = 0;
+    s32 NumVerifyMismatches = 0;
+
+    for (s32 InputBoardIdx = 0; InputBoardIdx < InputBoards.size(); InputBoardIdx++)
+    {
+        const board& InputBoard = InputBoards[InputBoardIdx];
+
+        // pre-compute the board size
+        s32 NumRows, NumCols;
+        ComputeBoardSize(InputBoard, NumRows, NumCols);
+
+        printf("board %d/%lu:\n", InputBoardIdx+1, InputBoards.size());
+        PrintBoard(InputBoard, NumRows, NumCols);
+        printf("\n");
+
+        trace_scope BoardScope(Trace.get(), "board");
+        BoardScope.ArgName = "board";
+        BoardScope.ArgValue = InputBoardIdx + 1;
+
+        stat_data& StatData = StatDataArray[InputBoardIdx];
+
+        if (CompareCellOrders)
+        {
+            // count the solutions using every cell order, to compare how many states each one has to search
+            for (s32 CellOrderIdx = 0; CellOrderIdx < NUM_CELL_ORDERS; CellOrderIdx++)
             {
-                //printf("solution %d/%d:\n", SolIdx+1, solutionCount);
-                PrintBoard(Solutions[SolIdx], NumRows, NumCols);
-                printf("\n");
+                search_options CompareOptions = SearchOptions;
+                CompareOptions.CellOrder = (cell_order)CellOrderIdx;
+
+                const std::chrono::steady_clock::time_point ClockStart = std::chrono::steady_clock::now();
+                const u64 NumSolutions = Solver.CountSolutions(
+                    InputBoard,
+                    NumRows,
+                    NumCols,
+                    CompareOptions,
+                    nullptr,
+                    nullptr,
+                    &StatData.Stats,
+                    nullptr);
+                const std::chrono::steady_clock::time_point ClockEnd = std::chrono::steady_clock::now();
+                const f64 ElapsedTimeSec = std::chrono::duration<f64>(ClockEnd - ClockStart).count();
+
+                CellOrderTotalNumBoardStatesTested[CellOrderIdx] += StatData.Stats.NumBoardStatesTested;
+                CellOrderTotalElapsedTimeSec[CellOrderIdx] += ElapsedTimeSec;
+                printf("%-18s solutions: %llu, board states tested: %llu, states pruned: %llu, time taken: %.5f seconds\n",
+                    CellOrderNames[CellOrderIdx], NumSolutions, StatData.Stats.NumBoardStatesTested, StatData.Stats.NumStatesPruned, ElapsedTimeSec);
             }
+            printf("\n\n");
+            continue;
         }
 
-        printf("total solutions: %lu\n", Solutions.size());
-        printf("time taken: %.5f seconds\n", StatData.ElapsedTimeSec);
-#if WITH_STATS
-        printf("board states tested: %llu\n", StatData.NumBoardStatesTested);
-        printf("orientations tested: %llu\n", StatData.NumOrientationsTested);
-        printf("balls tested: %llu\n", StatData.NumBallsTested);
-#endif
+        printf("solving... ");
+        fflush(stdout);
+
+        // when benchmarking, the board is solved repeatedly (after some untimed warmup runs) and the median wall-clock
+        // time is reported
+        const s32 NumMeasuredRuns = (NumBenchmarkRuns > 0) ? NumBenchmarkRuns : 1;
+        const s32 NumRuns = ((NumBenchmarkRuns > 0) ? NumWarmupRuns : 0) + NumMeasuredRuns;
+        std::vector<f64> RunTimesSec;
+        RunTimesSec.reserve(NumRuns);
+
+        u64 NumSolutions = 0;
+        search_status Status = search_status::Complete;
+        bool IsFromDatabase = false;
+        u64 BeginCounts[perf_counters::NUM_COUNTERS], EndCounts[perf_counters::NUM_COUNTERS];
+        PerfCounters.Read(BeginCounts);
+        if (BatchMode)
+        {
+            const solver::batch_result& BatchResult = BatchResults[InputBoardIdx];
+            NumSolutions = BatchResult.NumSolutions;
+            StatData.Stats = BatchResult.Stats;
+            RunTimesSec.push_back(BatchResult.ElapsedTimeSec);
+        }
+
+        for (s32 RunIdx = 0; RunIdx < NumRuns && !BatchMode; RunIdx++)
+        {
+            solve_result Result;
+            std::string Error;
+            if (!Solver.SolveBoard(InputBoard, SolveOptions, Sink, Result, Error, nullptr))
+            {
+                fprintf(stderr, "\n%s\n", Error.c_str());
+                return 1;
+            }
+
+            if (RunIdx >= NumRuns - NumMeasuredRuns)
+            {
+                RunTimesSec.push_back(Result.ElapsedTimeSec);
+            }
+            NumSolutions = Result.NumSolutions;
+            Status = Result.Status;
+            IsFromDatabase = Result.IsFromDatabase;
+            StatData.Stats = Result.Stats;
+
+            // only a complete list of solutions can be added
+            if (RunIdx == 0 && SolveOptions.KeepSolutions && !Result.IsFromDatabase && Result.Status == search_status::Complete)
+            {
+                Database.Add(InputBoard, Result.Solutions);
+            }
+        }
+        PerfCounters.Read(EndCounts);
+        printf(IsFromDatabase ? "done (from database)\n" : "done\n");
+
+        std::sort(RunTimesSec.begin(), RunTimesSec.end());
+        StatData.NumSolutions = NumSolutions;
+        StatData.MinElapsedTimeSec = RunTimesSec.front();
+        StatData.ElapsedTimeSec = RunTimesSec[RunTimesSec.size() / 2];
+        StatData.P95ElapsedTimeSec = RunTimesSec[(RunTimesSec.size() * 95 + 99) / 100 - 1];
+        if (DigestSink && !CountOnly)
+        {
+            // the digest of the last run, or of this board's batch output
+            StatData.SolutionDigest = BatchMode ? DigestSink->Digests[InputBoardIdx] : DigestSink->Digests.back();
+        }
+
+        if (Status == search_status::Complete)
+        {
+            printf("total solutions: %llu\n", NumSolutions);
+        }
+        else
+        {
+            printf("total solutions: %llu (search stopped: %s after %llu board states)\n", NumSolutions, SearchStatusNames[Status], Control.NumBoardStates.load());
+        }
+        if (NumBenchmarkRuns > 0)
+        {
+            printf("time taken: %.5f seconds (min %.5f, p95 %.5f, %d runs)\n",
+                StatData.ElapsedTimeSec, StatData.MinElapsedTimeSec, StatData.P95ElapsedTimeSec, NumBenchmarkRuns);
+        }
+        else
+        {
+            printf("time taken: %.5f seconds\n", StatData.ElapsedTimeSec);
+        }
+        if (UsePerfCounters && !BatchMode)
+        {
+            PerfCounters.Print((NumRuns > 1) ? "perf counters (every run)" : "perf counters", BeginCounts, EndCounts);
+        }
+        if (CrossCheck)
+        {
+            trace_scope CheckScope(Trace.get(), "cross-check");
+            // count the solutions again with a different engine: the exact cover engine, or the bitboard engine when
+            // the exact cover engine is the one that was checked
+            u64 NumCheckSolutions;
+            if (Engine == search_engine::ExactCover)
+            {
+                NumCheckSolutions = Solver.CountSolutions(
+                    InputBoard,
+                    NumRows,
+                    NumCols,
+                    search_options(),
+                    nullptr,
+                    nullptr,
+                    nullptr,
+                    nullptr);
+            }
+            else
+            {
+                solution_sink CheckSolutions;
+                Solver.SolveExactCover(
+                    InputBoard,
+                    NumRows,
+                    NumCols,
+                    nullptr,
+                    CheckSolutions,
+                    nullptr,
+                    nullptr);
+                NumCheckSolutions = CheckSolutions.NumSolutions;
+            }
+
+            const char* CheckEngineName = (Engine == search_engine::ExactCover) ? "bitboard" : "dlx";
+            if (NumCheckSolutions == NumSolutions)
+            {
+                printf("cross-check: ok (%s engine agrees)\n", CheckEngineName);
+            }
+            else
+            {
+                printf("cross-check: MISMATCH (%s engine found %llu solutions)\n", CheckEngineName, NumCheckSolutions);
+                NumCrossCheckMismatches++;
+            }
+        }
+        if (!VerifyFilename.empty())
+        {
+            // counting can only check the number of solutions
+            const golden_result& Golden = GoldenResults[InputBoardIdx];
+            if (NumSolutions == Golden.NumSolutions && (CountOnly || StatData.SolutionDigest == Golden.SolutionDigest))
+            {
+                printf(CountOnly ? "verify: ok (solution count)\n" : "verify: ok\n");
+            }
+            else if (CountOnly)
+            {
+                printf("verify: MISMATCH (expected %llu solutions)\n", Golden.NumSolutions);
+                NumVerifyMismatches++;
+            }
+            else
+            {
+                printf("verify: MISMATCH (expected %llu solutions with digest %016llx, found digest %016llx)\n",
+                    Golden.NumSolutions, Golden.SolutionDigest, StatData.SolutionDigest);
+                NumVerifyMismatches++;
+            }
+        }
+        if (CollectStats)
+        {
+            printf("board states tested: %llu\n", StatData.Stats.NumBoardStatesTested);
+            printf("orientations tested: %llu\n", StatData.Stats.NumOrientationsTested);
+            printf("balls tested: %llu\n", StatData.Stats.NumBallsTested);
+            printf("states pruned: %llu\n", StatData.Stats.NumStatesPruned);
+            printf("cache hits: %llu\n", StatData.Stats.NumCacheHits);
+            printf("max stack depth: %llu\n", StatData.Stats.MaxStackDepth);
+        }
         printf("\n\n");
     }
 
-#if WITH_STATS
-    u64 TotalNumBoardStatesTested = 0;
-    f64 TotalElapsedTimeSec = 0.f;
-    for (const stat_data& StatData : StatDataArray)
+    // flush any buffered solutions before closing the file
     {
-        TotalNumBoardStatesTested += StatData.NumBoardStatesTested;
-        TotalElapsedTimeSec += StatData.ElapsedTimeSec;
+        trace_scope OutputScope(Trace.get(), "write output");
+        DigestSink.reset();
+        SolutionSink.reset();
+        if (OutputFilePtr && OutputFilePtr != stdout)
+        {
+            fclose(OutputFilePtr);
+        }
     }
 
-    constexpr f64 NANOSECONDS_PER_SECOND = 1000000000.f;
-    const f64 TimePerBoardStateNS = (NANOSECONDS_PER_SECOND * TotalElapsedTimeSec) / (f64)TotalNumBoardStatesTested;
-    printf("total board states tested: %llu\n", TotalNumBoardStatesTested);
-    printf("total time taken: %.5f seconds\n", TotalElapsedTimeSec);
-    printf("average time per board state: %.5f ns\n", TimePerBoardStateNS);
-#endif
+    if (CompareCellOrders)
+    {
+        for (s32 CellOrderIdx = 0; CellOrderIdx < NUM_CELL_ORDERS; CellOrderIdx++)
+        {
+            printf("%-18s total board states tested: %llu, total time taken: %.5f seconds\n",
+                CellOrderNames[CellOrderIdx], CellOrderTotalNumBoardStatesTested[CellOrderIdx], CellOrderTotalElapsedTimeSec[CellOrderIdx]);
+        }
+        printf("\n");
+    }
+
+    if (!DatabaseFilename.empty())
+    {
+        printf("database boards added: %zu\n", Database.AddedEntries.size());
+        if (!Database.AddedEntries.empty())
+        {
+            // note: the database is still mapped while it's replaced, which is why Write goes through a new file
+            trace_scope WriteScope(Trace.get(), "write database");
+            std::string Error;
+            if (!Database.Write(DatabaseFilename, Error))
+            {
+                fprintf(stderr, "%s\n", Error.c_str());
+                return 1;
+            }
+            printf("database written to '%s' (%llu boards)\n", DatabaseFilename.c_str(), Database.NumEntries + Database.AddedEntries.size());
+        }
+        printf("\n");
+    }
+
+    if (Cache)
+    {
+        printf("cache entries: %lu\n", Cache->Buckets.size() * solution_cache::NUM_WAYS);
+        printf("cache hits: %llu\n", Cache->NumHits.load());
+        printf("cache misses: %llu\n", Cache->NumMisses.load());
+        printf("cache evictions: %llu\n", Cache->NumEvictions.load());
+    }
+
+    if (CollectStats && !CompareCellOrders)
+    {
+        search_stats TotalStats;
+        f64 TotalElapsedTimeSec = 0.f;
+        for (const stat_data& StatData : StatDataArray)
+        {
+            TotalStats.Add(StatData.Stats);
+            TotalElapsedTimeSec += StatData.ElapsedTimeSec;
+        }
+
+        constexpr f64 NANOSECONDS_PER_SECOND = 1000000000.f;
+        const f64 TimePerBoardStateNS = (NANOSECONDS_PER_SECOND * TotalElapsedTimeSec) / (f64)TotalStats.NumBoardStatesTested;
+        printf("total board states tested: %llu\n", TotalStats.NumBoardStatesTested);
+        printf("total time taken: %.5f seconds\n", TotalElapsedTimeSec);
+        printf("average time per board state: %.5f ns\n", TimePerBoardStateNS);
+    }
+
+    if (!BenchmarkOutputFilename.empty())
+    {
+        if (!WriteBenchmarkReport(BenchmarkOutputFilename, EngineNames[Engine], NumThreads, NumBenchmarkRuns, CollectStats, StatDataArray))
+        {
+            fprintf(stderr, "couldn't write benchmark report '%s'\n", BenchmarkOutputFilename.c_str());
+            return 1;
+        }
+        printf("benchmark report written to '%s'\n", BenchmarkOutputFilename.c_str());
+    }
+
+    if (Trace)
+    {
+        std::string Error;
+        if (!Trace->Write(TraceFilename, Error))
+        {
+            fprintf(stderr, "%s\n", Error.c_str());
+            return 1;
+        }
+        printf("trace written to '%s' (%zu spans)\n", TraceFilename.c_str(), Trace->Spans.size());
+    }
+
+    if (!GoldenOutputFilename.empty())
+    {
+        if (!WriteGoldenResults(GoldenOutputFilename, BoardInputFilename, StatDataArray))
+        {
+            fprintf(stderr, "couldn't write golden results '%s'\n", GoldenOutputFilename.c_str());
+            return 1;
+        }
+        printf("golden results written to '%s'\n", GoldenOutputFilename.c_str());
+    }
+
+    if (NumCrossCheckMismatches > 0)
+    {
+        fprintf(stderr, "cross-check failed on %d board(s)\n", NumCrossCheckMismatches);
+        return 1;
+    }
+
+    if (NumVerifyMismatches > 0)
+    {
+        fprintf(stderr, "verify failed on %d board(s)\n", NumVerifyMismatches);
+        return 1;
+    }
+    if (!VerifyFilename.empty())
+    {
+        printf("verified %zu boards against '%s'\n", InputBoards.size(), VerifyFilename.c_str());
+    }
 
     return 0;
 }
@@ -0,0 +1,5621 @@
+/*
+    MIT License
+
+    Copyright (c) 2020 George Prosser
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+/*
+    Solver for Quadrillion puzzle by SmartGames.
+    https://www.smartgamesandpuzzles.com/quadrillion.html
+*/
+
+#define FAST 1
+
+#if FAST && !defined(NDEBUG)
+#define NDEBUG
+#endif
+
+#include "quadrillion.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <thread>
+#include <type_traits>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+void ComputeBoardSize(const board& Board, s32& OutNumRows, s32& OutNumCols)
+{
+    OutNumRows = 0;
+    OutNumCols = 0;
+    for (s32 RowIdx = 0; RowIdx < MAX_BOARD_SIZE; RowIdx++)
+    {
+        for (s32 ColIdx = 0; ColIdx < MAX_BOARD_SIZE; ColIdx++)
+        {
+            if (Board.Cells[RowIdx][ColIdx] != cell_value::Invalid)
+            {
+                OutNumRows = (RowIdx + 1 > OutNumRows) ? RowIdx + 1 : OutNumRows;
+                OutNumCols = (ColIdx + 1 > OutNumCols) ? ColIdx + 1 : OutNumCols;
+            }
+        }
+    }
+}
+
+void SetCells(board& Board, const cell_value CellValue)
+{
+    for (s32 RowIdx = 0; RowIdx < MAX_BOARD_SIZE; RowIdx++)
+    {
+        for (s32 ColIdx = 0; ColIdx < MAX_BOARD_SIZE; ColIdx++)
+        {
+            Board.Cells[RowIdx][ColIdx] = CellValue;
+        }
+    }
+}
+
+// writes the board as text, one line per row, and returns the number of chars written (at most MAX_BOARD_TEXT_SIZE).
+// may write past the returned length, but never past MAX_BOARD_TEXT_SIZE chars
+s32 FormatBoard(const board& Board, const s32 NumRows, const s32 NumCols, char* OutText)
+{
+    static_assert(cell_value::Piece12 < 16 && MAX_BOARD_SIZE == 16, "each row must be one vector of table indices");
+
+    // the char of each cell_value, as CellValueToOutputChar
+    alignas(16) static const char CELL_CHARS[16] = { '.', ' ', '*', 'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', '?' };
+
+    char* Text = OutText;
+#if defined(__SSSE3__)
+    // look up the chars of a whole row at once. rows are written in full and then overwritten by the next row, which
+    // stays inside the buffer as rows are at most MAX_BOARD_SIZE chars and one of them is a newline
+    const __m128i CellChars = _mm_load_si128((const __m128i*)CELL_CHARS);
+    for (s32 RowIdx = 0; RowIdx < NumRows; RowIdx++)
+    {
+        const __m128i Cells = _mm_loadu_si128((const __m128i*)Board.Cells[RowIdx]);
+        _mm_storeu_si128((__m128i*)Text, _mm_shuffle_epi8(CellChars, Cells));
+        Text += NumCols;
+        *Text++ = '\n';
+    }
+#else
+    for (s32 RowIdx = 0; RowIdx < NumRows; RowIdx++)
+    {
+        for (s32 ColIdx = 0; ColIdx < NumCols; ColIdx++)
+        {
+            assert(Board.Cells[RowIdx][ColIdx] <= cell_value::Piece12);
+            *Text++ = CELL_CHARS[Board.Cells[RowIdx][ColIdx]];
+        }
+        *Text++ = '\n';
+    }
+#endif
+    return (s32)(Text - OutText);
+}
+
+void PrintBoard(const board& Board, const s32 NumRows, const s32 NumCols)
+{
+    char Text[MAX_BOARD_TEXT_SIZE];
+    fwrite(Text, 1, FormatBoard(Board, NumRows, NumCols, Text), stdout);
+}
+
+void ComputeBoardLayout(const board& Board, board_layout& OutLayout)
+{
+    s32 NumValidCells = 0;
+    for (s32 CellIdx = 0; CellIdx < MAX_BOARD_SIZE * MAX_BOARD_SIZE; CellIdx++)
+    {
+        if ((&Board.Cells[0][0])[CellIdx] != cell_value::Invalid)
+        {
+            assert(NumValidCells < NUM_VALID_CELLS);
+            OutLayout.ValidCellIdxs[NumValidCells++] = (u8)CellIdx;
+        }
+    }
+    assert(NumValidCells == NUM_VALID_CELLS);
+}
+
+void PackBoard(const board& Board, const board_layout& Layout, packed_board& OutPacked)
+{
+    static_assert(cell_value::Piece12 < 0xF, "cell values must fit in a nibble");
+
+    const cell_value* Cells = &Board.Cells[0][0];
+    for (s32 ByteIdx = 0; ByteIdx < NUM_VALID_CELLS / 2; ByteIdx++)
+    {
+        OutPacked.Cells[ByteIdx] = (u8)(Cells[Layout.ValidCellIdxs[ByteIdx * 2]] | (Cells[Layout.ValidCellIdxs[ByteIdx * 2 + 1]] << 4));
+    }
+}
+
+void UnpackBoard(const packed_board& Packed, const board_layout& Layout, board& OutBoard)
+{
+    SetCells(OutBoard, cell_value::Invalid);
+
+    cell_value* Cells = &OutBoard.Cells[0][0];
+    for (s32 ByteIdx = 0; ByteIdx < NUM_VALID_CELLS / 2; ByteIdx++)
+    {
+        Cells[Layout.ValidCellIdxs[ByteIdx * 2]] = (cell_value)(Packed.Cells[ByteIdx] & 0xF);
+        Cells[Layout.ValidCellIdxs[ByteIdx * 2 + 1]] = (cell_value)(Packed.Cells[ByteIdx] >> 4);
+    }
+}
+
+void AddSolutions(const std::vector<board>& Solutions, solution_sink& Sink)
+{
+    for (const board& Solution : Solutions)
+    {
+        Sink.Add(Solution);
+    }
+}
+
+constexpr void Rotate(const piece_definition& From, piece_definition& To)
+{
+    // rotate clockwise by 90 degrees
+    for (s32 fromRowIdx = 0; fromRowIdx < MAX_PIECE_SIZE; fromRowIdx++)
+    {
+        for (s32 fromColIdx = 0; fromColIdx < MAX_PIECE_SIZE; fromColIdx++)
+        {
+            To.Balls[fromColIdx][(MAX_PIECE_SIZE - 1) - fromRowIdx] = From.Balls[fromRowIdx][fromColIdx];
+        }
+    }
+}
+
+constexpr void Flip(const piece_definition& From, piece_definition& To)
+{
+    // flip vertically
+    for (s32 fromRowIdx = 0; fromRowIdx < MAX_PIECE_SIZE; fromRowIdx++)
+    {
+        for (s32 fromColIdx = 0; fromColIdx < MAX_PIECE_SIZE; fromColIdx++)
+        {
+            To.Balls[(MAX_PIECE_SIZE - 1) - fromRowIdx][fromColIdx] = From.Balls[fromRowIdx][fromColIdx];
+        }
+    }
+}
+
+constexpr void PushUpAndLeft(piece_definition& Definition)
+{
+    // find the first row and column with a set bit
+    s32 MinRowIdx = MAX_PIECE_SIZE - 1;
+    s32 MinColIdx = MAX_PIECE_SIZE - 1;
+    for (s32 RowIdx = 0; RowIdx < MAX_PIECE_SIZE; RowIdx++)
+    {
+        for (s32 ColIdx = 0; ColIdx < MAX_PIECE_SIZE; ColIdx++)
+        {
+            if (Definition.Balls[RowIdx][ColIdx])
+            {
+                if (RowIdx <= MinRowIdx)
+                {
+                    MinRowIdx = RowIdx;
+                }
+
+                if (ColIdx <= MinColIdx)
+                {
+                    MinColIdx = ColIdx;
+                }
+            }
+        }
+    }
+
+    // shift set bits up and to the left as much as possible
+    for (s32 RowIdx = MinRowIdx; RowIdx < MAX_PIECE_SIZE; RowIdx++)
+    {
+        for (s32 ColIdx = MinColIdx; ColIdx < MAX_PIECE_SIZE; ColIdx++)
+        {
+            Definition.Balls[RowIdx - MinRowIdx][ColIdx - MinColIdx] = Definition.Balls[RowIdx][ColIdx];
+        }
+    }
+
+    // clear remaining bits
+    for (s32 RowIdx = MAX_PIECE_SIZE - MinRowIdx; RowIdx < MAX_PIECE_SIZE; RowIdx++)
+    {
+        for (s32 ColIdx = 0; ColIdx < MAX_PIECE_SIZE; ColIdx++)
+        {
+            Definition.Balls[RowIdx][ColIdx] = 0;
+        }
+    }
+
+    for (s32 ColIdx = MAX_PIECE_SIZE - MinColIdx; ColIdx < MAX_PIECE_SIZE; ColIdx++)
+    {
+        for (s32 RowIdx = 0; RowIdx < MAX_PIECE_SIZE; RowIdx++)
+        {
+            Definition.Balls[RowIdx][ColIdx] = 0;
+        }
+    }
+}
+
+s32 CountTrailingZeros(const u64 Value)
+{
+    // note: result is undefined for zero input
+#if defined(_MSC_VER)
+    unsigned long Index;
+    _BitScanForward64(&Index, Value);
+    return (s32)Index;
+#else
+    return (s32)__builtin_ctzll(Value);
+#endif
+}
+
+s32 CountSetBits(const u64 Value)
+{
+#if defined(_MSC_VER)
+    return (s32)__popcnt64(Value);
+#else
+    return (s32)__builtin_popcountll(Value);
+#endif
+}
+
+// bitboard placement arrays have this many unused masks at the end, so that FindFreePlacements can read whole vectors
+// past the last range
+constexpr s32 PLACEMENT_PADDING = 7;
+
+// sets bit n of the result if Placements[n] doesn't overlap OccupiedMask, testing 8 (AVX-512) or 4 (AVX2) placements
+// per instruction, or 4 at a time without branches in the scalar version. NumPlacements can be at most 64, and up to
+// PLACEMENT_PADDING masks past the end may be read
+u64 FindFreePlacementsScalar(const u64* Placements, const s32 NumPlacements, const u64 OccupiedMask)
+{
+    assert(NumPlacements <= 64);
+
+    u64 FreeMask = 0u;
+    for (s32 PlacementIdx = 0; PlacementIdx < NumPlacements; PlacementIdx += 4)
+    {
+        for (s32 LaneIdx = 0; LaneIdx < 4; LaneIdx++)
+        {
+            FreeMask |= (u64)((Placements[PlacementIdx + LaneIdx] & OccupiedMask) == 0u) << (PlacementIdx + LaneIdx);
+        }
+    }
+
+    // drop the bits of any masks read past the end
+    return (NumPlacements < 64) ? (FreeMask & ((1ull << NumPlacements) - 1u)) : FreeMask;
+}
+
+#if defined(__AVX2__)
+u64 FindFreePlacementsAVX2(const u64* Placements, const s32 NumPlacements, const u64 OccupiedMask)
+{
+    assert(NumPlacements <= 64);
+
+    u64 FreeMask = 0u;
+    const __m256i Occupied = _mm256_set1_epi64x((long long)OccupiedMask);
+    for (s32 PlacementIdx = 0; PlacementIdx < NumPlacements; PlacementIdx += 4)
+    {
+        const __m256i Masks = _mm256_loadu_si256((const __m256i*)(Placements + PlacementIdx));
+        const __m256i IsFree = _mm256_cmpeq_epi64(_mm256_and_si256(Masks, Occupied), _mm256_setzero_si256());
+        FreeMask |= (u64)_mm256_movemask_pd(_mm256_castsi256_pd(IsFree)) << PlacementIdx;
+    }
+    return (NumPlacements < 64) ? (FreeMask & ((1ull << NumPlacements) - 1u)) : FreeMask;
+}
+#endif
+
+#if defined(__AVX512F__)
+u64 FindFreePlacementsAVX512(const u64* Placements, const s32 NumPlacements, const u64 OccupiedMask)
+{
+    assert(NumPlacements <= 64);
+
+    u64 FreeMask = 0u;
+    const __m512i Occupied = _mm512_set1_epi64((long long)OccupiedMask);
+    for (s32 PlacementIdx = 0; PlacementIdx < NumPlacements; PlacementIdx += 8)
+    {
+        const __m512i Masks = _mm512_loadu_si512(Placements + PlacementIdx);
+        FreeMask |= (u64)_mm512_testn_epi64_mask(Masks, Occupied) << PlacementIdx;
+    }
+    return (NumPlacements < 64) ? (FreeMask & ((1ull << NumPlacements) - 1u)) : FreeMask;
+}
+#endif
+
+// the widest version the compiler targets
+inline u64 FindFreePlacements(const u64* Placements, const s32 NumPlacements, const u64 OccupiedMask)
+{
+#if defined(__AVX512F__)
+    return FindFreePlacementsAVX512(Placements, NumPlacements, OccupiedMask);
+#elif defined(__AVX2__)
+    return FindFreePlacementsAVX2(Placements, NumPlacements, OccupiedMask);
+#else
+    return FindFreePlacementsScalar(Placements, NumPlacements, OccupiedMask);
+#endif
+}
+
+constexpr u32 ComputePackedRepresentation(const piece_definition& Definition)
+{
+    u32 Packed = 0;
+    for (s32 RowIdx = 0; RowIdx < MAX_PIECE_SIZE; RowIdx++)
+    {
+        for (s32 ColIdx = 0; ColIdx < MAX_PIECE_SIZE; ColIdx++)
+        {
+            Packed <<= 1;
+            Packed |= Definition.Balls[RowIdx][ColIdx];
+        }
+    }
+    return Packed;
+}
+
+u64 HashSubproblemKey(const subproblem_key& Key)
+{
+    u64 Hash = Key.RemainingPieceBitFlags;
+    for (s32 RowIdx = 0; RowIdx < MAX_BOARD_SIZE; RowIdx += 4)
+    {
+        u64 Rows;
+        memcpy(&Rows, &Key.EmptyCellRows[RowIdx], sizeof(Rows));
+        Hash = (Hash ^ Rows) * 0x9E3779B97F4A7C15ull;
+        Hash ^= Hash >> 29;
+    }
+    return Hash;
+}
+
+solution_cache::solution_cache(const size_t MaxBytes) : NumHits(0), NumMisses(0), NumStores(0), NumEvictions(0)
+{
+    // use the largest power-of-two number of buckets that fits within the memory cap
+    size_t NumBuckets = 1;
+    while (NumBuckets * 2 * sizeof(bucket) <= MaxBytes)
+    {
+        NumBuckets *= 2;
+    }
+
+    Buckets.resize(NumBuckets);
+    BucketIdxMask = NumBuckets - 1;
+    for (bucket& Bucket : Buckets)
+    {
+        for (entry& Entry : Bucket.Entries)
+        {
+            Entry.IsValid = false;
+        }
+    }
+}
+
+bool solution_cache::Lookup(const subproblem_key& Key, u64& OutNumSolutions)
+{
+    const u64 BucketIdx = HashSubproblemKey(Key) & BucketIdxMask;
+    {
+        std::lock_guard<std::mutex> Lock(Locks[BucketIdx % NUM_LOCKS]);
+        for (const entry& Entry : Buckets[BucketIdx].Entries)
+        {
+            if (Entry.IsValid && Entry.Key == Key)
+            {
+                OutNumSolutions = Entry.NumSolutions;
+                NumHits.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+    }
+
+    NumMisses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void solution_cache::Store(const subproblem_key& Key, const u64 NumSolutions, const u64 NumStatesSearched)
+{
+    const u64 BucketIdx = HashSubproblemKey(Key) & BucketIdxMask;
+    std::lock_guard<std::mutex> Lock(Locks[BucketIdx % NUM_LOCKS]);
+
+    // reuse a matching or unused entry if possible, otherwise evict the entry that was cheapest to compute
+    entry* StoreEntry = nullptr;
+    for (entry& Entry : Buckets[BucketIdx].Entries)
+    {
+        if (!Entry.IsValid || Entry.Key == Key)
+        {
+            StoreEntry = &Entry;
+            break;
+        }
+
+        if (!StoreEntry || Entry.NumStatesSearched < StoreEntry->NumStatesSearched)
+        {
+            StoreEntry = &Entry;
+        }
+    }
+
+    if (StoreEntry->IsValid && !(StoreEntry->Key == Key))
+    {
+        NumEvictions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    StoreEntry->Key = Key;
+    StoreEntry->IsValid = true;
+    StoreEntry->NumStatesSearched = (NumStatesSearched > UINT32_MAX) ? UINT32_MAX : (u32)NumStatesSearched;
+    StoreEntry->NumSolutions = NumSolutions;
+    NumStores.fetch_add(1, std::memory_order_relaxed);
+}
+
+void search_control::Begin()
+{
+    Status.store(IsCancelled.load(std::memory_order_relaxed) ? search_status::Cancelled : search_status::Complete, std::memory_order_relaxed);
+    NumBoardStates.store(0, std::memory_order_relaxed);
+    NumSolutions.store(0, std::memory_order_relaxed);
+    if (MaxTimeSec > 0.f)
+    {
+        Deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<f64>(MaxTimeSec));
+    }
+}
+
+bool search_control::CheckLimits(const u64 NumNewBoardStates)
+{
+    const u64 NumStates = NumBoardStates.fetch_add(NumNewBoardStates, std::memory_order_relaxed) + NumNewBoardStates;
+    if (IsCancelled.load(std::memory_order_relaxed))
+    {
+        Stop(search_status::Cancelled);
+    }
+    else if (MaxBoardStates && NumStates >= MaxBoardStates)
+    {
+        Stop(search_status::StateLimitReached);
+    }
+    else if (MaxTimeSec > 0.f && std::chrono::steady_clock::now() >= Deadline)
+    {
+        Stop(search_status::TimeLimitReached);
+    }
+    return IsStopped();
+}
+
+bool search_control::TryAddSolution()
+{
+    assert(MaxSolutions > 0);
+    const u64 NumFound = NumSolutions.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (NumFound >= MaxSolutions)
+    {
+        Stop(search_status::SolutionLimitReached);
+    }
+    return NumFound <= MaxSolutions;
+}
+
+void search_control::Stop(const search_status Reason)
+{
+    u8 Expected = search_status::Complete;
+    Status.compare_exchange_strong(Expected, (u8)Reason, std::memory_order_relaxed);
+}
+
+// threads are numbered from 0, and a thread's number is reused once it exits. so the threads that each solve starts
+// share rows of the timeline, rather than every one of them getting a new row
+struct trace_thread_id
+{
+    struct pool
+    {
+        std::mutex Lock;
+        std::vector<bool> IsUsed;
+    };
+
+    u32 Id;
+
+    static pool& GetPool()
+    {
+        static pool Pool;
+        return Pool;
+    }
+
+    trace_thread_id()
+    {
+        pool& Pool = GetPool();
+        std::lock_guard<std::mutex> Guard(Pool.Lock);
+        Id = (u32)(std::find(Pool.IsUsed.begin(), Pool.IsUsed.end(), false) - Pool.IsUsed.begin());
+        if (Id == Pool.IsUsed.size())
+        {
+            Pool.IsUsed.push_back(false);
+        }
+        Pool.IsUsed[Id] = true;
+    }
+
+    ~trace_thread_id()
+    {
+        pool& Pool = GetPool();
+        std::lock_guard<std::mutex> Guard(Pool.Lock);
+        Pool.IsUsed[Id] = false;
+    }
+};
+
+u32 trace_recorder::GetThreadId()
+{
+    static thread_local const trace_thread_id ThreadId;
+    return ThreadId.Id;
+}
+
+void trace_recorder::Add(
+    const char* Name,
+    const u32 ThreadId,
+    const std::chrono::steady_clock::time_point Begin,
+    const std::chrono::steady_clock::time_point End,
+    const char* ArgName,
+    const u64 ArgValue)
+{
+    span Span;
+    Span.Name = Name;
+    Span.ThreadId = ThreadId;
+    Span.BeginSec = std::chrono::duration<f64>(Begin - StartTime).count();
+    Span.DurationSec = std::chrono::duration<f64>(End - Begin).count();
+    Span.ArgName = ArgName;
+    Span.ArgValue = ArgValue;
+
+    std::lock_guard<std::mutex> Guard(Lock);
+    Spans.push_back(Span);
+}
+
+bool trace_recorder::Write(const std::string& Filename, std::string& OutError)
+{
+    FILE* File = fopen(Filename.c_str(), "wb");
+    if (!File)
+    {
+        OutError = "can't open '" + Filename + "' for writing";
+        return false;
+    }
+
+    // every span is a complete ("X") event, with its times in microseconds
+    std::lock_guard<std::mutex> Guard(Lock);
+    fprintf(File, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for (size_t SpanIdx = 0; SpanIdx < Spans.size(); SpanIdx++)
+    {
+        const span& Span = Spans[SpanIdx];
+        fprintf(File, "  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f",
+            Span.Name, Span.ThreadId, 1e6 * Span.BeginSec, 1e6 * Span.DurationSec);
+        if (Span.ArgName)
+        {
+            fprintf(File, ", \"args\": {\"%s\": %llu}", Span.ArgName, (unsigned long long)Span.ArgValue);
+        }
+        fprintf(File, "}%s\n", (SpanIdx + 1 < Spans.size()) ? "," : "");
+    }
+    fprintf(File, "]}\n");
+
+    const bool IsWritten = !ferror(File);
+    fclose(File);
+    if (!IsWritten)
+    {
+        OutError = "couldn't write '" + Filename + "'";
+    }
+    return IsWritten;
+}
+
+// counts a board state towards the control's limits (if there is one), checking them every CHECK_INTERVAL states.
+// returns true if the search should stop
+bool ShouldStopSearch(search_control* Control, u64& NumUncheckedStates)
+{
+    if (!Control || ++NumUncheckedStates < search_control::CHECK_INTERVAL)
+    {
+        return false;
+    }
+    const u64 NumNewStates = NumUncheckedStates;
+    NumUncheckedStates = 0;
+    return Control->CheckLimits(NumNewStates);
+}
+
+// adds the states searched since the last check, once a search is done
+void EndControlledSearch(search_control* Control, const u64 NumUncheckedStates)
+{
+    if (Control)
+    {
+        Control->NumBoardStates.fetch_add(NumUncheckedStates, std::memory_order_relaxed);
+    }
+}
+
+void exact_cover_matrix::Reset(const s32 NewNumColumns)
+{
+    NumColumns = NewNumColumns;
+    Nodes.resize(NumColumns + 1);
+    ColumnSizes.assign(NumColumns + 1, 0);
+
+    for (s32 HeaderIdx = 0; HeaderIdx <= NumColumns; HeaderIdx++)
+    {
+        node& Header = Nodes[HeaderIdx];
+        Header.Left = (HeaderIdx == 0) ? NumColumns : HeaderIdx - 1;
+        Header.Right = (HeaderIdx == NumColumns) ? 0 : HeaderIdx + 1;
+        Header.Up = HeaderIdx;
+        Header.Down = HeaderIdx;
+        Header.ColumnIdx = HeaderIdx;
+        Header.RowIdx = -1;
+    }
+}
+
+void exact_cover_matrix::RemoveColumn(const s32 ColumnIdx)
+{
+    const node& Header = Nodes[ColumnIdx + 1];
+    assert(Header.Down == ColumnIdx + 1);
+    Nodes[Header.Left].Right = Header.Right;
+    Nodes[Header.Right].Left = Header.Left;
+}
+
+void exact_cover_matrix::AddRow(const s32 RowIdx, const s32* ColumnIdxs, const s32 NumColumnIdxs)
+{
+    const s32 FirstNodeIdx = (s32)Nodes.size();
+    for (s32 Idx = 0; Idx < NumColumnIdxs; Idx++)
+    {
+        assert(ColumnIdxs[Idx] >= 0 && ColumnIdxs[Idx] < NumColumns);
+        const s32 HeaderIdx = ColumnIdxs[Idx] + 1;
+        const s32 NodeIdx = (s32)Nodes.size();
+
+        // insert at the bottom of the column, and at the end of the row's circular list
+        node NewNode;
+        NewNode.Left = (Idx == 0) ? NodeIdx : NodeIdx - 1;
+        NewNode.Right = FirstNodeIdx;
+        NewNode.Up = Nodes[HeaderIdx].Up;
+        NewNode.Down = HeaderIdx;
+        NewNode.ColumnIdx = HeaderIdx;
+        NewNode.RowIdx = RowIdx;
+        Nodes.push_back(NewNode);
+
+        Nodes[NewNode.Up].Down = NodeIdx;
+        Nodes[HeaderIdx].Up = NodeIdx;
+        Nodes[NewNode.Left].Right = NodeIdx;
+        Nodes[FirstNodeIdx].Left = NodeIdx;
+        ColumnSizes[HeaderIdx]++;
+    }
+}
+
+void exact_cover_matrix::Cover(const s32 HeaderIdx)
+{
+    node& Header = Nodes[HeaderIdx];
+    Nodes[Header.Left].Right = Header.Right;
+    Nodes[Header.Right].Left = Header.Left;
+
+    for (s32 RowNodeIdx = Header.Down; RowNodeIdx != HeaderIdx; RowNodeIdx = Nodes[RowNodeIdx].Down)
+    {
+        for (s32 NodeIdx = Nodes[RowNodeIdx].Right; NodeIdx != RowNodeIdx; NodeIdx = Nodes[NodeIdx].Right)
+        {
+            const node& Node = Nodes[NodeIdx];
+            Nodes[Node.Up].Down = Node.Down;
+            Nodes[Node.Down].Up = Node.Up;
+            ColumnSizes[Node.ColumnIdx]--;
+        }
+    }
+}
+
+void exact_cover_matrix::Uncover(const s32 HeaderIdx)
+{
+    node& Header = Nodes[HeaderIdx];
+    for (s32 RowNodeIdx = Header.Up; RowNodeIdx != HeaderIdx; RowNodeIdx = Nodes[RowNodeIdx].Up)
+    {
+        for (s32 NodeIdx = Nodes[RowNodeIdx].Left; NodeIdx != RowNodeIdx; NodeIdx = Nodes[NodeIdx].Left)
+        {
+            const node& Node = Nodes[NodeIdx];
+            Nodes[Node.Up].Down = NodeIdx;
+            Nodes[Node.Down].Up = NodeIdx;
+            ColumnSizes[Node.ColumnIdx]++;
+        }
+    }
+
+    Nodes[Header.Left].Right = HeaderIdx;
+    Nodes[Header.Right].Left = HeaderIdx;
+}
+
+s32 exact_cover_matrix::ChooseColumn() const
+{
+    s32 BestHeaderIdx = 0;
+    for (s32 HeaderIdx = Nodes[0].Right; HeaderIdx != 0; HeaderIdx = Nodes[HeaderIdx].Right)
+    {
+        if (BestHeaderIdx == 0 || ColumnSizes[HeaderIdx] < ColumnSizes[BestHeaderIdx])
+        {
+            BestHeaderIdx = HeaderIdx;
+        }
+    }
+    return BestHeaderIdx;
+}
+
+solver::arena& solver::ResolveArena(arena* Arena)
+{
+    static thread_local arena ThreadArena;
+    return Arena ? *Arena : ThreadArena;
+}
+
+solution_sink& solver::BeginControlledSearch(
+    search_control* Control,
+    solution_sink& OutSolutions,
+    limited_solution_sink& LimitedSolutions)
+{
+    if (!Control)
+    {
+        return OutSolutions;
+    }
+
+    Control->Begin();
+    if (!Control->MaxSolutions)
+    {
+        return OutSolutions;
+    }
+
+    LimitedSolutions.Sink = &OutSolutions;
+    LimitedSolutions.Control = Control;
+    return LimitedSolutions;
+}
+
+constexpr solver::search_piece_table solver::BuildSearchPieces(const piece_definition (&Pieces)[NUM_PIECES])
+{
+    // expand each piece out into its orientations
+    struct expanded_representation
+    {
+        piece_definition Definition;
+        u32 Packed;
+    };
+
+    expanded_representation PieceOrientations[NUM_PIECES][2 * NUM_ROTATIONS] = {};
+
+    for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+    {
+        // orientation 0 is unchanged
+        PieceOrientations[PieceIdx][0].Definition = Pieces[PieceIdx];
+
+        // repeatedly rotate by 90 to get orientations 1, 2, 3
+        for (s32 OrientationIdx = 0; OrientationIdx < NUM_ROTATIONS - 1; OrientationIdx++)
+        {
+            Rotate(PieceOrientations[PieceIdx][OrientationIdx].Definition, PieceOrientations[PieceIdx][OrientationIdx + 1].Definition);
+        }
+
+        // orientation 4 is orientation 0, flipped vertically
+        Flip(PieceOrientations[PieceIdx][0].Definition, PieceOrientations[PieceIdx][NUM_ROTATIONS].Definition);
+
+        // repeatedly rotate by 90 to get orientations 5, 6, 7
+        for (s32 OrientationIdx = 0; OrientationIdx < NUM_ROTATIONS - 1; OrientationIdx++)
+        {
+            Rotate(PieceOrientations[PieceIdx][NUM_ROTATIONS + OrientationIdx].Definition, PieceOrientations[PieceIdx][NUM_ROTATIONS + OrientationIdx + 1].Definition);
+        }
+    }
+
+    // move the set bits up and to the left as far as possible
+    for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+    {
+        for (s32 OrientationIdx = 0; OrientationIdx < 2 * NUM_ROTATIONS; OrientationIdx++)
+        {
+            PushUpAndLeft(PieceOrientations[PieceIdx][OrientationIdx].Definition);
+        }
+    }
+
+    // store a packed representation of each orientation to aid de-duplication
+    for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+    {
+        for (s32 OrientationIdx = 0; OrientationIdx < 2 * NUM_ROTATIONS; OrientationIdx++)
+        {
+            PieceOrientations[PieceIdx][OrientationIdx].Packed = ComputePackedRepresentation(PieceOrientations[PieceIdx][OrientationIdx].Definition);
+        }
+    }
+
+
+    // convert from list of all orientations into a list of unique orientations
+    struct intermediate_representation
+    {
+        expanded_representation Orientations[2 * NUM_ROTATIONS];
+        u8 NumOrientations;
+    };
+
+    intermediate_representation IntermediatePieces[NUM_PIECES] = {};
+
+    for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+    {
+        intermediate_representation& IntermediatePiece = IntermediatePieces[PieceIdx];
+        IntermediatePiece.NumOrientations = 0;
+        for (s32 OrientationIdx = 0; OrientationIdx < 2 * NUM_ROTATIONS; OrientationIdx++)
+        {
+            const expanded_representation& Orientation = PieceOrientations[PieceIdx][OrientationIdx];
+
+            bool IsOrientationUnique = true;
+            for (s32 OtherOrientationIdx = 0; OtherOrientationIdx < IntermediatePiece.NumOrientations; OtherOrientationIdx++)
+            {
+                const expanded_representation& OtherOrientation = IntermediatePiece.Orientations[OtherOrientationIdx];
+                if (Orientation.Packed == OtherOrientation.Packed)
+                {
+                    IsOrientationUnique = false;
+                    break;
+                }
+            }
+
+            if (IsOrientationUnique)
+            {
+                IntermediatePiece.Orientations[IntermediatePiece.NumOrientations++] = Orientation;
+            }
+        }
+    }
+
+
+    // convert from intermediate representation to the representation used for searching
+    search_piece_table Table = {};
+    for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+    {
+        intermediate_representation& IntermediatePiece = IntermediatePieces[PieceIdx];
+        search_piece& SearchPiece = Table.Pieces[PieceIdx];
+        SearchPiece.NumOrientations = IntermediatePiece.NumOrientations;
+
+        for (s32 OrientationIdx = 0; OrientationIdx < IntermediatePiece.NumOrientations; OrientationIdx++)
+        {
+            SearchPiece.NumBalls = 0;
+            piece_orientation& SearchOrientation = SearchPiece.Orientations[OrientationIdx];
+            expanded_representation& IntermediateOrientation = IntermediatePiece.Orientations[OrientationIdx];
+            for (s32 RowIdx = 0; RowIdx < MAX_PIECE_SIZE; RowIdx++)
+            {
+                for (s32 ColIdx = 0; ColIdx < MAX_PIECE_SIZE; ColIdx++)
+                {
+                    if (IntermediateOrientation.Definition.Balls[RowIdx][ColIdx])
+                    {
+                        // store the row and column of each ball that makes up this piece
+                        cell_ref& CellRef = SearchOrientation.Balls[SearchPiece.NumBalls++];
+                        CellRef.RowIdx = (u8)RowIdx;
+                        CellRef.ColIdx = (u8)ColIdx;
+                    }
+                }
+            }
+        }
+    }
+
+    return Table;
+}
+
+solver::solver()
+{
+    // the standard set is expanded at compile time, so a default solver needs no setup
+    static constexpr search_piece_table STANDARD_SEARCH_PIECES = BuildSearchPieces(STANDARD_PIECES);
+    memcpy(SearchPieces, STANDARD_SEARCH_PIECES.Pieces, sizeof(SearchPieces));
+}
+
+void solver::Initialize(const piece_definition (&Pieces)[NUM_PIECES])
+{
+    const search_piece_table Table = BuildSearchPieces(Pieces);
+    memcpy(SearchPieces, Table.Pieces, sizeof(SearchPieces));
+}
+
+bool solver::CheckBoard(const board& Board, std::string& OutError) const
+{
+    // the cells covered by each piece, in row-major order
+    cell_ref PieceCells[NUM_PIECES][MAX_BALLS];
+    s32 NumPieceCells[NUM_PIECES] = {};
+    s32 NumEmptyCells = 0;
+    char Error[128];
+    for (s32 RowIdx = 0; RowIdx < MAX_BOARD_SIZE; RowIdx++)
+    {
+        for (s32 ColIdx = 0; ColIdx < MAX_BOARD_SIZE; ColIdx++)
+        {
+            const cell_value CellValue = Board.Cells[RowIdx][ColIdx];
+            NumEmptyCells += (CellValue == cell_value::Empty);
+            if (!IsPiece(CellValue))
+            {
+                continue;
+            }
+
+            const s32 PieceIdx = CellValue - cell_value::Piece01;
+            if (NumPieceCells[PieceIdx] == SearchPieces[PieceIdx].NumBalls)
+            {
+                snprintf(Error, sizeof(Error), "piece %c covers more than %d cells", 'A' + PieceIdx, SearchPieces[PieceIdx].NumBalls);
+                OutError = Error;
+                return false;
+            }
+            PieceCells[PieceIdx][NumPieceCells[PieceIdx]++] = { (u8)RowIdx, (u8)ColIdx };
+        }
+    }
+
+    s32 NumRemainingBalls = 0;
+    for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+    {
+        const search_piece& Piece = SearchPieces[PieceIdx];
+        if (NumPieceCells[PieceIdx] == 0)
+        {
+            NumRemainingBalls += Piece.NumBalls;
+            continue;
+        }
+        if (NumPieceCells[PieceIdx] != Piece.NumBalls)
+        {
+            snprintf(Error, sizeof(Error), "piece %c covers %d cells, expected %d", 'A' + PieceIdx, NumPieceCells[PieceIdx], Piece.NumBalls);
+            OutError = Error;
+            return false;
+        }
+
+        // orientations are pushed up and to the left, so compare the cells relative to the corner of their bounds
+        const s32 TopRowIdx = PieceCells[PieceIdx][0].RowIdx;
+        s32 LeftColIdx = MAX_BOARD_SIZE;
+        for (s32 CellIdx = 0; CellIdx < Piece.NumBalls; CellIdx++)
+        {
+            LeftColIdx = (PieceCells[PieceIdx][CellIdx].ColIdx < LeftColIdx) ? PieceCells[PieceIdx][CellIdx].ColIdx : LeftColIdx;
+        }
+
+        u32 CellMask = 0;
+        for (s32 CellIdx = 0; CellIdx < Piece.NumBalls; CellIdx++)
+        {
+            const s32 RowOffset = PieceCells[PieceIdx][CellIdx].RowIdx - TopRowIdx;
+            const s32 ColOffset = PieceCells[PieceIdx][CellIdx].ColIdx - LeftColIdx;
+            CellMask |= (RowOffset < MAX_PIECE_SIZE && ColOffset < MAX_PIECE_SIZE) ? 1u << (RowOffset * MAX_PIECE_SIZE + ColOffset) : 0u;
+        }
+
+        bool IsOrientation = false;
+        for (s32 OrientationIdx = 0; OrientationIdx < Piece.NumOrientations && !IsOrientation; OrientationIdx++)
+        {
+            u32 OrientationMask = 0;
+            for (s32 BallIdx = 0; BallIdx < Piece.NumBalls; BallIdx++)
+            {
+                const cell_ref& Ball = Piece.Orientations[OrientationIdx].Balls[BallIdx];
+                OrientationMask |= 1u << (Ball.RowIdx * MAX_PIECE_SIZE + Ball.ColIdx);
+            }
+            IsOrientation = (CellMask == OrientationMask);
+        }
+        if (!IsOrientation)
+        {
+            snprintf(Error, sizeof(Error), "the cells of piece %c aren't one of its orientations", 'A' + PieceIdx);
+            OutError = Error;
+            return false;
+        }
+    }
+
+    if (NumEmptyCells != NumRemainingBalls)
+    {
+        snprintf(Error, sizeof(Error), "board has %d empty cells, but the remaining pieces have %d balls", NumEmptyCells, NumRemainingBalls);
+        OutError = Error;
+        return false;
+    }
+    return true;
+}
+
+
+void solver::BuildGridTables(
+    const board& InputBoard,
+    const s32 NumRows,
+    const s32 NumCols,
+    grid_tables& OutTables) const
+{
+    // pre-compute the empty cells
+    OutTables.NumEmptyCells = 0;
+    {
+        for (s32 RowIdx = 0; RowIdx < MAX_BOARD_SIZE; RowIdx++)
+        {
+            for (s32 ColIdx = 0; ColIdx < MAX_BOARD_SIZE; ColIdx++)
+            {
+                if (InputBoard.Cells[RowIdx][ColIdx] == cell_value::Empty)
+                {
+                    cell_ref& CellRef = OutTables.EmptyCells[OutTables.NumEmptyCells++];
+                    CellRef.RowIdx = RowIdx;
+                    CellRef.ColIdx = ColIdx;
+                }
+            }
+        }
+    }
+
+    // pre-compute, for each empty cell, every placement of every piece/orientation/ball that covers the cell and only
+    // covers cells that are empty on the input board
+    std::vector<grid_tables::placement>& Placements = OutTables.Placements;
+    Placements.clear();
+    {
+        Placements.reserve(NUM_VALID_CELLS * 64);
+        for (s32 EmptyCellIdx = 0; EmptyCellIdx < OutTables.NumEmptyCells; EmptyCellIdx++)
+        {
+            const s32 RowIdx = OutTables.EmptyCells[EmptyCellIdx].RowIdx;
+            const s32 ColIdx = OutTables.EmptyCells[EmptyCellIdx].ColIdx;
+            for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+            {
+                OutTables.PlacementOffsets[EmptyCellIdx][PieceIdx] = (u16)Placements.size();
+
+                const search_piece& Piece = SearchPieces[PieceIdx];
+                for (s32 OrientationIdx = 0; OrientationIdx < Piece.NumOrientations; OrientationIdx++)
+                {
+                    const piece_orientation& Orientation = Piece.Orientations[OrientationIdx];
+                    for (s32 PlacedBallIdx = 0; PlacedBallIdx < Piece.NumBalls; PlacedBallIdx++)
+                    {
+                        const s32 OffsetRowIdx = RowIdx - Orientation.Balls[PlacedBallIdx].RowIdx;
+                        const s32 OffsetColIdx = ColIdx - Orientation.Balls[PlacedBallIdx].ColIdx;
+
+                        grid_tables::placement Placement;
+                        bool CanPlace = true;
+                        for (s32 BallIdx = 0; BallIdx < Piece.NumBalls && CanPlace; BallIdx++)
+                        {
+                            const s32 BallRowIdx = OffsetRowIdx + Orientation.Balls[BallIdx].RowIdx;
+                            const s32 BallColIdx = OffsetColIdx + Orientation.Balls[BallIdx].ColIdx;
+                            const bool IsValidCellIdx = (BallRowIdx >= 0) && (BallRowIdx < NumRows) && (BallColIdx >= 0) && (BallColIdx < NumCols);
+
+                            CanPlace = IsValidCellIdx && InputBoard.Cells[BallRowIdx][BallColIdx] == cell_value::Empty;
+                            Placement.Balls[BallIdx].RowIdx = (u8)BallRowIdx;
+                            Placement.Balls[BallIdx].ColIdx = (u8)BallColIdx;
+                        }
+
+                        if (CanPlace)
+                        {
+                            Placements.push_back(Placement);
+                        }
+                    }
+                }
+            }
+            OutTables.PlacementOffsets[EmptyCellIdx][NUM_PIECES] = (u16)Placements.size();
+        }
+    }
+}
+
+template <s32 NUM_BALLS>
+s32 solver::FindFilledBall(const board& Board, const grid_tables::placement& Placement)
+{
+    s32 BallIdx;
+    for (BallIdx = 0; BallIdx < NUM_BALLS; BallIdx++)
+    {
+        const cell_ref Ball = Placement.Balls[BallIdx];
+        if (Board.Cells[Ball.RowIdx][Ball.ColIdx] != cell_value::Empty)
+        {
+            break;
+        }
+    }
+    return BallIdx;
+}
+
+// calls Func with NumBalls as a std::integral_constant, so that loops over the balls of a piece can have a fixed trip
+// count (and be unrolled) without the ball count being fixed for every piece set
+template <typename func>
+void DispatchNumBalls(const s32 NumBalls, func&& Func)
+{
+    static_assert(MAX_BALLS == 5, "add a case for each ball count");
+    switch (NumBalls)
+    {
+        case 1:
+            Func(std::integral_constant<s32, 1>());
+            break;
+        case 2:
+            Func(std::integral_constant<s32, 2>());
+            break;
+        case 3:
+            Func(std::integral_constant<s32, 3>());
+            break;
+        case 4:
+            Func(std::integral_constant<s32, 4>());
+            break;
+        case 5:
+            Func(std::integral_constant<s32, 5>());
+            break;
+        default:
+            assert(false);
+    }
+}
+
+template <bool COLLECT_STATS, s32 NUM_BALLS>
+void solver::TryGridPlacements(
+    const grid_search_state& SearchState,
+    const grid_tables& Tables,
+    const s32 PieceIdx,
+    const u32 PlacementBegin,
+    const u32 PlacementEnd,
+    const bool IsLastPiece,
+    std::vector<grid_search_state>& SearchStates,
+    solution_sink& OutSolutions,
+    search_stats& Stats) const
+{
+    if (COLLECT_STATS)
+    {
+        Stats.NumOrientationsTested += PlacementEnd - PlacementBegin;
+    }
+    for (u32 PlacementIdx = PlacementBegin; PlacementIdx < PlacementEnd; PlacementIdx++)
+    {
+        const grid_tables::placement& Placement = Tables.Placements[PlacementIdx];
+        const s32 BallIdx = FindFilledBall<NUM_BALLS>(SearchState.Board, Placement);
+        const bool CanPlace = (BallIdx == NUM_BALLS);
+
+        if (COLLECT_STATS)
+        {
+            // the ball that didn't fit was tested too
+            Stats.NumBallsTested += CanPlace ? NUM_BALLS : BallIdx + 1;
+        }
+
+        if (CanPlace)
+        {
+            grid_search_state NewSearchState = SearchState;
+
+            const cell_value NewCellValue = PieceIndexToCellValue(PieceIdx);
+            for (s32 BallIdx = 0; BallIdx < NUM_BALLS; BallIdx++)
+            {
+                const cell_ref Ball = Placement.Balls[BallIdx];
+                NewSearchState.Board.Cells[Ball.RowIdx][Ball.ColIdx] = NewCellValue;
+            }
+            NewSearchState.RemainingPieceBitFlags &= ~(1u << PieceIdx);
+            NewSearchState.EmptyCellIdx++;
+
+            if (!IsLastPiece)
+            {
+                SearchStates.push_back(NewSearchState);
+            }
+            else
+            {
+                OutSolutions.Add(NewSearchState.Board);
+            }
+        }
+    }
+}
+
+template <bool COLLECT_STATS>
+void solver::SolveGrid(
+    const board& InputBoard,
+    const s32 NumRows,
+    const s32 NumCols,
+    search_control* Control,
+    solution_sink& OutSolutions,
+    search_stats& OutStats,
+    arena& Arena) const
+{
+    grid_tables& Tables = Arena.GridTables;
+    BuildGridTables(InputBoard, NumRows, NumCols, Tables);
+
+    // construct the initial search state
+    grid_search_state InitialSearchState;
+    {
+        InitialSearchState.Board = InputBoard;
+        InitialSearchState.EmptyCellIdx = 0;
+
+        InitialSearchState.RemainingPieceBitFlags = 0u;
+        for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+        {
+            InitialSearchState.RemainingPieceBitFlags |= (1u << PieceIdx);
+        }
+
+        for (s32 RowIdx = 0; RowIdx < NumRows; RowIdx++)
+        {
+            for (s32 ColIdx = 0; ColIdx < NumCols; ColIdx++)
+            {
+                const cell_value CellValue = InputBoard.Cells[RowIdx][ColIdx];
+                if (IsPiece(CellValue))
+                {
+                    const s32 PieceIdx = CellValueToPieceIndex(CellValue);
+                    InitialSearchState.RemainingPieceBitFlags &= ~(1u << PieceIdx);
+                }
+            }
+        }
+    }
+
+    search_stats Stats;
+    u64 NumUncheckedStates = 0;
+
+    std::vector<grid_search_state>& SearchStates = Arena.GridSearchStates;
+    SearchStates.clear();
+    SearchStates.reserve(1024);
+    SearchStates.push_back(InitialSearchState);
+
+    while (!SearchStates.empty())
+    {
+        if (ShouldStopSearch(Control, NumUncheckedStates))
+        {
+            break;
+        }
+        if (COLLECT_STATS)
+        {
+            Stats.NumBoardStatesTested++;
+        }
+        grid_search_state SearchState = SearchStates.back();
+        SearchStates.pop_back();
+
+        // find the next empty cell on the board
+        s32 EmptyCellIdx;
+        for (EmptyCellIdx = SearchState.EmptyCellIdx; EmptyCellIdx < Tables.NumEmptyCells; EmptyCellIdx++)
+        {
+            cell_ref Cell = Tables.EmptyCells[EmptyCellIdx];
+            if (SearchState.Board.Cells[Cell.RowIdx][Cell.ColIdx] == cell_value::Empty)
+            {
+                break;
+            }
+        }
+
+        assert(EmptyCellIdx < Tables.NumEmptyCells);
+
+        const u32 RemainingPieceBitFlags = SearchState.RemainingPieceBitFlags;
+        const bool IsLastPiece = !(RemainingPieceBitFlags & (RemainingPieceBitFlags - 1u));
+
+        // try to fill the empty cell with every pre-computed placement of every available piece
+        for (u32 PieceBitFlags = RemainingPieceBitFlags; PieceBitFlags; PieceBitFlags &= PieceBitFlags - 1u)
+        {
+            const s32 PieceIdx = CountTrailingZeros(PieceBitFlags);
+            const u16 PlacementBegin = Tables.PlacementOffsets[EmptyCellIdx][PieceIdx];
+            const u16 PlacementEnd = Tables.PlacementOffsets[EmptyCellIdx][PieceIdx + 1];
+            DispatchNumBalls(SearchPieces[PieceIdx].NumBalls, [&](const auto NumBalls)
+            {
+                TryGridPlacements<COLLECT_STATS, NumBalls>(SearchState, Tables, PieceIdx, PlacementBegin, PlacementEnd, IsLastPiece, SearchStates, OutSolutions, Stats);
+            });
+        }
+
+        if (COLLECT_STATS)
+        {
+            Stats.MaxStackDepth = (SearchStates.size() > Stats.MaxStackDepth) ? SearchStates.size() : Stats.MaxStackDepth;
+        }
+    }
+
+    EndControlledSearch(Control, NumUncheckedStates);
+    OutStats = Stats;
+}
+
+void solver::Solve(
+    const board& InputBoard,
+    const s32 NumRows,
+    const s32 NumCols,
+    search_control* Control,
+    solution_sink& OutSolutions,
+    search_stats* OutStats,
+    arena* Arena) const
+{
+    limited_solution_sink LimitedSolutions;
+    solution_sink& SearchSolutions = BeginControlledSearch(Control, OutSolutions, LimitedSolutions);
+    if (Control && Control->IsStopped())
+    {
+        if (OutStats)
+        {
+            *OutStats = search_stats();
+        }
+        return;
+    }
+
+    search_stats IgnoredStats;
+    if (OutStats)
+    {
+        SolveGrid<true>(InputBoard, NumRows, NumCols, Control, SearchSolutions, *OutStats, ResolveArena(Arena));
+    }
+    else
+    {
+        SolveGrid<false>(InputBoard, NumRows, NumCols, Control, SearchSolutions, IgnoredStats, ResolveArena(Arena));
+    }
+}
+
+template <bool COLLECT_STATS, s32 NUM_BALLS>
+s32 solver::FindGridPlacement(
+    const board& Board,
+    const grid_tables& Tables,
+    const s32 PlacementBegin,
+    const s32 PlacementEnd,
+    search_stats& Stats) const
+{
+    for (s32 PlacementIdx = PlacementEnd - 1; PlacementIdx >= PlacementBegin; PlacementIdx--)
+    {
+        const s32 BallIdx = FindFilledBall<NUM_BALLS>(Board, Tables.Placements[PlacementIdx]);
+        const bool IsPlaced = (BallIdx == NUM_BALLS);
+
+        if (COLLECT_STATS)
+        {
+            Stats.NumOrientationsTested++;
+            Stats.NumBallsTested += IsPlaced ? NUM_BALLS : BallIdx + 1;
+        }
+
+        if (IsPlaced)
+        {
+            return PlacementIdx;
+        }
+    }
+    return -1;
+}
+
+template <bool COLLECT_STATS>
+void solver::SolveGridInPlace(
+    const board& InputBoard,
+    const s32 NumRows,
+    const s32 NumCols,
+    search_control* Control,
+    solution_sink& OutSolutions,
+    search_stats& OutStats,
+    arena& Arena) const
+{
+    grid_tables& Tables = Arena.GridTables;
+    BuildGridTables(InputBoard, NumRows, NumCols, Tables);
+
+    // a single board is filled in place, and each placement is undone when backtracking past it. for each piece placed
+    // so far, the stack only records the cell it was placed to fill and the placement that was used
+    struct grid_choice
+    {
+        u8 EmptyCellIdx;
+        u8 PieceIdx;
+        u16 PlacementIdx; // placements of the piece below this index have still to be tried
+    };
+
+    board Board = InputBoard;
+    u16 RemainingPieceBitFlags = 0u;
+    for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+    {
+        RemainingPieceBitFlags |= (1u << PieceIdx);
+    }
+    for (s32 RowIdx = 0; RowIdx < NumRows; RowIdx++)
+    {
+        for (s32 ColIdx = 0; ColIdx < NumCols; ColIdx++)
+        {
+            const cell_value CellValue = InputBoard.Cells[RowIdx][ColIdx];
+            if (IsPiece(CellValue))
+            {
+                RemainingPieceBitFlags &= ~(1u << CellValueToPieceIndex(CellValue));
+            }
+        }
+    }
+
+    auto UndoChoice = [&](const grid_choice& Choice)
+    {
+        const grid_tables::placement& Placement = Tables.Placements[Choice.PlacementIdx];
+        for (s32 BallIdx = 0; BallIdx < SearchPieces[Choice.PieceIdx].NumBalls; BallIdx++)
+        {
+            Board.Cells[Placement.Balls[BallIdx].RowIdx][Placement.Balls[BallIdx].ColIdx] = cell_value::Empty;
+        }
+        RemainingPieceBitFlags |= (1u << Choice.PieceIdx);
+    };
+
+    search_stats Stats;
+    u64 NumUncheckedStates = 0;
+
+    grid_choice Choices[NUM_PIECES];
+    s32 Depth = 0;
+    if (RemainingPieceBitFlags && Tables.NumEmptyCells > 0)
+    {
+        Choices[0].EmptyCellIdx = 0;
+        Choices[0].PieceIdx = NUM_PIECES - 1;
+        Choices[0].PlacementIdx = Tables.PlacementOffsets[0][NUM_PIECES];
+        if (COLLECT_STATS)
+        {
+            Stats.NumBoardStatesTested++;
+            Stats.MaxStackDepth = 1;
+        }
+    }
+    else
+    {
+        Depth = -1;
+    }
+
+    while (Depth >= 0)
+    {
+        grid_choice& Choice = Choices[Depth];
+        const s32 EmptyCellIdx = Choice.EmptyCellIdx;
+
+        // find the next placement that fits. pieces and placements are tried in reverse, so that solutions are found in
+        // the same order as the search stack of Solve would find them
+        s32 PieceIdx = Choice.PieceIdx;
+        s32 PlacementIdx = Choice.PlacementIdx;
+        bool IsPlaced = false;
+        while (PieceIdx >= 0 && !IsPlaced)
+        {
+            const s32 PlacementBegin = Tables.PlacementOffsets[EmptyCellIdx][PieceIdx];
+            if (!((RemainingPieceBitFlags >> PieceIdx) & 1u) || PlacementIdx <= PlacementBegin)
+            {
+                // move on to the previous piece, whose placements end where this piece's begin
+                PlacementIdx = PlacementBegin;
+                PieceIdx--;
+                continue;
+            }
+
+            DispatchNumBalls(SearchPieces[PieceIdx].NumBalls, [&](const auto NumBalls)
+            {
+                PlacementIdx = FindGridPlacement<COLLECT_STATS, NumBalls>(Board, Tables, PlacementBegin, PlacementIdx, Stats);
+            });
+            IsPlaced = (PlacementIdx >= PlacementBegin);
+            PlacementIdx = IsPlaced ? PlacementIdx : PlacementBegin;
+        }
+
+        if (!IsPlaced)
+        {
+            // every placement has been tried, so backtrack and undo the placement that led here
+            Depth--;
+            if (Depth >= 0)
+            {
+                UndoChoice(Choices[Depth]);
+            }
+            continue;
+        }
+
+        Choice.PieceIdx = (u8)PieceIdx;
+        Choice.PlacementIdx = (u16)PlacementIdx;
+
+        const grid_tables::placement& Placement = Tables.Placements[PlacementIdx];
+        const cell_value NewCellValue = PieceIndexToCellValue(PieceIdx);
+        for (s32 BallIdx = 0; BallIdx < SearchPieces[PieceIdx].NumBalls; BallIdx++)
+        {
+            Board.Cells[Placement.Balls[BallIdx].RowIdx][Placement.Balls[BallIdx].ColIdx] = NewCellValue;
+        }
+        RemainingPieceBitFlags &= ~(1u << PieceIdx);
+
+        if (!RemainingPieceBitFlags)
+        {
+            OutSolutions.Add(Board);
+            UndoChoice(Choice);
+            continue;
+        }
+
+        // find the next empty cell on the board, and start trying to fill it
+        s32 NextEmptyCellIdx;
+        for (NextEmptyCellIdx = EmptyCellIdx + 1; NextEmptyCellIdx < Tables.NumEmptyCells; NextEmptyCellIdx++)
+        {
+            const cell_ref Cell = Tables.EmptyCells[NextEmptyCellIdx];
+            if (Board.Cells[Cell.RowIdx][Cell.ColIdx] == cell_value::Empty)
+            {
+                break;
+            }
+        }
+
+        assert(NextEmptyCellIdx < Tables.NumEmptyCells);
+
+        if (ShouldStopSearch(Control, NumUncheckedStates))
+        {
+            break;
+        }
+
+        Depth++;
+        Choices[Depth].EmptyCellIdx = (u8)NextEmptyCellIdx;
+        Choices[Depth].PieceIdx = NUM_PIECES - 1;
+        Choices[Depth].PlacementIdx = Tables.PlacementOffsets[NextEmptyCellIdx][NUM_PIECES];
+        if (COLLECT_STATS)
+        {
+            Stats.NumBoardStatesTested++;
+            Stats.MaxStackDepth = ((u64)Depth + 1 > Stats.MaxStackDepth) ? (u64)Depth + 1 : Stats.MaxStackDepth;
+        }
+    }
+
+    EndControlledSearch(Control, NumUncheckedStates);
+    OutStats = Stats;
+}
+
+void solver::SolveInPlace(
+    const board& InputBoard,
+    const s32 NumRows,
+    const s32 NumCols,
+    search_control* Control,
+    solution_sink& OutSolutions,
+    search_stats* OutStats,
+    arena* Arena) const
+{
+    limited_solution_sink LimitedSolutions;
+    solution_sink& SearchSolutions = BeginControlledSearch(Control, OutSolutions, LimitedSolutions);
+    if (Control && Control->IsStopped())
+    {
+        if (OutStats)
+        {
+            *OutStats = search_stats();
+        }
+        return;
+    }
+
+    search_stats IgnoredStats;
+    if (OutStats)
+    {
+        SolveGridInPlace<true>(InputBoard, NumRows, NumCols, Control, SearchSolutions, *OutStats, ResolveArena(Arena));
+    }
+    else
+    {
+        SolveGridInPlace<false>(InputBoard, NumRows, NumCols, Control, SearchSolutions, IgnoredStats, ResolveArena(Arena));
+    }
+}
+
+void solver::BuildBitboardTables(
+    const board& InputBoard,
+    const s32 NumRows,
+    const s32 NumCols,
+    bitboard_tables& OutTables) const
+{
+    // assign a bit to each valid cell, in row-major order, so the lowest clear bit is always the next cell to fill
+    s32 CellBitIdxs[MAX_BOARD_SIZE][MAX_BOARD_SIZE];
+    s32 NumBits = 0;
+    OutTables.InitialOccupiedMask = 0u;
+    for (s32 RowIdx = 0; RowIdx < MAX_BOARD_SIZE; RowIdx++)
+    {
+        for (s32 ColIdx = 0; ColIdx < MAX_BOARD_SIZE; ColIdx++)
+        {
+            CellBitIdxs[RowIdx][ColIdx] = -1;
+
+            const cell_value CellValue = InputBoard.Cells[RowIdx][ColIdx];
+            if (CellValue != cell_value::Invalid)
+            {
+                assert(NumBits < NUM_VALID_CELLS);
+                CellBitIdxs[RowIdx][ColIdx] = NumBits;
+
+                cell_ref& CellRef = OutTables.BitCells[NumBits];
+                CellRef.RowIdx = (u8)RowIdx;
+                CellRef.ColIdx = (u8)ColIdx;
+
+                if (CellValue != cell_value::Empty)
+                {
+                    OutTables.InitialOccupiedMask |= (1ull << NumBits);
+                }
+                NumBits++;
+            }
+        }
+    }
+
+    // split the valid cells into runs which are adjacent in both the bitboard and the board
+    OutTables.NumRowSegments = 0;
+    for (s32 BitIdx = 0; BitIdx < NumBits; BitIdx++)
+    {
+        const cell_ref Cell = OutTables.BitCells[BitIdx];
+        bitboard_tables::row_segment* Segment = (OutTables.NumRowSegments > 0) ? &OutTables.RowSegments[OutTables.NumRowSegments - 1] : nullptr;
+        if (!Segment || Segment->RowIdx != Cell.RowIdx || Segment->ColIdx + Segment->NumBits != Cell.ColIdx)
+        {
+            Segment = &OutTables.RowSegments[OutTables.NumRowSegments++];
+            Segment->BitIdx = (u8)BitIdx;
+            Segment->NumBits = 0;
+            Segment->RowIdx = Cell.RowIdx;
+            Segment->ColIdx = Cell.ColIdx;
+        }
+        Segment->NumBits++;
+    }
+
+    for (s32 BitIdx = 0; BitIdx < NUM_VALID_CELLS; BitIdx++)
+    {
+        OutTables.NeighborMasks[BitIdx] = 0u;
+        if (BitIdx >= NumBits)
+        {
+            continue;
+        }
+
+        constexpr s32 NUM_NEIGHBORS = 4;
+        constexpr s32 NeighborOffsets[NUM_NEIGHBORS][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+        for (s32 NeighborIdx = 0; NeighborIdx < NUM_NEIGHBORS; NeighborIdx++)
+        {
+            const s32 NeighborRowIdx = OutTables.BitCells[BitIdx].RowIdx + NeighborOffsets[NeighborIdx][0];
+            const s32 NeighborColIdx = OutTables.BitCells[BitIdx].ColIdx + NeighborOffsets[NeighborIdx][1];
+            const bool IsValidCellIdx = (NeighborRowIdx >= 0) && (NeighborRowIdx < MAX_BOARD_SIZE) && (NeighborColIdx >= 0) && (NeighborColIdx < MAX_BOARD_SIZE);
+            if (IsValidCellIdx && CellBitIdxs[NeighborRowIdx][NeighborColIdx] >= 0)
+            {
+                OutTables.NeighborMasks[BitIdx] |= (1ull << CellBitIdxs[NeighborRowIdx][NeighborColIdx]);
+            }
+        }
+    }
+
+    OutTables.NumSymmetries = 1;
+    for (s32 BitIdx = 0; BitIdx < NUM_VALID_CELLS; BitIdx++)
+    {
+        OutTables.Symmetries[0][BitIdx] = (u8)BitIdx;
+    }
+
+    // any unused bits can never be filled
+    for (s32 BitIdx = NumBits; BitIdx < NUM_VALID_CELLS; BitIdx++)
+    {
+        OutTables.InitialOccupiedMask |= (1ull << BitIdx);
+    }
+
+    // for each empty cell, store a mask for every placement of every piece that covers the cell
+    // note: placements which overlap a cell that isn't empty on the input board can never fit, so are skipped
+    OutTables.Placements.clear();
+    for (s32 BitIdx = 0; BitIdx < NUM_VALID_CELLS; BitIdx++)
+    {
+        const bool IsEmptyCell = !((OutTables.InitialOccupiedMask >> BitIdx) & 1u);
+
+        for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+        {
+            OutTables.PlacementOffsets[BitIdx][PieceIdx] = (u16)OutTables.Placements.size();
+            if (!IsEmptyCell)
+            {
+                continue;
+            }
+
+            const s32 RowIdx = OutTables.BitCells[BitIdx].RowIdx;
+            const s32 ColIdx = OutTables.BitCells[BitIdx].ColIdx;
+            const search_piece& Piece = SearchPieces[PieceIdx];
+
+            for (s32 OrientationIdx = 0; OrientationIdx < Piece.NumOrientations; OrientationIdx++)
+            {
+                const piece_orientation& Orientation = Piece.Orientations[OrientationIdx];
+
+                for (s32 PlacedBallIdx = 0; PlacedBallIdx < Piece.NumBalls; PlacedBallIdx++)
+                {
+                    const s32 OffsetRowIdx = -Orientation.Balls[PlacedBallIdx].RowIdx;
+                    const s32 OffsetColIdx = -Orientation.Balls[PlacedBallIdx].ColIdx;
+
+                    u64 PlacementMask = 0u;
+                    bool CanPlace = true;
+                    for (s32 BallIdx = 0; BallIdx < Piece.NumBalls; BallIdx++)
+                    {
+                        const s32 BallRowIdx = RowIdx + OffsetRowIdx + Orientation.Balls[BallIdx].RowIdx;
+                        const s32 BallColIdx = ColIdx + OffsetColIdx + Orientation.Balls[BallIdx].ColIdx;
+                        const bool IsValidCellIdx = (BallRowIdx >= 0) && (BallRowIdx < NumRows) && (BallColIdx >= 0) && (BallColIdx < NumCols);
+                        if (!IsValidCellIdx || CellBitIdxs[BallRowIdx][BallColIdx] < 0)
+                        {
+                            CanPlace = false;
+                            break;
+                        }
+
+                        PlacementMask |= (1ull << CellBitIdxs[BallRowIdx][BallColIdx]);
+                    }
+
+                    if (CanPlace && !(PlacementMask & OutTables.InitialOccupiedMask))
+                    {
+                        OutTables.Placements.push_back(PlacementMask);
+                    }
+                }
+            }
+        }
+
+        OutTables.PlacementOffsets[BitIdx][NUM_PIECES] = (u16)OutTables.Placements.size();
+    }
+
+    assert(OutTables.Placements.size() <= UINT16_MAX);
+    OutTables.Placements.resize(OutTables.Placements.size() + PLACEMENT_PADDING, 0u);
+}
+
+void solver::InitializeBitboardTask(
+    const board& InputBoard,
+    const s32 NumRows,
+    const s32 NumCols,
+    const bitboard_tables& Tables,
+    bitboard_task& OutTask) const
+{
+    OutTask.OccupiedMask = Tables.InitialOccupiedMask;
+    OutTask.Depth = 0;
+
+    OutTask.RemainingPieceBitFlags = 0u;
+    for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+    {
+        OutTask.RemainingPieceBitFlags |= (1u << PieceIdx);
+    }
+
+    for (s32 RowIdx = 0; RowIdx < NumRows; RowIdx++)
+    {
+        for (s32 ColIdx = 0; ColIdx < NumCols; ColIdx++)
+        {
+            const cell_value CellValue = InputBoard.Cells[RowIdx][ColIdx];
+            if (IsPiece(CellValue))
+            {
+                const s32 PieceIdx = CellValueToPieceIndex(CellValue);
+                OutTask.RemainingPieceBitFlags &= ~(1u << PieceIdx);
+            }
+        }
+    }
+}
+
+void solver::InitializePieceRanking(
+    const piece_order PieceOrder,
+    const bool IsReversed,
+    piece_ranking& OutRanking) const
+{
+    OutRanking.IsByIndex = (PieceOrder == piece_order::ByIndex);
+    OutRanking.IsAdaptive = (PieceOrder == piece_order::FailFirst);
+    OutRanking.IsReversed = IsReversed && !OutRanking.IsByIndex;
+    OutRanking.NumStatesUntilUpdate = piece_ranking::UPDATE_INTERVAL;
+
+    // by index, the ranks are the piece indices, so a stack search pushes pieces in index order as it always has
+    s32 Order[NUM_PIECES];
+    for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+    {
+        OutRanking.NumPlacementsTested[PieceIdx] = 0;
+        OutRanking.NumPlacementsFailed[PieceIdx] = 0;
+
+        // insertion sort, so pieces with as many balls stay in index order
+        s32 OrderIdx = PieceIdx;
+        for (; OrderIdx > 0 && !OutRanking.IsByIndex && SearchPieces[Order[OrderIdx - 1]].NumBalls < SearchPieces[PieceIdx].NumBalls; OrderIdx--)
+        {
+            Order[OrderIdx] = Order[OrderIdx - 1];
+        }
+        Order[OrderIdx] = PieceIdx;
+    }
+
+    for (s32 OrderIdx = 0; OrderIdx < NUM_PIECES; OrderIdx++)
+    {
+        const s32 Rank = OutRanking.IsReversed ? (NUM_PIECES - 1 - OrderIdx) : OrderIdx;
+        OutRanking.PieceIdxs[Rank] = (u8)Order[OrderIdx];
+        OutRanking.Ranks[Order[OrderIdx]] = (u8)Rank;
+    }
+}
+
+void solver::UpdatePieceRanking(piece_ranking& Ranking) const
+{
+    assert(Ranking.IsAdaptive);
+    Ranking.NumStatesUntilUpdate = piece_ranking::UPDATE_INTERVAL;
+
+    // re-sort the current order by the fraction of placements that didn't fit, keeping the order of equal pieces
+    s32 Order[NUM_PIECES];
+    for (s32 SortedIdx = 0; SortedIdx < NUM_PIECES; SortedIdx++)
+    {
+        const s32 PieceIdx = Ranking.PieceIdxs[Ranking.IsReversed ? (NUM_PIECES - 1 - SortedIdx) : SortedIdx];
+        const u64 NumPieceFailed = Ranking.NumPlacementsFailed[PieceIdx];
+        const u64 NumPieceTested = Ranking.NumPlacementsTested[PieceIdx];
+
+        s32 OrderIdx = SortedIdx;
+        for (; OrderIdx > 0; OrderIdx--)
+        {
+            const s32 OtherPieceIdx = Order[OrderIdx - 1];
+            if (Ranking.NumPlacementsFailed[OtherPieceIdx] * NumPieceTested >= NumPieceFailed * Ranking.NumPlacementsTested[OtherPieceIdx])
+            {
+                break;
+            }
+            Order[OrderIdx] = OtherPieceIdx;
+        }
+        Order[OrderIdx] = PieceIdx;
+    }
+
+    for (s32 OrderIdx = 0; OrderIdx < NUM_PIECES; OrderIdx++)
+    {
+        const s32 Rank = Ranking.IsReversed ? (NUM_PIECES - 1 - OrderIdx) : OrderIdx;
+        Ranking.PieceIdxs[Rank] = (u8)Order[OrderIdx];
+        Ranking.Ranks[Order[OrderIdx]] = (u8)Rank;
+    }
+
+    for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+    {
+        Ranking.NumPlacementsTested[PieceIdx] /= 2;
+        Ranking.NumPlacementsFailed[PieceIdx] /= 2;
+    }
+}
+
+u32 solver::RankPieces(
+    const piece_ranking& Ranking,
+    const u32 PieceBitFlags) const
+{
+    if (Ranking.IsByIndex)
+    {
+        return PieceBitFlags;
+    }
+
+    u32 PieceRankFlags = 0u;
+    for (u32 RemainingBitFlags = PieceBitFlags; RemainingBitFlags; RemainingBitFlags &= RemainingBitFlags - 1u)
+    {
+        PieceRankFlags |= (1u << Ranking.Ranks[CountTrailingZeros(RemainingBitFlags)]);
+    }
+    return PieceRankFlags;
+}
+
+s32 solver::SelectBestBitboardCell(
+    const bitboard_tables& Tables,
+    const cell_order CellOrder,
+    const u64 OccupiedMask,
+    const u16 RemainingPieceBitFlags) const
+{
+    const u64 EmptyMask = ~OccupiedMask;
+
+    if (CellOrder == cell_order::FewestEmptyNeighbors)
+    {
+        s32 BestBitIdx = -1;
+        s32 BestNumEmptyNeighbors = 5;
+        for (u64 Mask = EmptyMask; Mask; Mask &= Mask - 1u)
+        {
+            const s32 BitIdx = CountTrailingZeros(Mask);
+            const s32 NumEmptyNeighbors = CountSetBits(Tables.NeighborMasks[BitIdx] & EmptyMask);
+            if (NumEmptyNeighbors < BestNumEmptyNeighbors)
+            {
+                BestBitIdx = BitIdx;
+                BestNumEmptyNeighbors = NumEmptyNeighbors;
+            }
+        }
+        return BestBitIdx;
+    }
+
+    if (CellOrder == cell_order::FewestPlacements)
+    {
+        s32 BestBitIdx = -1;
+        s32 BestNumPlacements = INT32_MAX;
+        for (u64 Mask = EmptyMask; Mask; Mask &= Mask - 1u)
+        {
+            const s32 BitIdx = CountTrailingZeros(Mask);
+
+            s32 NumPlacements = 0;
+            for (u32 PieceBitFlags = RemainingPieceBitFlags; PieceBitFlags && NumPlacements < BestNumPlacements; PieceBitFlags &= PieceBitFlags - 1u)
+            {
+                const s32 PieceIdx = CountTrailingZeros(PieceBitFlags);
+                const u16 PlacementBegin = Tables.PlacementOffsets[BitIdx][PieceIdx];
+                const u16 PlacementEnd = Tables.PlacementOffsets[BitIdx][PieceIdx + 1];
+                NumPlacements += CountSetBits(FindFreePlacements(Tables.Placements.data() + PlacementBegin, PlacementEnd - PlacementBegin, OccupiedMask));
+            }
+
+            if (NumPlacements == 0)
+            {
+                // this cell can never be filled, so the state has no solutions
+                return -1;
+            }
+
+            if (NumPlacements < BestNumPlacements)
+            {
+                BestBitIdx = BitIdx;
+                BestNumPlacements = NumPlacements;
+                if (NumPlacements == 1)
+                {
+                    break;
+                }
+            }
+        }
+        return BestBitIdx;
+    }
+
+    return CountTrailingZeros(EmptyMask);
+}
+
+// note: row-major order is the common case, so it's kept inline in the searches
+inline s32 solver::SelectBitboardCell(
+    const bitboard_tables& Tables,
+    const cell_order CellOrder,
+    const u64 OccupiedMask,
+    const u16 RemainingPieceBitFlags) const
+{
+    // a board can be full with pieces left over, which has no solutions
+    if (~OccupiedMask == 0u)
+    {
+        return -1;
+    }
+    if (CellOrder == cell_order::RowMajor)
+    {
+        return CountTrailingZeros(~OccupiedMask);
+    }
+    return SelectBestBitboardCell(Tables, CellOrder, OccupiedMask, RemainingPieceBitFlags);
+}
+
+bool solver::HasDeadRegion(
+    const bitboard_tables& Tables,
+    const u64 OccupiedMask,
+    const u16 RemainingPieceBitFlags) const
+{
+    // bit n is set if n cells can be filled exactly by some subset of the remaining pieces
+    u64 FillableSizes = 1u;
+    for (u32 PieceBitFlags = RemainingPieceBitFlags; PieceBitFlags; PieceBitFlags &= PieceBitFlags - 1u)
+    {
+        FillableSizes |= FillableSizes << SearchPieces[CountTrailingZeros(PieceBitFlags)].NumBalls;
+    }
+
+    // flood fill each region of connected empty cells in turn
+    u64 UnvisitedMask = ~OccupiedMask;
+    while (UnvisitedMask)
+    {
+        u64 RegionMask = UnvisitedMask & (~UnvisitedMask + 1u);
+        u64 FrontierMask = RegionMask;
+        while (FrontierMask)
+        {
+            u64 NewFrontierMask = 0u;
+            for (; FrontierMask; FrontierMask &= FrontierMask - 1u)
+            {
+                NewFrontierMask |= Tables.NeighborMasks[CountTrailingZeros(FrontierMask)];
+            }
+            FrontierMask = NewFrontierMask & UnvisitedMask & ~RegionMask;
+            RegionMask |= FrontierMask;
+        }
+        UnvisitedMask &= ~RegionMask;
+
+        const s32 RegionSize = CountSetBits(RegionMask);
+        if (RegionSize < 64 && !((FillableSizes >> RegionSize) & 1u))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+s32 solver::ReduceBySymmetry(
+    bitboard_tables& Tables,
+    const u16 RemainingPieceBitFlags) const
+{
+    Tables.NumSymmetries = 1;
+    for (s32 BitIdx = 0; BitIdx < NUM_VALID_CELLS; BitIdx++)
+    {
+        Tables.Symmetries[0][BitIdx] = (u8)BitIdx;
+    }
+
+    const u64 EmptyMask = ~Tables.InitialOccupiedMask;
+    if (!EmptyMask || !RemainingPieceBitFlags)
+    {
+        return -1;
+    }
+
+    // solutions only map onto each other if they cover every empty cell
+    s32 NumRemainingBalls = 0;
+    for (u32 PieceBitFlags = RemainingPieceBitFlags; PieceBitFlags; PieceBitFlags &= PieceBitFlags - 1u)
+    {
+        NumRemainingBalls += SearchPieces[CountTrailingZeros(PieceBitFlags)].NumBalls;
+    }
+    if (NumRemainingBalls != CountSetBits(EmptyMask))
+    {
+        return -1;
+    }
+
+    s32 CellBitIdxs[MAX_BOARD_SIZE][MAX_BOARD_SIZE];
+    for (s32 RowIdx = 0; RowIdx < MAX_BOARD_SIZE; RowIdx++)
+    {
+        for (s32 ColIdx = 0; ColIdx < MAX_BOARD_SIZE; ColIdx++)
+        {
+            CellBitIdxs[RowIdx][ColIdx] = -1;
+        }
+    }
+
+    s32 MinRowIdx = MAX_BOARD_SIZE, MinColIdx = MAX_BOARD_SIZE;
+    for (u64 Mask = EmptyMask; Mask; Mask &= Mask - 1u)
+    {
+        const s32 BitIdx = CountTrailingZeros(Mask);
+        const cell_ref Cell = Tables.BitCells[BitIdx];
+        CellBitIdxs[Cell.RowIdx][Cell.ColIdx] = BitIdx;
+        MinRowIdx = (Cell.RowIdx < MinRowIdx) ? Cell.RowIdx : MinRowIdx;
+        MinColIdx = (Cell.ColIdx < MinColIdx) ? Cell.ColIdx : MinColIdx;
+    }
+
+    // try each rotation/reflection of the empty cells, after translating them back so they line up with the originals
+    for (s32 TransformIdx = 1; TransformIdx < 2 * NUM_ROTATIONS; TransformIdx++)
+    {
+        s32 TransformedRowIdxs[NUM_VALID_CELLS];
+        s32 TransformedColIdxs[NUM_VALID_CELLS];
+        s32 MinTransformedRowIdx = INT32_MAX, MinTransformedColIdx = INT32_MAX;
+        for (u64 Mask = EmptyMask; Mask; Mask &= Mask - 1u)
+        {
+            const s32 BitIdx = CountTrailingZeros(Mask);
+            s32 RowIdx = Tables.BitCells[BitIdx].RowIdx;
+            s32 ColIdx = Tables.BitCells[BitIdx].ColIdx;
+
+            // transforms 1-3 rotate clockwise by 90 degrees, 4-7 are the same rotations of a vertical flip
+            if (TransformIdx >= NUM_ROTATIONS)
+            {
+                RowIdx = -RowIdx;
+            }
+            for (s32 RotationIdx = 0; RotationIdx < TransformIdx % NUM_ROTATIONS; RotationIdx++)
+            {
+                const s32 OldRowIdx = RowIdx;
+                RowIdx = ColIdx;
+                ColIdx = -OldRowIdx;
+            }
+
+            TransformedRowIdxs[BitIdx] = RowIdx;
+            TransformedColIdxs[BitIdx] = ColIdx;
+            MinTransformedRowIdx = (RowIdx < MinTransformedRowIdx) ? RowIdx : MinTransformedRowIdx;
+            MinTransformedColIdx = (ColIdx < MinTransformedColIdx) ? ColIdx : MinTransformedColIdx;
+        }
+
+        u8 (&Symmetry)[NUM_VALID_CELLS] = Tables.Symmetries[Tables.NumSymmetries];
+        bool IsSymmetry = true;
+        for (s32 BitIdx = 0; BitIdx < NUM_VALID_CELLS && IsSymmetry; BitIdx++)
+        {
+            Symmetry[BitIdx] = (u8)BitIdx;
+            if ((EmptyMask >> BitIdx) & 1u)
+            {
+                const s32 RowIdx = TransformedRowIdxs[BitIdx] - MinTransformedRowIdx + MinRowIdx;
+                const s32 ColIdx = TransformedColIdxs[BitIdx] - MinTransformedColIdx + MinColIdx;
+                const bool IsValidCellIdx = (RowIdx >= 0) && (RowIdx < MAX_BOARD_SIZE) && (ColIdx >= 0) && (ColIdx < MAX_BOARD_SIZE);
+                IsSymmetry = IsValidCellIdx && CellBitIdxs[RowIdx][ColIdx] >= 0;
+                Symmetry[BitIdx] = IsSymmetry ? (u8)CellBitIdxs[RowIdx][ColIdx] : 0u;
+            }
+        }
+
+        if (IsSymmetry)
+        {
+            Tables.NumSymmetries++;
+        }
+    }
+
+    if (Tables.NumSymmetries == 1)
+    {
+        return -1;
+    }
+
+    // restrict the remaining piece with the most orientations (so the fewest placements that are symmetric to
+    // themselves) to one placement from each set of placements that are symmetric to each other
+    s32 RestrictedPieceIdx = -1;
+    for (u32 PieceBitFlags = RemainingPieceBitFlags; PieceBitFlags; PieceBitFlags &= PieceBitFlags - 1u)
+    {
+        const s32 PieceIdx = CountTrailingZeros(PieceBitFlags);
+        if (RestrictedPieceIdx < 0 || SearchPieces[PieceIdx].NumOrientations > SearchPieces[RestrictedPieceIdx].NumOrientations)
+        {
+            RestrictedPieceIdx = PieceIdx;
+        }
+    }
+
+    std::vector<u64>& RestrictedPlacements = Tables.RestrictedPlacements;
+    RestrictedPlacements.clear();
+    RestrictedPlacements.reserve(Tables.Placements.size());
+    for (s32 BitIdx = 0; BitIdx < NUM_VALID_CELLS; BitIdx++)
+    {
+        u16 NewPlacementOffsets[NUM_PIECES + 1];
+        for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+        {
+            NewPlacementOffsets[PieceIdx] = (u16)RestrictedPlacements.size();
+
+            const u16 PlacementBegin = Tables.PlacementOffsets[BitIdx][PieceIdx];
+            const u16 PlacementEnd = Tables.PlacementOffsets[BitIdx][PieceIdx + 1];
+            for (u32 PlacementIdx = PlacementBegin; PlacementIdx < PlacementEnd; PlacementIdx++)
+            {
+                const u64 PlacementMask = Tables.Placements[PlacementIdx];
+
+                // keep the placement only if it is the smallest of its symmetric placements
+                bool IsCanonical = true;
+                for (s32 SymmetryIdx = 1; SymmetryIdx < Tables.NumSymmetries && PieceIdx == RestrictedPieceIdx; SymmetryIdx++)
+                {
+                    if (ApplyBitboardSymmetry(Tables, SymmetryIdx, PlacementMask) < PlacementMask)
+                    {
+                        IsCanonical = false;
+                        break;
+                    }
+                }
+
+                if (IsCanonical)
+                {
+                    RestrictedPlacements.push_back(PlacementMask);
+                }
+            }
+        }
+        NewPlacementOffsets[NUM_PIECES] = (u16)RestrictedPlacements.size();
+        memcpy(Tables.PlacementOffsets[BitIdx], NewPlacementOffsets, sizeof(NewPlacementOffsets));
+    }
+    RestrictedPlacements.resize(RestrictedPlacements.size() + PLACEMENT_PADDING, 0u);
+    Tables.Placements.swap(RestrictedPlacements);
+
+    return RestrictedPieceIdx;
+}
+
+u64 solver::ApplyBitboardSymmetry(
+    const bitboard_tables& Tables,
+    const s32 SymmetryIdx,
+    u64 Mask) const
+{
+    u64 TransformedMask = 0u;
+    for (; Mask; Mask &= Mask - 1u)
+    {
+        TransformedMask |= (1ull << Tables.Symmetries[SymmetryIdx][CountTrailingZeros(Mask)]);
+    }
+    return TransformedMask;
+}
+
+void solver::ExpandSymmetricSolutions(
+    const bitboard_tables& Tables,
+    const u64 MaxSolutions,
+    std::vector<board>& Solutions) const
+{
+    const size_t NumReducedSolutions = Solutions.size();
+    Solutions.reserve(NumReducedSolutions * Tables.NumSymmetries);
+
+    const u64 EmptyMask = ~Tables.InitialOccupiedMask;
+    for (size_t SolutionIdx = 0; SolutionIdx < NumReducedSolutions; SolutionIdx++)
+    {
+        for (s32 SymmetryIdx = 1; SymmetryIdx < Tables.NumSymmetries; SymmetryIdx++)
+        {
+            // move the value of each initially empty cell to where the symmetry takes it
+            board TransformedSolution = Solutions[SolutionIdx];
+            for (u64 Mask = EmptyMask; Mask; Mask &= Mask - 1u)
+            {
+                const s32 BitIdx = CountTrailingZeros(Mask);
+                const cell_ref From = Tables.BitCells[BitIdx];
+                const cell_ref To = Tables.BitCells[Tables.Symmetries[SymmetryIdx][BitIdx]];
+                TransformedSolution.Cells[To.RowIdx][To.ColIdx] = Solutions[SolutionIdx].Cells[From.RowIdx][From.ColIdx];
+            }
+            Solutions.push_back(TransformedSolution);
+        }
+    }
+
+    // a solution may be found more than once if it is symmetric itself, or its restricted piece is
+    std::sort(Solutions.begin(), Solutions.end(), [](const board& A, const board& B)
+    {
+        return memcmp(&A, &B, sizeof(board)) < 0;
+    });
+    Solutions.erase(std::unique(Solutions.begin(), Solutions.end(), [](const board& A, const board& B)
+    {
+        return memcmp(&A, &B, sizeof(board)) == 0;
+    }), Solutions.end());
+
+    if (MaxSolutions && Solutions.size() > MaxSolutions)
+    {
+        Solutions.resize(MaxSolutions);
+    }
+}
+
+struct solver::work_stealing_context
+{
+    struct work_queue
+    {
+        std::mutex Mutex;
+        std::deque<bitboard_task> Tasks;
+    };
+
+    std::vector<work_queue> Queues;
+    std::atomic<s32> NumIdleThreads;
+    std::atomic<s32> NumQueuedTasks;
+    std::atomic<s64> NumUnfinishedTasks; // tasks that have been queued but not yet fully searched
+
+    explicit work_stealing_context(const s32 NumThreads) : Queues(NumThreads), NumIdleThreads(0), NumQueuedTasks(0), NumUnfinishedTasks(0)
+    {
+    }
+
+    void Push(const s32 ThreadIdx, const bitboard_task& Task)
+    {
+        NumUnfinishedTasks.fetch_add(1, std::memory_order_relaxed);
+        work_queue& Queue = Queues[ThreadIdx];
+        std::lock_guard<std::mutex> Lock(Queue.Mutex);
+        Queue.Tasks.push_back(Task);
+        NumQueuedTasks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool ShouldShare() const
+    {
+        // only hand out more work if there are threads with nothing to do that haven't already got some
+        const s32 NumWaiting = NumIdleThreads.load(std::memory_order_relaxed);
+        return NumWaiting > 0 && NumQueuedTasks.load(std::memory_order_relaxed) < NumWaiting;
+    }
+
+    bool Pop(const s32 ThreadIdx, bitboard_task& OutTask)
+    {
+        // take the most recently queued task from our own queue...
+        {
+            work_queue& Queue = Queues[ThreadIdx];
+            std::lock_guard<std::mutex> Lock(Queue.Mutex);
+            if (!Queue.Tasks.empty())
+            {
+                OutTask = Queue.Tasks.back();
+                Queue.Tasks.pop_back();
+                NumQueuedTasks.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        // ... or steal the oldest (and so likely largest) task from another thread
+        const s32 NumThreads = (s32)Queues.size();
+        for (s32 Offset = 1; Offset < NumThreads; Offset++)
+        {
+            work_queue& Queue = Queues[(ThreadIdx + Offset) % NumThreads];
+            std::lock_guard<std::mutex> Lock(Queue.Mutex);
+            if (!Queue.Tasks.empty())
+            {
+                OutTask = Queue.Tasks.front();
+                Queue.Tasks.pop_front();
+                NumQueuedTasks.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        return false;
+    }
+};
+
+template <bool COLLECT_STATS>
+void solver::SearchBitboardTask(
+    const board& InputBoard,
+    const bitboard_tables& Tables,
+    const search_options& Options,
+    const bitboard_task& Task,
+    work_stealing_context* Context,
+    const s32 ThreadIdx,
+    search_control* Control,
+    solution_sink& OutSolutions,
+    search_stats& OutStats,
+    arena& Arena) const
+{
+    // a stopped parallel search still has to take every queued task, but needn't search them
+    if (Control && Control->IsStopped())
+    {
+        return;
+    }
+
+    // the most recently popped state at each depth is always an ancestor of the current state (the stack is LIFO),
+    // so the placements along the current path can be recovered without storing them in every search state
+    u64 PathOccupiedMasks[NUM_PIECES + 1];
+    u8 PathPieceIdxs[NUM_PIECES + 1];
+
+    // seed the path with the placements made before this task
+    PathOccupiedMasks[Task.Depth] = Task.OccupiedMask;
+    for (s32 Depth = Task.Depth; Depth > 0; Depth--)
+    {
+        PathPieceIdxs[Depth] = Task.PlacedPieceIdxs[Depth - 1];
+        PathOccupiedMasks[Depth - 1] = PathOccupiedMasks[Depth] ^ Task.PlacedMasks[Depth - 1];
+    }
+
+    bitboard_search_state InitialSearchState;
+    InitialSearchState.OccupiedMask = Task.OccupiedMask;
+    InitialSearchState.RemainingPieceBitFlags = Task.RemainingPieceBitFlags;
+    InitialSearchState.PieceIdx = (Task.Depth > 0) ? Task.PlacedPieceIdxs[Task.Depth - 1] : 0;
+    InitialSearchState.Depth = Task.Depth;
+
+    std::vector<bitboard_search_state>& SearchStates = Arena.BitboardSearchStates;
+    SearchStates.clear();
+    SearchStates.reserve(1024);
+    SearchStates.push_back(InitialSearchState);
+
+    // states below this index have been handed over to other threads
+    size_t SearchStatesBeginIdx = 0;
+
+    search_stats Stats;
+    u64 NumUncheckedStates = 0;
+
+    piece_ranking PieceRanking;
+    InitializePieceRanking(Options.PieceOrder, true, PieceRanking);
+
+    while (SearchStatesBeginIdx < SearchStates.size())
+    {
+        // if another thread has run out of work, give away the shallowest state we have yet to search
+        if (Context && SearchStates.size() - SearchStatesBeginIdx >= 2 && Context->ShouldShare())
+        {
+            const bitboard_search_state& SharedSearchState = SearchStates[SearchStatesBeginIdx++];
+
+            bitboard_task SharedTask;
+            SharedTask.OccupiedMask = SharedSearchState.OccupiedMask;
+            SharedTask.RemainingPieceBitFlags = SharedSearchState.RemainingPieceBitFlags;
+            SharedTask.Depth = SharedSearchState.Depth;
+            for (s32 Depth = 1; Depth < SharedSearchState.Depth; Depth++)
+            {
+                SharedTask.PlacedPieceIdxs[Depth - 1] = PathPieceIdxs[Depth];
+                SharedTask.PlacedMasks[Depth - 1] = PathOccupiedMasks[Depth] ^ PathOccupiedMasks[Depth - 1];
+            }
+            SharedTask.PlacedPieceIdxs[SharedSearchState.Depth - 1] = SharedSearchState.PieceIdx;
+            SharedTask.PlacedMasks[SharedSearchState.Depth - 1] = SharedSearchState.OccupiedMask ^ PathOccupiedMasks[SharedSearchState.Depth - 1];
+
+            Context->Push(ThreadIdx, SharedTask);
+            continue;
+        }
+
+        if (ShouldStopSearch(Control, NumUncheckedStates))
+        {
+            break;
+        }
+        if (COLLECT_STATS)
+        {
+            Stats.NumBoardStatesTested++;
+        }
+        const bitboard_search_state SearchState = SearchStates.back();
+        SearchStates.pop_back();
+
+        PathOccupiedMasks[SearchState.Depth] = SearchState.OccupiedMask;
+        PathPieceIdxs[SearchState.Depth] = SearchState.PieceIdx;
+
+        const u16 RemainingPieceBitFlags = SearchState.RemainingPieceBitFlags;
+
+        if (Options.PruneDeadRegions && HasDeadRegion(Tables, SearchState.OccupiedMask, RemainingPieceBitFlags))
+        {
+            if (COLLECT_STATS)
+            {
+                Stats.NumStatesPruned++;
+            }
+            continue;
+        }
+
+        // find the next empty cell on the board
+        const s32 BitIdx = SelectBitboardCell(Tables, Options.CellOrder, SearchState.OccupiedMask, RemainingPieceBitFlags);
+        if (BitIdx < 0)
+        {
+            continue;
+        }
+
+        const bool IsLastPiece = !(RemainingPieceBitFlags & (RemainingPieceBitFlags - 1u));
+        if (PieceRanking.IsAdaptive && --PieceRanking.NumStatesUntilUpdate == 0)
+        {
+            UpdatePieceRanking(PieceRanking);
+        }
+
+        // try to fill the empty cell with every placement of every available piece, in rank order
+        u32 PieceRankFlags = RankPieces(PieceRanking, RemainingPieceBitFlags);
+        while (PieceRankFlags)
+        {
+            const s32 PieceIdx = PieceRanking.PieceIdxs[CountTrailingZeros(PieceRankFlags)];
+            PieceRankFlags &= PieceRankFlags - 1u;
+
+            const u16 PlacementBegin = Tables.PlacementOffsets[BitIdx][PieceIdx];
+            const u16 PlacementEnd = Tables.PlacementOffsets[BitIdx][PieceIdx + 1];
+            if (COLLECT_STATS)
+            {
+                Stats.NumOrientationsTested += PlacementEnd - PlacementBegin;
+            }
+            const u64* Placements = Tables.Placements.data() + PlacementBegin;
+            u64 FreeMask = FindFreePlacements(Placements, PlacementEnd - PlacementBegin, SearchState.OccupiedMask);
+            if (PieceRanking.IsAdaptive)
+            {
+                PieceRanking.NumPlacementsTested[PieceIdx] += PlacementEnd - PlacementBegin;
+                PieceRanking.NumPlacementsFailed[PieceIdx] += PlacementEnd - PlacementBegin - CountSetBits(FreeMask);
+            }
+            for (; FreeMask; FreeMask &= FreeMask - 1u)
+            {
+                const u64 PlacementMask = Placements[CountTrailingZeros(FreeMask)];
+
+                if (!IsLastPiece)
+                {
+                    bitboard_search_state NewSearchState;
+                    NewSearchState.OccupiedMask = SearchState.OccupiedMask | PlacementMask;
+                    NewSearchState.RemainingPieceBitFlags = RemainingPieceBitFlags & ~(1u << PieceIdx);
+                    NewSearchState.PieceIdx = (u8)PieceIdx;
+                    NewSearchState.Depth = SearchState.Depth + 1;
+                    SearchStates.push_back(NewSearchState);
+                }
+                else
+                {
+                    // reconstruct the solution from the placements along the current path
+                    board Solution = InputBoard;
+                    for (s32 Depth = 1; Depth <= SearchState.Depth; Depth++)
+                    {
+                        PlaceBitboardPiece(Tables, PathPieceIdxs[Depth], PathOccupiedMasks[Depth] ^ PathOccupiedMasks[Depth - 1], Solution);
+                    }
+                    PlaceBitboardPiece(Tables, PieceIdx, PlacementMask, Solution);
+                    OutSolutions.Add(Solution);
+                }
+            }
+        }
+
+        if (COLLECT_STATS)
+        {
+            const u64 StackDepth = SearchStates.size() - SearchStatesBeginIdx;
+            Stats.MaxStackDepth = (StackDepth > Stats.MaxStackDepth) ? StackDepth : Stats.MaxStackDepth;
+        }
+    }
+
+    EndControlledSearch(Control, NumUncheckedStates);
+    OutStats.Add(Stats);
+}
+
+void solver::SolveBitboard(
+    const board& InputBoard,
+    const s32 NumRows,
+    const s32 NumCols,
+    const search_options& Options,
+    search_control* Control,
+    solution_sink& OutSolutions,
+    search_stats* OutStats,
+    arena* Arena) const
+{
+    arena& SearchArena = ResolveArena(Arena);
+    bitboard_tables& Tables = SearchArena.BitboardTables;
+    bitboard_task InitialTask;
+    {
+        trace_scope TablesScope(Options.Trace, "build tables");
+        BuildBitboardTables(InputBoard, NumRows, NumCols, Tables);
+        InitializeBitboardTask(InputBoard, NumRows, NumCols, Tables, InitialTask);
+    }
+
+    const bool IsReducedBySymmetry = Options.UseSymmetry && ReduceBySymmetry(Tables, InitialTask.RemainingPieceBitFlags) >= 0;
+
+    // the solutions of a reduced search have to be collected to expand them, otherwise they are passed straight on
+    collecting_solution_sink& ReducedSolutions = SearchArena.ReducedSolutions;
+    ReducedSolutions.Solutions.clear();
+    limited_solution_sink LimitedSolutions;
+    solution_sink& SearchSolutions = BeginControlledSearch(
+        Control,
+        IsReducedBySymmetry ? (solution_sink&)ReducedSolutions : OutSolutions,
+        LimitedSolutions);
+
+    // note: the bitboard engine tests all the balls of a placement at once, so doesn't count balls tested
+    search_stats Stats;
+    {
+        trace_scope SearchScope(Options.Trace, "search");
+        if (OutStats)
+        {
+            SearchBitboardTask<true>(InputBoard, Tables, Options, InitialTask, nullptr, 0, Control, SearchSolutions, Stats, SearchArena);
+            *OutStats = Stats;
+        }
+        else
+        {
+            SearchBitboardTask<false>(InputBoard, Tables, Options, InitialTask, nullptr, 0, Control, SearchSolutions, Stats, SearchArena);
+        }
+    }
+
+    if (IsReducedBySymmetry)
+    {
+        trace_scope ExpandScope(Options.Trace, "expand symmetric solutions");
+        ExpandSymmetricSolutions(Tables, Control ? Control->MaxSolutions : 0, ReducedSolutions.Solutions);
+        AddSolutions(ReducedSolutions.Solutions, OutSolutions);
+    }
+}
+
+struct solver::parallel_search
+{
+    struct thread_result
+    {
+        collecting_solution_sink CollectedSolutions;
+        locked_solution_sink SharedSolutions;
+        limited_solution_sink LimitedSolutions; // wrapped around one of the others, if the control limits solutions
+        search_stats Stats;
+    };
+
+    const board* InputBoard;
+    const search_options* Options;
+    search_control* Control; // optional, begun by the caller
+    const bitboard_tables* Tables; // in the arena of the thread that began the search
+    bool IsReducedBySymmetry;
+    bool IsCollected; // solutions are collected, to be sorted or expanded at the end, instead of passed straight on
+    bool IsSorted;
+    bool CollectStats;
+    work_stealing_context Context;
+    std::vector<thread_result> ThreadResults;
+    std::mutex SolutionsLock;
+    solution_sink CountedSolutions; // for batch boards whose solutions are only counted
+    std::atomic<s32> NumHelperThreads; // threads of a batch that have joined in on the search
+
+    explicit parallel_search(const s32 NumThreads) : Context(NumThreads), ThreadResults(NumThreads), NumHelperThreads(0)
+    {
+    }
+};
+
+void solver::BeginParallelSearch(
+    const board& InputBoard,
+    const s32 NumRows,
+    const s32 NumCols,
+    const search_options& Options,
+    const bool DeterministicOrder,
+    const bool CollectStats,
+    search_control* Control,
+    solution_sink* OutSolutions,
+    const s32 ThreadIdx,
+    arena& Arena,
+    parallel_search& Search) const
+{
+    // note: the search may be reused, once every thread has left it
+    assert(Search.Context.NumUnfinishedTasks.load() == 0 && Search.Context.NumIdleThreads.load() == 0);
+
+    Search.InputBoard = &InputBoard;
+    Search.Options = &Options;
+    Search.Control = Control;
+    Search.CollectStats = CollectStats;
+
+    bitboard_tables& Tables = Arena.BitboardTables;
+    Search.Tables = &Tables;
+    bitboard_task InitialTask;
+    {
+        trace_scope TablesScope(Options.Trace, "build tables");
+        BuildBitboardTables(InputBoard, NumRows, NumCols, Tables);
+        InitializeBitboardTask(InputBoard, NumRows, NumCols, Tables, InitialTask);
+    }
+
+    Search.IsReducedBySymmetry = Options.UseSymmetry && ReduceBySymmetry(Tables, InitialTask.RemainingPieceBitFlags) >= 0;
+
+    // when the order of the solutions doesn't matter, each thread passes its solutions straight on (one at a time,
+    // under a lock), otherwise they are collected to be sorted or expanded at the end
+    Search.IsCollected = Search.IsReducedBySymmetry || DeterministicOrder || !OutSolutions;
+    Search.IsSorted = DeterministicOrder;
+    for (parallel_search::thread_result& ThreadResult : Search.ThreadResults)
+    {
+        ThreadResult.CollectedSolutions.Solutions.clear();
+        ThreadResult.SharedSolutions.Sink = OutSolutions;
+        ThreadResult.SharedSolutions.Lock = &Search.SolutionsLock;
+        ThreadResult.LimitedSolutions.Sink = Search.IsCollected ? (solution_sink*)&ThreadResult.CollectedSolutions : &ThreadResult.SharedSolutions;
+        ThreadResult.LimitedSolutions.Control = Control;
+        ThreadResult.Stats = search_stats();
+    }
+
+    Search.Context.Push(ThreadIdx, InitialTask);
+}
+
+void solver::RunParallelSearch(
+    parallel_search& Search,
+    const s32 ThreadIdx,
+    arena& Arena) const
+{
+    work_stealing_context& Context = Search.Context;
+    parallel_search::thread_result& ThreadResult = Search.ThreadResults[ThreadIdx];
+    solution_sink& ThreadSolutions = (Search.Control && Search.Control->MaxSolutions) ?
+        (solution_sink&)ThreadResult.LimitedSolutions :
+        *ThreadResult.LimitedSolutions.Sink;
+    bool IsIdle = false;
+
+    // one span for the thread's whole part in the search, including any time spent waiting for work
+    trace_scope SearchScope(Search.Options->Trace, "search");
+    SearchScope.ArgName = "tasks";
+
+    while (1)
+    {
+        bitboard_task Task;
+        if (Context.Pop(ThreadIdx, Task))
+        {
+            if (IsIdle)
+            {
+                Context.NumIdleThreads.fetch_sub(1, std::memory_order_relaxed);
+                IsIdle = false;
+            }
+            SearchScope.ArgValue++;
+
+            if (Search.CollectStats)
+            {
+                SearchBitboardTask<true>(*Search.InputBoard, *Search.Tables, *Search.Options, Task, &Context, ThreadIdx, Search.Control, ThreadSolutions, ThreadResult.Stats, Arena);
+            }
+            else
+            {
+                SearchBitboardTask<false>(*Search.InputBoard, *Search.Tables, *Search.Options, Task, &Context, ThreadIdx, Search.Control, ThreadSolutions, ThreadResult.Stats, Arena);
+            }
+            Context.NumUnfinishedTasks.fetch_sub(1, std::memory_order_acq_rel);
+        }
+        else if (Context.NumUnfinishedTasks.load(std::memory_order_acquire) == 0)
+        {
+            // no thread has any work left, nor can any more be created
+            break;
+        }
+        else
+        {
+            if (!IsIdle)
+            {
+                Context.NumIdleThreads.fetch_add(1, std::memory_order_relaxed);
+                IsIdle = true;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    // a thread helping out on a batch board may go on to another board
+    if (IsIdle)
+    {
+        Context.NumIdleThreads.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void solver::EndParallelSearch(
+    parallel_search& Search,
+    std::vector<board>& OutSolutions,
+    search_stats* OutStats) const
+{
+    // merge the results of each thread
+    if (OutStats)
+    {
+        *OutStats = search_stats();
+        for (const parallel_search::thread_result& ThreadResult : Search.ThreadResults)
+        {
+            OutStats->Add(ThreadResult.Stats);
+        }
+    }
+
+    if (!Search.IsCollected)
+    {
+        return;
+    }
+
+    size_t NumSolutions = 0;
+    for (const parallel_search::thread_result& ThreadResult : Search.ThreadResults)
+    {
+        NumSolutions += ThreadResult.CollectedSolutions.Solutions.size();
+    }
+
+    OutSolutions.clear();
+    OutSolutions.reserve(NumSolutions);
+    for (const parallel_search::thread_result& ThreadResult : Search.ThreadResults)
+    {
+        OutSolutions.insert(OutSolutions.end(), ThreadResult.CollectedSolutions.Solutions.begin(), ThreadResult.CollectedSolutions.Solutions.end());
+    }
+
+    if (Search.IsReducedBySymmetry)
+    {
+        ExpandSymmetricSolutions(*Search.Tables, Search.Control ? Search.Control->MaxSolutions : 0, OutSolutions);
+    }
+    else if (Search.IsSorted)
+    {
+        // the order solutions are found in depends on thread timing, so sort them
+        std::sort(OutSolutions.begin(), OutSolutions.end(), [](const board& A, const board& B)
+        {
+            return memcmp(&A, &B, sizeof(board)) < 0;
+        });
+    }
+}
+
+void solver::SolveParallel(
+    const board& InputBoard,
+    const s32 NumRows,
+    const s32 NumCols,
+    const search_options& Options,
+    const s32 NumThreads,
+    const bool DeterministicOrder,
+    search_control* Control,
+    solution_sink& OutSolutions,
+    search_stats* OutStats,
+    arena* Arena) const
+{
+    assert(NumThreads >= 1);
+
+    // the calling thread uses the arena passed in, and the other threads use the arenas kept in it
+    arena& SearchArena = ResolveArena(Arena);
+    std::vector<arena>& ThreadArenas = SearchArena.HelperArenas;
+    if ((s32)ThreadArenas.size() < NumThreads - 1)
+    {
+        ThreadArenas.resize(NumThreads - 1);
+    }
+
+    if (Control)
+    {
+        Control->Begin();
+    }
+
+    parallel_search Search(NumThreads);
+    BeginParallelSearch(InputBoard, NumRows, NumCols, Options, DeterministicOrder, OutStats != nullptr, Control, &OutSolutions, 0, SearchArena, Search);
+
+    std::vector<std::thread> Threads;
+    Threads.reserve(NumThreads - 1);
+    for (s32 ThreadIdx = 1; ThreadIdx < NumThreads; ThreadIdx++)
+    {
+        Threads.emplace_back([&, ThreadIdx]() { RunParallelSearch(Search, ThreadIdx, ThreadArenas[ThreadIdx - 1]); });
+    }
+    RunParallelSearch(Search, 0, SearchArena);
+    for (std::thread& Thread : Threads)
+    {
+        Thread.join();
+    }
+
+    std::vector<board> Solutions;
+    EndParallelSearch(Search, Solutions, OutStats);
+    AddSolutions(Solutions, OutSolutions);
+}
+
+void solver::SolveBatch(
+    const std::vector<board>& InputBoards,
+    const search_options& Options,
+    const s32 NumThreads,
+    const bool DeterministicOrder,
+    const bool CollectStats,
+    solution_sink& OutSolutions,
+    std::vector<batch_result>& OutResults) const
+{
+    assert(NumThreads >= 1);
+
+    const s32 NumBoards = (s32)InputBoards.size();
+    OutResults.assign(NumBoards, batch_result());
+
+    struct batch_board
+    {
+        std::vector<packed_board> Solutions; // once the board has been searched, until they are passed on
+        board_layout Layout;
+        bool IsSolved = false;
+    };
+
+    std::vector<batch_board> Boards(NumBoards);
+    std::atomic<s32> NextBoardIdx(0);
+
+    // each thread reuses its own arena and search for every board it takes, and only the sink's solutions are kept
+    // for each board. a sink that only counts the solutions is just given the count
+    std::vector<arena> ThreadArenas(NumThreads);
+    std::vector<std::unique_ptr<parallel_search>> ThreadSearches(NumThreads);
+    for (std::unique_ptr<parallel_search>& Search : ThreadSearches)
+    {
+        Search.reset(new parallel_search(NumThreads));
+    }
+    const bool KeepSolutions = OutSolutions.NeedsSolutions();
+
+    // boards that are being searched, which threads with no boards left to take can join in on
+    std::mutex ActiveSearchesLock;
+    std::vector<parallel_search*> ActiveSearches;
+
+    // boards are passed on in input order, by whichever thread finishes the next one
+    std::mutex OutputLock;
+    s32 NextOutputBoardIdx = 0;
+
+    auto RunThread = [&](const s32 ThreadIdx)
+    {
+        // solutions of the board just searched, which are packed to wait for the boards before them to be passed on
+        std::vector<board> SearchSolutions;
+        board OutputSolution;
+
+        while (1)
+        {
+            const s32 BoardIdx = NextBoardIdx.fetch_add(1, std::memory_order_relaxed);
+            if (BoardIdx < NumBoards)
+            {
+                const std::chrono::steady_clock::time_point ClockStart = std::chrono::steady_clock::now();
+
+                const board& InputBoard = InputBoards[BoardIdx];
+                s32 NumRows, NumCols;
+                ComputeBoardSize(InputBoard, NumRows, NumCols);
+
+                batch_board& Board = Boards[BoardIdx];
+                parallel_search& Search = *ThreadSearches[ThreadIdx];
+                Search.CountedSolutions.NumSolutions = 0;
+                BeginParallelSearch(
+                    InputBoard,
+                    NumRows,
+                    NumCols,
+                    Options,
+                    DeterministicOrder && KeepSolutions,
+                    CollectStats,
+                    nullptr,
+                    KeepSolutions ? nullptr : &Search.CountedSolutions,
+                    ThreadIdx,
+                    ThreadArenas[ThreadIdx],
+                    Search);
+
+                {
+                    std::lock_guard<std::mutex> Lock(ActiveSearchesLock);
+                    ActiveSearches.push_back(&Search);
+                }
+
+                RunParallelSearch(Search, ThreadIdx, ThreadArenas[ThreadIdx]);
+
+                // wait for any threads that joined in to leave, before the search is freed
+                {
+                    std::lock_guard<std::mutex> Lock(ActiveSearchesLock);
+                    ActiveSearches.erase(std::find(ActiveSearches.begin(), ActiveSearches.end(), &Search));
+                }
+                while (Search.NumHelperThreads.load(std::memory_order_acquire) > 0)
+                {
+                    std::this_thread::yield();
+                }
+
+                batch_result& Result = OutResults[BoardIdx];
+                EndParallelSearch(Search, SearchSolutions, CollectStats ? &Result.Stats : nullptr);
+                if (Search.IsCollected)
+                {
+                    ComputeBoardLayout(InputBoard, Board.Layout);
+                    Board.Solutions.resize(SearchSolutions.size());
+                    for (size_t SolutionIdx = 0; SolutionIdx < SearchSolutions.size(); SolutionIdx++)
+                    {
+                        PackBoard(SearchSolutions[SolutionIdx], Board.Layout, Board.Solutions[SolutionIdx]);
+                    }
+                }
+
+                const std::chrono::steady_clock::time_point ClockEnd = std::chrono::steady_clock::now();
+                Result.NumSolutions = Search.IsCollected ? Board.Solutions.size() : Search.CountedSolutions.NumSolutions;
+                Result.ElapsedTimeSec = std::chrono::duration<f64>(ClockEnd - ClockStart).count();
+
+                std::lock_guard<std::mutex> Lock(OutputLock);
+                Board.IsSolved = true;
+                while (NextOutputBoardIdx < NumBoards && Boards[NextOutputBoardIdx].IsSolved)
+                {
+                    batch_board& OutputBoard = Boards[NextOutputBoardIdx];
+                    const board& OutputInputBoard = InputBoards[NextOutputBoardIdx];
+                    s32 OutputNumRows, OutputNumCols;
+                    ComputeBoardSize(OutputInputBoard, OutputNumRows, OutputNumCols);
+
+                    OutSolutions.BeginBoard(OutputInputBoard, OutputNumRows, OutputNumCols);
+                    for (const packed_board& Solution : OutputBoard.Solutions)
+                    {
+                        UnpackBoard(Solution, OutputBoard.Layout, OutputSolution);
+                        OutSolutions.Add(OutputSolution);
+                    }
+                    OutSolutions.EndBoard();
+                    std::vector<packed_board>().swap(OutputBoard.Solutions);
+                    NextOutputBoardIdx++;
+                }
+            }
+            else
+            {
+                // every board has been taken, so join in on the one that has been searched for longest
+                parallel_search* HelpedSearch;
+                {
+                    std::lock_guard<std::mutex> Lock(ActiveSearchesLock);
+                    if (ActiveSearches.empty())
+                    {
+                        break;
+                    }
+                    HelpedSearch = ActiveSearches.front();
+                    HelpedSearch->NumHelperThreads.fetch_add(1, std::memory_order_relaxed);
+                }
+
+                RunParallelSearch(*HelpedSearch, ThreadIdx, ThreadArenas[ThreadIdx]);
+                HelpedSearch->NumHelperThreads.fetch_sub(1, std::memory_order_release);
+            }
+        }
+    };
+
+    std::vector<std::thread> Threads;
+    Threads.reserve(NumThreads - 1);
+    for (s32 ThreadIdx = 1; ThreadIdx < NumThreads; ThreadIdx++)
+    {
+        Threads.emplace_back(RunThread, ThreadIdx);
+    }
+    RunThread(0);
+    for (std::thread& Thread : Threads)
+    {
+        Thread.join();
+    }
+}
+
+void solver::PlaceBitboardPiece(
+    const bitboard_tables& Tables,
+    const s32 PieceIdx,
+    u64 PlacementMask,
+    board& Board) const
+{
+    const cell_value NewCellValue = PieceIndexToCellValue(PieceIdx);
+    while (PlacementMask)
+    {
+        const cell_ref Cell = Tables.BitCells[CountTrailingZeros(PlacementMask)];
+        PlacementMask &= PlacementMask - 1u;
+        Board.Cells[Cell.RowIdx][Cell.ColIdx] = NewCellValue;
+    }
+}
+
+void solver::ComputeSubproblemKey(
+    const bitboard_tables& Tables,
+    const u64 OccupiedMask,
+    const u16 RemainingPieceBitFlags,
+    subproblem_key& OutKey) const
+{
+    // gather the empty cells into board rows
+    u16 EmptyCellRows[MAX_BOARD_SIZE] = {};
+    const u64 EmptyMask = ~OccupiedMask;
+    for (s32 SegmentIdx = 0; SegmentIdx < Tables.NumRowSegments; SegmentIdx++)
+    {
+        const bitboard_tables::row_segment& Segment = Tables.RowSegments[SegmentIdx];
+        const u64 SegmentMask = (EmptyMask >> Segment.BitIdx) & ((1ull << Segment.NumBits) - 1u);
+        EmptyCellRows[Segment.RowIdx] |= (u16)(SegmentMask << Segment.ColIdx);
+    }
+
+    // translate the empty cells up and to the left
+    s32 MinRowIdx = 0;
+    while (MinRowIdx < MAX_BOARD_SIZE && !EmptyCellRows[MinRowIdx])
+    {
+        MinRowIdx++;
+    }
+
+    u32 AllColumns = 0;
+    for (s32 RowIdx = MinRowIdx; RowIdx < MAX_BOARD_SIZE; RowIdx++)
+    {
+        AllColumns |= EmptyCellRows[RowIdx];
+    }
+    const s32 MinColIdx = AllColumns ? CountTrailingZeros(AllColumns) : 0;
+
+    for (s32 RowIdx = 0; RowIdx < MAX_BOARD_SIZE; RowIdx++)
+    {
+        OutKey.EmptyCellRows[RowIdx] = (RowIdx + MinRowIdx < MAX_BOARD_SIZE) ? (u16)(EmptyCellRows[RowIdx + MinRowIdx] >> MinColIdx) : 0u;
+    }
+    OutKey.RemainingPieceBitFlags = RemainingPieceBitFlags;
+}
+
+template <bool COLLECT_STATS>
+u64 solver::SearchBitboardCached(
+    cached_search_context& Context,
+    const u64 OccupiedMask,
+    const u16 RemainingPieceBitFlags,
+    const s32 Depth) const
+{
+    const bitboard_tables& Tables = *Context.Tables;
+    const u64 NumStatesBefore = Context.NumBoardStatesTested++;
+    if (ShouldStopSearch(Context.Control, Context.NumUncheckedStates))
+    {
+        Context.IsStopped = true;
+        return 0;
+    }
+    if (COLLECT_STATS)
+    {
+        Context.Stats.MaxStackDepth = ((u64)Depth + 1 > Context.Stats.MaxStackDepth) ? (u64)Depth + 1 : Context.Stats.MaxStackDepth;
+    }
+
+    const bool IsLastPiece = !(RemainingPieceBitFlags & (RemainingPieceBitFlags - 1u));
+    bool UseCache = Context.Cache && (CountSetBits(RemainingPieceBitFlags) >= MIN_CACHED_PIECES);
+
+    subproblem_key Key;
+    if (UseCache)
+    {
+        ComputeSubproblemKey(Tables, OccupiedMask, RemainingPieceBitFlags, Key);
+
+        u64 NumCachedSolutions;
+        if (Context.Cache->Lookup(Key, NumCachedSolutions))
+        {
+            if (COLLECT_STATS)
+            {
+                Context.Stats.NumCacheHits++;
+            }
+
+            if (NumCachedSolutions == 0)
+            {
+                return 0;
+            }
+
+            if (!Context.OutSolutions)
+            {
+                // when only counting, a live sub-problem doesn't need to be searched either
+                Context.NumSolutionsFound += NumCachedSolutions;
+                if (Context.MaxSolutions && Context.NumSolutionsFound >= Context.MaxSolutions)
+                {
+                    Context.IsStopped = true;
+                }
+                return NumCachedSolutions;
+            }
+
+            // note: live sub-problems still have to be searched to enumerate their solutions, but there is no need
+            // to store them again
+            UseCache = false;
+        }
+    }
+
+    if (Context.Options->PruneDeadRegions && HasDeadRegion(Tables, OccupiedMask, RemainingPieceBitFlags))
+    {
+        if (COLLECT_STATS)
+        {
+            Context.Stats.NumStatesPruned++;
+        }
+        return 0;
+    }
+
+    // find the next empty cell on the board
+    const s32 BitIdx = SelectBitboardCell(Tables, Context.Options->CellOrder, OccupiedMask, RemainingPieceBitFlags);
+    if (BitIdx < 0)
+    {
+        return 0;
+    }
+
+    u64 NumSolutions = 0;
+
+    piece_ranking& PieceRanking = Context.PieceRanking;
+    if (PieceRanking.IsAdaptive && --PieceRanking.NumStatesUntilUpdate == 0)
+    {
+        UpdatePieceRanking(PieceRanking);
+    }
+
+    // try to fill the empty cell with every placement of every available piece, in rank order. adaptive ranks are
+    // copied first, as the search below may re-rank the pieces
+    u32 PieceRankFlags = RankPieces(PieceRanking, RemainingPieceBitFlags);
+    const u8* RankedPieceIdxs = PieceRanking.PieceIdxs;
+    u8 SavedPieceIdxs[NUM_PIECES];
+    if (PieceRanking.IsAdaptive)
+    {
+        memcpy(SavedPieceIdxs, PieceRanking.PieceIdxs, sizeof(SavedPieceIdxs));
+        RankedPieceIdxs = SavedPieceIdxs;
+    }
+    while (PieceRankFlags && !Context.IsStopped)
+    {
+        const s32 PieceIdx = RankedPieceIdxs[CountTrailingZeros(PieceRankFlags)];
+        PieceRankFlags &= PieceRankFlags - 1u;
+
+        const u16 PlacementBegin = Tables.PlacementOffsets[BitIdx][PieceIdx];
+        const u16 PlacementEnd = Tables.PlacementOffsets[BitIdx][PieceIdx + 1];
+        if (COLLECT_STATS)
+        {
+            Context.Stats.NumOrientationsTested += PlacementEnd - PlacementBegin;
+        }
+
+        const u64* Placements = Tables.Placements.data() + PlacementBegin;
+        u64 FreeMask = FindFreePlacements(Placements, PlacementEnd - PlacementBegin, OccupiedMask);
+        if (PieceRanking.IsAdaptive)
+        {
+            PieceRanking.NumPlacementsTested[PieceIdx] += PlacementEnd - PlacementBegin;
+            PieceRanking.NumPlacementsFailed[PieceIdx] += PlacementEnd - PlacementBegin - CountSetBits(FreeMask);
+        }
+        for (; FreeMask && !Context.IsStopped; FreeMask &= FreeMask - 1u)
+        {
+            const u64 PlacementMask = Placements[CountTrailingZeros(FreeMask)];
+
+            Context.PlacedPieceIdxs[Depth] = (u8)PieceIdx;
+            Context.PlacedMasks[Depth] = PlacementMask;
+
+            if (!IsLastPiece)
+            {
+                NumSolutions += SearchBitboardCached<COLLECT_STATS>(Context, OccupiedMask | PlacementMask, RemainingPieceBitFlags & ~(1u << PieceIdx), Depth + 1);
+            }
+            else
+            {
+                if (Context.OutSolutions)
+                {
+                    board Solution = *Context.InputBoard;
+                    for (s32 PlacedIdx = 0; PlacedIdx <= Depth; PlacedIdx++)
+                    {
+                        PlaceBitboardPiece(Tables, Context.PlacedPieceIdxs[PlacedIdx], Context.PlacedMasks[PlacedIdx], Solution);
+                    }
+                    Context.OutSolutions->Add(Solution);
+                }
+
+                NumSolutions++;
+                Context.NumSolutionsFound++;
+                if (Context.MaxSolutions && Context.NumSolutionsFound >= Context.MaxSolutions)
+                {
+                    Context.IsStopped = true;
+                }
+            }
+        }
+    }
+
+    // a search that was stopped early has an incomplete count, so can't be cached
+    if (UseCache && !Context.IsStopped)
+    {
+        Context.Cache->Store(Key, NumSolutions, Context.NumBoardStatesTested - NumStatesBefore);
+    }
+
+    return NumSolutions;
+}
+
+void solver::RunCachedSearch(
+    cached_search_context& Context,
+    const bitboard_task& InitialTask,
+    search_stats* OutStats) const
+{
+    // a control that was cancelled before the search began stops it straight away
+    if (Context.Control && Context.Control->IsStopped())
+    {
+        Context.IsStopped = true;
+    }
+    else if (InitialTask.RemainingPieceBitFlags && OutStats)
+    {
+        SearchBitboardCached<true>(Context, InitialTask.OccupiedMask, InitialTask.RemainingPieceBitFlags, 0);
+    }
+    else if (InitialTask.RemainingPieceBitFlags)
+    {
+        SearchBitboardCached<false>(Context, InitialTask.OccupiedMask, InitialTask.RemainingPieceBitFlags, 0);
+    }
+
+    EndControlledSearch(Context.Control, Context.NumUncheckedStates);
+    if (Context.Control && Context.MaxSolutions && Context.NumSolutionsFound >= Context.MaxSolutions)
+    {
+        Context.Control->Stop(search_status::SolutionLimitReached);
+    }
+
+    if (OutStats)
+    {
+        *OutStats = Context.Stats;
+        OutStats->NumBoardStatesTested = Context.NumBoardStatesTested;
+    }
+}
+
+void solver::RunFrontierCount(
+    cached_search_context& Context,
+    const bitboard_task& InitialTask,
+    const size_t MaxBytes,
+    frontier_buffers& Frontier,
+    search_stats* OutStats) const
+{
+    typedef std::vector<frontier_state> frontier_layer[frontier_buffers::NUM_BUCKETS];
+
+    const bitboard_tables& Tables = *Context.Tables;
+    const size_t MaxStates = MaxBytes / sizeof(frontier_state);
+    const s32 NumInitialPieces = CountSetBits(InitialTask.RemainingPieceBitFlags);
+
+    // fibonacci hashing: the top bits choose a state's bucket, and the bits below them its slot when merging
+    auto HashState = [](const u64 OccupiedMask, const u16 RemainingPieceBitFlags)
+    {
+        return (OccupiedMask ^ (RemainingPieceBitFlags * 0xD6E8FEB86659FD93ull)) * 0x9E3779B97F4A7C15ull;
+    };
+
+    // merges the equal states of each bucket, and returns how many states are left. a bucket's table is a 256th of
+    // the size a whole layer's would be, so it mostly stays in the cache, which is the point of the buckets
+    auto MergeStates = [&](frontier_layer& OutLayer)
+    {
+        std::vector<u32>& Slots = Frontier.Slots;
+        size_t NumStates = 0;
+        for (std::vector<frontier_state>& Bucket : OutLayer)
+        {
+            // the indices of the merged states plus 1 (so 0 is an empty slot), at most half full
+            s32 NumSlotBits = 4;
+            while (((size_t)1 << NumSlotBits) < 2 * Bucket.size())
+            {
+                NumSlotBits++;
+            }
+            Slots.assign((size_t)1 << NumSlotBits, 0u);
+            const u64 SlotMask = Slots.size() - 1u;
+
+            size_t NumMergedStates = 0;
+            for (size_t StateIdx = 0; StateIdx < Bucket.size(); StateIdx++)
+            {
+                const frontier_state State = Bucket[StateIdx];
+                const u64 Hash = HashState(State.OccupiedMask, State.RemainingPieceBitFlags);
+                u64 SlotIdx = (Hash >> (64 - frontier_buffers::NUM_BUCKET_BITS - NumSlotBits)) & SlotMask;
+                while (Slots[SlotIdx] && (Bucket[Slots[SlotIdx] - 1u].OccupiedMask != State.OccupiedMask ||
+                    Bucket[Slots[SlotIdx] - 1u].RemainingPieceBitFlags != State.RemainingPieceBitFlags))
+                {
+                    SlotIdx = (SlotIdx + 1u) & SlotMask;
+                }
+
+                // the merged states are moved down over the ones already read
+                if (Slots[SlotIdx])
+                {
+                    Bucket[Slots[SlotIdx] - 1u].NumWays += State.NumWays;
+                }
+                else
+                {
+                    Bucket[NumMergedStates++] = State;
+                    Slots[SlotIdx] = (u32)NumMergedStates;
+                }
+            }
+            Bucket.resize(NumMergedStates);
+            NumStates += NumMergedStates;
+        }
+        return NumStates;
+    };
+
+    // counts the solutions from every state depth first, once the states outgrow MaxBytes or stop merging
+    auto CountStatesDepthFirst = [&](const frontier_state* StatesBegin, const frontier_state* StatesEnd)
+    {
+        for (const frontier_state* State = StatesBegin; State != StatesEnd && !Context.IsStopped; State++)
+        {
+            const s32 Depth = NumInitialPieces - CountSetBits(State->RemainingPieceBitFlags);
+            const u64 NumStateSolutions = OutStats ?
+                SearchBitboardCached<true>(Context, State->OccupiedMask, State->RemainingPieceBitFlags, Depth) :
+                SearchBitboardCached<false>(Context, State->OccupiedMask, State->RemainingPieceBitFlags, Depth);
+
+            // note: the search has already counted each of its solutions once
+            Context.NumSolutionsFound += NumStateSolutions * (State->NumWays - 1);
+        }
+    };
+
+    frontier_layer& Layer = Frontier.Layers[0];
+    frontier_layer& NextLayer = Frontier.Layers[1];
+    for (s32 BucketIdx = 0; BucketIdx < frontier_buffers::NUM_BUCKETS; BucketIdx++)
+    {
+        Layer[BucketIdx].clear();
+        NextLayer[BucketIdx].clear();
+    }
+
+    size_t NumLayerStates = 0;
+    if (InitialTask.RemainingPieceBitFlags && !(Context.Control && Context.Control->IsStopped()))
+    {
+        const u64 Hash = HashState(InitialTask.OccupiedMask, InitialTask.RemainingPieceBitFlags);
+        Layer[Hash >> (64 - frontier_buffers::NUM_BUCKET_BITS)].push_back({ InitialTask.OccupiedMask, 1u, InitialTask.RemainingPieceBitFlags });
+        NumLayerStates = 1;
+    }
+
+    bool IsDepthFirst = false;
+    while (NumLayerStates > 0 && !Context.IsStopped)
+    {
+        // the states of one layer all have the same number of pieces left, so a layer can't lead to any of its own
+        // states, and every state equal to one of its states is already in it
+        Context.Stats.MaxStackDepth = (NumLayerStates > Context.Stats.MaxStackDepth) ? NumLayerStates : Context.Stats.MaxStackDepth;
+
+        for (std::vector<frontier_state>& Bucket : NextLayer)
+        {
+            Bucket.clear();
+        }
+        size_t NumNextStates = 0;
+
+        for (s32 BucketIdx = 0; BucketIdx < frontier_buffers::NUM_BUCKETS && !Context.IsStopped; BucketIdx++)
+        {
+            const std::vector<frontier_state>& Bucket = Layer[BucketIdx];
+            size_t StateIdx;
+            for (StateIdx = 0; StateIdx < Bucket.size() && !Context.IsStopped; StateIdx++)
+            {
+                // merging the new states usually makes room for more, but once it doesn't the rest are counted depth first
+                if (NumLayerStates + NumNextStates >= MaxStates)
+                {
+                    NumNextStates = MergeStates(NextLayer);
+                    if (NumLayerStates + NumNextStates >= MaxStates / 2)
+                    {
+                        IsDepthFirst = true;
+                        break;
+                    }
+                }
+
+                const frontier_state State = Bucket[StateIdx];
+                Context.NumBoardStatesTested++;
+                if (ShouldStopSearch(Context.Control, Context.NumUncheckedStates))
+                {
+                    Context.IsStopped = true;
+                    break;
+                }
+
+                if (Context.Options->PruneDeadRegions && HasDeadRegion(Tables, State.OccupiedMask, State.RemainingPieceBitFlags))
+                {
+                    Context.Stats.NumStatesPruned++;
+                    continue;
+                }
+
+                const s32 BitIdx = SelectBitboardCell(Tables, Context.Options->CellOrder, State.OccupiedMask, State.RemainingPieceBitFlags);
+                if (BitIdx < 0)
+                {
+                    continue;
+                }
+
+                const bool IsLastPiece = !(State.RemainingPieceBitFlags & (State.RemainingPieceBitFlags - 1u));
+                u32 PieceBitFlags = State.RemainingPieceBitFlags;
+                while (PieceBitFlags)
+                {
+                    const s32 PieceIdx = CountTrailingZeros(PieceBitFlags);
+                    PieceBitFlags &= PieceBitFlags - 1u;
+
+                    const u16 PlacementBegin = Tables.PlacementOffsets[BitIdx][PieceIdx];
+                    const u16 PlacementEnd = Tables.PlacementOffsets[BitIdx][PieceIdx + 1];
+                    Context.Stats.NumOrientationsTested += PlacementEnd - PlacementBegin;
+
+                    const u64* Placements = Tables.Placements.data() + PlacementBegin;
+                    for (u64 FreeMask = FindFreePlacements(Placements, PlacementEnd - PlacementBegin, State.OccupiedMask); FreeMask; FreeMask &= FreeMask - 1u)
+                    {
+                        if (IsLastPiece)
+                        {
+                            Context.NumSolutionsFound += State.NumWays;
+                        }
+                        else
+                        {
+                            // the new states are only appended to their bucket here, and merged once the layer is done
+                            const u64 NextOccupiedMask = State.OccupiedMask | Placements[CountTrailingZeros(FreeMask)];
+                            const u16 NextPieceBitFlags = (u16)(State.RemainingPieceBitFlags & ~(1u << PieceIdx));
+                            const u64 Hash = HashState(NextOccupiedMask, NextPieceBitFlags);
+                            NextLayer[Hash >> (64 - frontier_buffers::NUM_BUCKET_BITS)].push_back({ NextOccupiedMask, State.NumWays, NextPieceBitFlags });
+                            NumNextStates++;
+                        }
+                    }
+                }
+            }
+
+            if (IsDepthFirst)
+            {
+                // the rest of this layer, then every state of the next
+                CountStatesDepthFirst(Bucket.data() + StateIdx, Bucket.data() + Bucket.size());
+                for (s32 RestBucketIdx = BucketIdx + 1; RestBucketIdx < frontier_buffers::NUM_BUCKETS; RestBucketIdx++)
+                {
+                    CountStatesDepthFirst(Layer[RestBucketIdx].data(), Layer[RestBucketIdx].data() + Layer[RestBucketIdx].size());
+                }
+                for (const std::vector<frontier_state>& NextBucket : NextLayer)
+                {
+                    CountStatesDepthFirst(NextBucket.data(), NextBucket.data() + NextBucket.size());
+                }
+                break;
+            }
+        }
+
+        if (IsDepthFirst)
+        {
+            break;
+        }
+
+        NumLayerStates = MergeStates(NextLayer);
+        std::swap(Layer, NextLayer);
+
+        // each state counted breadth first takes a trip through memory, which a large layer only pays for if merging
+        // removed at least a quarter of its states. otherwise it's counted depth first however much memory is left
+        if (NumLayerStates >= MIN_FRONTIER_CHECKED_STATES && NumNextStates - NumLayerStates < NumNextStates / 4)
+        {
+            IsDepthFirst = true;
+            for (const std::vector<frontier_state>& Bucket : Layer)
+            {
+                CountStatesDepthFirst(Bucket.data(), Bucket.data() + Bucket.size());
+            }
+            break;
+        }
+    }
+
+    // the states are kept in the arena for the next count, but not their memory if they fell back on depth first
+    if (IsDepthFirst)
+    {
+        for (s32 BucketIdx = 0; BucketIdx < frontier_buffers::NUM_BUCKETS; BucketIdx++)
+        {
+            std::vector<frontier_state>().swap(Layer[BucketIdx]);
+            std::vector<frontier_state>().swap(NextLayer[BucketIdx]);
+        }
+        std::vector<u32>().swap(Frontier.Slots);
+    }
+
+    EndControlledSearch(Context.Control, Context.NumUncheckedStates);
+    if (OutStats)
+    {
+        *OutStats = Context.Stats;
+        OutStats->NumBoardStatesTested = Context.NumBoardStatesTested;
+    }
+}
+
+void solver::SolveCached(
+    const board& InputBoard,
+    const s32 NumRows,
+    const s32 NumCols,
+    const search_options& Options,
+    solution_cache& Cache,
+    search_control* Control,
+    solution_sink& OutSolutions,
+    search_stats* OutStats,
+    arena* Arena) const
+{
+    arena& SearchArena = ResolveArena(Arena);
+    bitboard_tables& Tables = SearchArena.BitboardTables;
+    bitboard_task InitialTask;
+    {
+        trace_scope TablesScope(Options.Trace, "build tables");
+        BuildBitboardTables(InputBoard, NumRows, NumCols, Tables);
+        InitializeBitboardTask(InputBoard, NumRows, NumCols, Tables, InitialTask);
+    }
+
+    // the counts of sub-problems with a restricted piece are incomplete, so can't be shared through the cache
+    const bool IsReducedBySymmetry = Options.UseSymmetry && ReduceBySymmetry(Tables, InitialTask.RemainingPieceBitFlags) >= 0;
+
+    cached_search_context Context;
+    Context.InputBoard = &InputBoard;
+    Context.Tables = &Tables;
+    Context.Options = &Options;
+    Context.Cache = IsReducedBySymmetry ? nullptr : &Cache;
+    Context.Control = Control;
+    Context.NumUncheckedStates = 0;
+    Context.MaxSolutions = Control ? Control->MaxSolutions : 0;
+    Context.NumSolutionsFound = 0;
+    Context.IsStopped = false;
+    Context.NumBoardStatesTested = 0;
+    InitializePieceRanking(Options.PieceOrder, false, Context.PieceRanking);
+
+    collecting_solution_sink& ReducedSolutions = SearchArena.ReducedSolutions;
+    ReducedSolutions.Solutions.clear();
+    Context.OutSolutions = IsReducedBySymmetry ? (solution_sink*)&ReducedSolutions : &OutSolutions;
+
+    if (Control)
+    {
+        Control->Begin();
+    }
+    {
+        trace_scope SearchScope(Options.Trace, "search");
+        RunCachedSearch(Context, InitialTask, OutStats);
+    }
+
+    if (IsReducedBySymmetry)
+    {
+        trace_scope ExpandScope(Options.Trace, "expand symmetric solutions");
+        ExpandSymmetricSolutions(Tables, Context.MaxSolutions, ReducedSolutions.Solutions);
+        AddSolutions(ReducedSolutions.Solutions, OutSolutions);
+    }
+}
+
+u64 solver::CountSolutions(
+    const board& InputBoard,
+    const s32 NumRows,
+    const s32 NumCols,
+    const search_options& Options,
+    solution_cache* Cache,
+    search_control* Control,
+    search_stats* OutStats,
+    arena* Arena) const
+{
+    bitboard_tables& Tables = ResolveArena(Arena).BitboardTables;
+    bitboard_task InitialTask;
+    {
+        trace_scope TablesScope(Options.Trace, "build tables");
+        BuildBitboardTables(InputBoard, NumRows, NumCols, Tables);
+        InitializeBitboardTask(InputBoard, NumRows, NumCols, Tables, InitialTask);
+    }
+
+    cached_search_context Context;
+    Context.InputBoard = &InputBoard;
+    Context.Tables = &Tables;
+    Context.Options = &Options;
+    Context.Cache = Cache;
+    Context.OutSolutions = nullptr;
+    Context.Control = Control;
+    Context.NumUncheckedStates = 0;
+    Context.MaxSolutions = Control ? Control->MaxSolutions : 0;
+    Context.NumSolutionsFound = 0;
+    Context.IsStopped = false;
+    Context.NumBoardStatesTested = 0;
+    InitializePieceRanking(Options.PieceOrder, false, Context.PieceRanking);
+
+    if (Control)
+    {
+        Control->Begin();
+    }
+    trace_scope CountScope(Options.Trace, "count");
+    if (Options.FrontierMemoryMB > 0 && !Context.MaxSolutions)
+    {
+        RunFrontierCount(Context, InitialTask, (size_t)Options.FrontierMemoryMB * 1024 * 1024, ResolveArena(Arena).Frontier, OutStats);
+    }
+    else
+    {
+        RunCachedSearch(Context, InitialTask, OutStats);
+    }
+
+    // a cached sub-problem can take the count past the limit
+    if (Context.MaxSolutions && Context.NumSolutionsFound > Context.MaxSolutions)
+    {
+        return Context.MaxSolutions;
+    }
+    return Context.NumSolutionsFound;
+}
+
+template <bool COLLECT_STATS>
+void solver::SearchExactCover(
+    exact_cover_context& Context,
+    const s32 Depth) const
+{
+    exact_cover_matrix& Matrix = Context.Matrix;
+    if (ShouldStopSearch(Context.Control, Context.NumUncheckedStates))
+    {
+        Context.IsStopped = true;
+        return;
+    }
+    if (COLLECT_STATS)
+    {
+        Context.Stats.NumBoardStatesTested++;
+        Context.Stats.MaxStackDepth = ((u64)Depth + 1 > Context.Stats.MaxStackDepth) ? (u64)Depth + 1 : Context.Stats.MaxStackDepth;
+    }
+
+    const s32 HeaderIdx = Matrix.ChooseColumn();
+    if (HeaderIdx == 0)
+    {
+        // every cell and piece is covered exactly once
+        board Solution = *Context.InputBoard;
+        for (s32 ChosenIdx = 0; ChosenIdx < Depth; ChosenIdx++)
+        {
+            const exact_cover_row& Row = Context.Rows[Context.ChosenRowIdxs[ChosenIdx]];
+            const cell_value NewCellValue = PieceIndexToCellValue(Row.PieceIdx);
+            for (s32 BallIdx = 0; BallIdx < SearchPieces[Row.PieceIdx].NumBalls; BallIdx++)
+            {
+                Solution.Cells[Row.Balls[BallIdx].RowIdx][Row.Balls[BallIdx].ColIdx] = NewCellValue;
+            }
+        }
+        Context.OutSolutions->Add(Solution);
+        return;
+    }
+
+    if (Matrix.ColumnSizes[HeaderIdx] == 0)
+    {
+        return;
+    }
+
+    // try every row that covers the chosen column. a stopped search still unwinds, so each cover is undone
+    Matrix.Cover(HeaderIdx);
+    for (s32 RowNodeIdx = Matrix.Nodes[HeaderIdx].Down; RowNodeIdx != HeaderIdx && !Context.IsStopped; RowNodeIdx = Matrix.Nodes[RowNodeIdx].Down)
+    {
+        if (COLLECT_STATS)
+        {
+            Context.Stats.NumOrientationsTested++;
+        }
+        Context.ChosenRowIdxs[Depth] = Matrix.Nodes[RowNodeIdx].RowIdx;
+        for (s32 NodeIdx = Matrix.Nodes[RowNodeIdx].Right; NodeIdx != RowNodeIdx; NodeIdx = Matrix.Nodes[NodeIdx].Right)
+        {
+            Matrix.Cover(Matrix.Nodes[NodeIdx].ColumnIdx);
+        }
+
+        SearchExactCover<COLLECT_STATS>(Context, Depth + 1);
+
+        for (s32 NodeIdx = Matrix.Nodes[RowNodeIdx].Left; NodeIdx != RowNodeIdx; NodeIdx = Matrix.Nodes[NodeIdx].Left)
+        {
+            Matrix.Uncover(Matrix.Nodes[NodeIdx].ColumnIdx);
+        }
+    }
+    Matrix.Uncover(HeaderIdx);
+}
+
+void solver::SolveExactCover(
+    const board& InputBoard,
+    const s32 NumRows,
+    const s32 NumCols,
+    search_control* Control,
+    solution_sink& OutSolutions,
+    search_stats* OutStats,
+    arena* Arena) const
+{
+    limited_solution_sink LimitedSolutions;
+    solution_sink& SearchSolutions = BeginControlledSearch(Control, OutSolutions, LimitedSolutions);
+    if (Control && Control->IsStopped())
+    {
+        if (OutStats)
+        {
+            *OutStats = search_stats();
+        }
+        return;
+    }
+
+    // one column per valid cell (numbered in row-major order) followed by one column per piece. columns that are
+    // already covered on the input board (blocked cells, cells and pieces already placed) don't need covering
+    exact_cover_context& Context = ResolveArena(Arena).ExactCover;
+    Context.InputBoard = &InputBoard;
+    Context.OutSolutions = &SearchSolutions;
+    Context.Control = Control;
+    Context.NumUncheckedStates = 0;
+    Context.IsStopped = false;
+    Context.Stats = search_stats();
+    Context.Matrix.Reset(NUM_VALID_CELLS + NUM_PIECES);
+
+    s32 CellColumnIdxs[MAX_BOARD_SIZE][MAX_BOARD_SIZE];
+    bool IsPieceRemaining[NUM_PIECES];
+    for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+    {
+        IsPieceRemaining[PieceIdx] = true;
+    }
+
+    s32 NumCellColumns = 0;
+    for (s32 RowIdx = 0; RowIdx < MAX_BOARD_SIZE; RowIdx++)
+    {
+        for (s32 ColIdx = 0; ColIdx < MAX_BOARD_SIZE; ColIdx++)
+        {
+            const cell_value CellValue = InputBoard.Cells[RowIdx][ColIdx];
+            CellColumnIdxs[RowIdx][ColIdx] = -1;
+            if (CellValue == cell_value::Invalid)
+            {
+                continue;
+            }
+
+            assert(NumCellColumns < NUM_VALID_CELLS);
+            if (CellValue == cell_value::Empty)
+            {
+                CellColumnIdxs[RowIdx][ColIdx] = NumCellColumns;
+            }
+            else
+            {
+                Context.Matrix.RemoveColumn(NumCellColumns);
+                if (IsPiece(CellValue))
+                {
+                    IsPieceRemaining[CellValueToPieceIndex(CellValue)] = false;
+                }
+            }
+            NumCellColumns++;
+        }
+    }
+    assert(NumCellColumns == NUM_VALID_CELLS);
+
+    for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+    {
+        if (!IsPieceRemaining[PieceIdx])
+        {
+            Context.Matrix.RemoveColumn(NUM_VALID_CELLS + PieceIdx);
+        }
+    }
+
+    // one row for every position of every orientation of every remaining piece that only covers empty cells (each
+    // position is given by the cell its first ball covers)
+    Context.Rows.clear();
+    Context.Rows.reserve(4096);
+    for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+    {
+        if (!IsPieceRemaining[PieceIdx])
+        {
+            continue;
+        }
+
+        const search_piece& Piece = SearchPieces[PieceIdx];
+        for (s32 OrientationIdx = 0; OrientationIdx < Piece.NumOrientations; OrientationIdx++)
+        {
+            const piece_orientation& Orientation = Piece.Orientations[OrientationIdx];
+            for (s32 RowIdx = 0; RowIdx < NumRows; RowIdx++)
+            {
+                for (s32 ColIdx = 0; ColIdx < NumCols; ColIdx++)
+                {
+                    exact_cover_row Row;
+                    Row.PieceIdx = (u8)PieceIdx;
+
+                    s32 ColumnIdxs[MAX_BALLS + 1];
+                    bool CanPlace = true;
+                    for (s32 BallIdx = 0; BallIdx < Piece.NumBalls && CanPlace; BallIdx++)
+                    {
+                        const s32 BallRowIdx = RowIdx + Orientation.Balls[BallIdx].RowIdx - Orientation.Balls[0].RowIdx;
+                        const s32 BallColIdx = ColIdx + Orientation.Balls[BallIdx].ColIdx - Orientation.Balls[0].ColIdx;
+                        const bool IsValidCellIdx = (BallRowIdx >= 0) && (BallRowIdx < NumRows) && (BallColIdx >= 0) && (BallColIdx < NumCols);
+
+                        CanPlace = IsValidCellIdx && CellColumnIdxs[BallRowIdx][BallColIdx] >= 0;
+                        if (CanPlace)
+                        {
+                            Row.Balls[BallIdx].RowIdx = (u8)BallRowIdx;
+                            Row.Balls[BallIdx].ColIdx = (u8)BallColIdx;
+                            ColumnIdxs[BallIdx] = CellColumnIdxs[BallRowIdx][BallColIdx];
+                        }
+                    }
+
+                    if (CanPlace)
+                    {
+                        ColumnIdxs[Piece.NumBalls] = NUM_VALID_CELLS + PieceIdx;
+                        Context.Matrix.AddRow((s32)Context.Rows.size(), ColumnIdxs, Piece.NumBalls + 1);
+                        Context.Rows.push_back(Row);
+                    }
+                }
+            }
+        }
+    }
+
+    // note: balls aren't tested individually, each row already covers exactly its cells
+    if (OutStats)
+    {
+        SearchExactCover<true>(Context, 0);
+        *OutStats = Context.Stats;
+    }
+    else
+    {
+        SearchExactCover<false>(Context, 0);
+    }
+    EndControlledSearch(Control, Context.NumUncheckedStates);
+}
+
+bool CheckSolveOptions(const solve_options& Options, std::string& OutError)
+{
+    const bool IsSingleThreadedBitboard = (Options.Engine == search_engine::Bitboard && Options.NumThreads <= 1);
+    if (Options.NumThreads > 1 && Options.Engine != search_engine::Bitboard)
+    {
+        OutError = "multiple threads are only supported by the bitboard engine";
+        return false;
+    }
+    if (Options.InPlace && Options.Engine != search_engine::Grid)
+    {
+        OutError = "in-place search is only supported by the grid engine";
+        return false;
+    }
+    // the other engines have their own fixed order, and search every placement
+    const search_options DefaultSearch;
+    if (Options.Engine != search_engine::Bitboard && (Options.Search.CellOrder != DefaultSearch.CellOrder ||
+        Options.Search.PieceOrder != DefaultSearch.PieceOrder || Options.Search.PruneDeadRegions || Options.Search.UseSymmetry))
+    {
+        OutError = "cell and piece orders, dead region pruning and symmetry are only supported by the bitboard engine";
+        return false;
+    }
+    if ((Options.CountOnly || Options.Cache) && !IsSingleThreadedBitboard)
+    {
+        OutError = "counting and caching are only supported by the single-threaded bitboard engine";
+        return false;
+    }
+    if (Options.KeepSolutions && Options.CountOnly)
+    {
+        OutError = "solutions can't be kept when only counting them";
+        return false;
+    }
+    return true;
+}
+
+bool solver::SolveFromDatabase(
+    const board& InputBoard,
+    const s32 NumRows,
+    const s32 NumCols,
+    const solve_options& Options,
+    solution_sink* OutSolutions,
+    solve_result& OutResult) const
+{
+    const std::chrono::steady_clock::time_point ClockStart = std::chrono::steady_clock::now();
+    u64 NumSolutions;
+    std::vector<board> FoundSolutions;
+    if (!Options.Database->Lookup(InputBoard, NumSolutions, Options.CountOnly ? nullptr : &FoundSolutions))
+    {
+        return false;
+    }
+
+    search_control* Control = Options.Control;
+    if (Options.CountOnly)
+    {
+        // the count stops at the solution limit, as the search's would
+        if (Control)
+        {
+            Control->Begin();
+            if (Control->IsStopped())
+            {
+                NumSolutions = 0;
+            }
+            else if (Control->MaxSolutions && NumSolutions >= Control->MaxSolutions)
+            {
+                NumSolutions = Control->MaxSolutions;
+                Control->Stop(search_status::SolutionLimitReached);
+            }
+        }
+        OutResult.NumSolutions = NumSolutions;
+    }
+    else
+    {
+        solution_sink CountedSolutions;
+        result_solution_sink KeptSolutions;
+        KeptSolutions.Solutions = &OutResult.Solutions;
+        KeptSolutions.Sink = OutSolutions;
+        solution_sink& Solutions = Options.KeepSolutions ? KeptSolutions : (OutSolutions ? *OutSolutions : CountedSolutions);
+
+        if (OutSolutions)
+        {
+            OutSolutions->BeginBoard(InputBoard, NumRows, NumCols);
+        }
+
+        limited_solution_sink LimitedSolutions;
+        solution_sink& FoundSolutionSink = BeginControlledSearch(Control, Solutions, LimitedSolutions);
+        if (!Control || !Control->IsStopped())
+        {
+            AddSolutions(FoundSolutions, FoundSolutionSink);
+        }
+        OutResult.NumSolutions = Solutions.NumSolutions;
+
+        if (OutSolutions)
+        {
+            OutSolutions->EndBoard();
+        }
+    }
+    const std::chrono::steady_clock::time_point ClockEnd = std::chrono::steady_clock::now();
+
+    OutResult.Status = Control ? Control->GetStatus() : search_status::Complete;
+    OutResult.IsFromDatabase = true;
+    OutResult.ElapsedTimeSec = std::chrono::duration<f64>(ClockEnd - ClockStart).count();
+    return true;
+}
+
+bool solver::SolveBoard(
+    const board& InputBoard,
+    const solve_options& Options,
+    solution_sink* OutSolutions,
+    solve_result& OutResult,
+    std::string& OutError,
+    arena* Arena) const
+{
+    if (!CheckSolveOptions(Options, OutError))
+    {
+        return false;
+    }
+
+    // note: the result's solutions are cleared rather than reassigned, so that a reused result keeps their memory
+    s32 NumRows, NumCols;
+    ComputeBoardSize(InputBoard, NumRows, NumCols);
+    OutResult.NumSolutions = 0;
+    OutResult.Status = search_status::Complete;
+    OutResult.NumRows = NumRows;
+    OutResult.NumCols = NumCols;
+    OutResult.Solutions.clear();
+    OutResult.Stats = search_stats();
+    OutResult.IsFromDatabase = false;
+
+    trace_scope SolveScope(Options.Search.Trace, "solve");
+    SolveScope.ArgName = "solutions";
+
+    if (Options.Database && SolveFromDatabase(InputBoard, NumRows, NumCols, Options, OutSolutions, OutResult))
+    {
+        SolveScope.Name = "solve from database";
+        SolveScope.ArgValue = OutResult.NumSolutions;
+        return true;
+    }
+
+    search_stats* OutStats = Options.CollectStats ? &OutResult.Stats : nullptr;
+
+    if (Options.CountOnly)
+    {
+        const std::chrono::steady_clock::time_point ClockStart = std::chrono::steady_clock::now();
+        OutResult.NumSolutions = CountSolutions(
+            InputBoard,
+            NumRows,
+            NumCols,
+            Options.Search,
+            Options.Cache,
+            Options.Control,
+            OutStats,
+            Arena);
+        const std::chrono::steady_clock::time_point ClockEnd = std::chrono::steady_clock::now();
+
+        OutResult.Status = Options.Control ? Options.Control->GetStatus() : search_status::Complete;
+        OutResult.ElapsedTimeSec = std::chrono::duration<f64>(ClockEnd - ClockStart).count();
+        SolveScope.ArgValue = OutResult.NumSolutions;
+        return true;
+    }
+
+    // solutions go straight to the caller's sink, unless they are kept in the result too
+    solution_sink CountedSolutions;
+    result_solution_sink KeptSolutions;
+    KeptSolutions.Solutions = &OutResult.Solutions;
+    KeptSolutions.Sink = OutSolutions;
+    solution_sink& Solutions = Options.KeepSolutions ? KeptSolutions : (OutSolutions ? *OutSolutions : CountedSolutions);
+
+    if (OutSolutions)
+    {
+        OutSolutions->BeginBoard(InputBoard, NumRows, NumCols);
+    }
+
+    const std::chrono::steady_clock::time_point ClockStart = std::chrono::steady_clock::now();
+    if (Options.Engine == search_engine::Bitboard && Options.NumThreads > 1)
+    {
+        SolveParallel(
+            InputBoard,
+            NumRows,
+            NumCols,
+            Options.Search,
+            Options.NumThreads,
+            Options.DeterministicOrder,
+            Options.Control,
+            Solutions,
+            OutStats,
+            Arena);
+    }
+    else if (Options.Engine == search_engine::Bitboard && Options.Cache)
+    {
+        SolveCached(
+            InputBoard,
+            NumRows,
+            NumCols,
+            Options.Search,
+            *Options.Cache,
+            Options.Control,
+            Solutions,
+            OutStats,
+            Arena);
+    }
+    else if (Options.Engine == search_engine::Bitboard)
+    {
+        SolveBitboard(
+            InputBoard,
+            NumRows,
+            NumCols,
+            Options.Search,
+            Options.Control,
+            Solutions,
+            OutStats,
+            Arena);
+    }
+    else if (Options.Engine == search_engine::ExactCover)
+    {
+        SolveExactCover(
+            InputBoard,
+            NumRows,
+            NumCols,
+            Options.Control,
+            Solutions,
+            OutStats,
+            Arena);
+    }
+    else if (Options.InPlace)
+    {
+        SolveInPlace(
+            InputBoard,
+            NumRows,
+            NumCols,
+            Options.Control,
+            Solutions,
+            OutStats,
+            Arena);
+    }
+    else
+    {
+        Solve(
+            InputBoard,
+            NumRows,
+            NumCols,
+            Options.Control,
+            Solutions,
+            OutStats,
+            Arena);
+    }
+    const std::chrono::steady_clock::time_point ClockEnd = std::chrono::steady_clock::now();
+
+    OutResult.NumSolutions = Solutions.NumSolutions;
+    OutResult.Status = Options.Control ? Options.Control->GetStatus() : search_status::Complete;
+    OutResult.ElapsedTimeSec = std::chrono::duration<f64>(ClockEnd - ClockStart).count();
+
+    if (OutSolutions)
+    {
+        OutSolutions->EndBoard();
+    }
+
+    SolveScope.ArgValue = OutResult.NumSolutions;
+    return true;
+}
+
+// where parsing a run of boards stopped, if it found a malformed board
+struct board_parse_error
+{
+    bool IsSet = false;
+    s64 LineNumber = 0; // relative to the start of the text that was parsed
+    std::string Message;
+};
+
+// parses the boards in [Begin, End), which must start at the beginning of a line outside of a board. a board is a run
+// of non-empty lines, one per row, and boards are separated by blank lines. returns false at the first malformed
+// board (including one whose pieces don't pass solver::CheckBoard), filling in OutError
+bool ParseBoards(
+    const char* Begin,
+    const char* End,
+    const solver& Solver,
+    std::vector<board>& OutBoards,
+    board_parse_error& OutError)
+{
+    // maps input chars to cell values, 0xFF marks chars that can't appear in a board
+    u8 CharCellValues[256];
+    memset(CharCellValues, 0xFF, sizeof(CharCellValues));
+    for (const char InputChar : std::string(" .*ABCDEFGHIJKL"))
+    {
+        CharCellValues[(u8)InputChar] = (u8)InputCharToCellValue(InputChar);
+    }
+
+    char ErrorMessage[128];
+    auto SetError = [&](const s64 LineNumber)
+    {
+        OutError.IsSet = true;
+        OutError.LineNumber = LineNumber;
+        OutError.Message = ErrorMessage;
+        return false;
+    };
+
+    board Board;
+    bool IsInBoard = false;
+    s64 BoardLineNumber = 0;
+    s32 RowIdx = 0;
+    s32 NumValidCells = 0;
+
+    s64 LineNumber = 0;
+    for (const char* LineBegin = Begin; LineBegin < End || IsInBoard; )
+    {
+        LineNumber++;
+        const char* LineEnd = (const char*)memchr(LineBegin, '\n', End - LineBegin);
+        const char* NextLineBegin = LineEnd ? LineEnd + 1 : End;
+        LineEnd = LineEnd ? LineEnd : End;
+        if (LineEnd > LineBegin && LineEnd[-1] == '\r')
+        {
+            LineEnd--;
+        }
+
+        if (LineBegin == LineEnd)
+        {
+            // a blank line (or the end of the text) ends the board
+            if (IsInBoard)
+            {
+                if (NumValidCells != NUM_VALID_CELLS)
+                {
+                    snprintf(ErrorMessage, sizeof(ErrorMessage), "board has %d valid cells, expected %d", NumValidCells, NUM_VALID_CELLS);
+                    return SetError(BoardLineNumber);
+                }
+                std::string PieceError;
+                if (!Solver.CheckBoard(Board, PieceError))
+                {
+                    snprintf(ErrorMessage, sizeof(ErrorMessage), "%s", PieceError.c_str());
+                    return SetError(BoardLineNumber);
+                }
+                OutBoards.push_back(Board);
+                IsInBoard = false;
+            }
+            LineBegin = NextLineBegin;
+            continue;
+        }
+
+        if (!IsInBoard)
+        {
+            SetCells(Board, cell_value::Invalid);
+            IsInBoard = true;
+            BoardLineNumber = LineNumber;
+            RowIdx = 0;
+            NumValidCells = 0;
+        }
+
+        if (RowIdx >= MAX_BOARD_SIZE)
+        {
+            snprintf(ErrorMessage, sizeof(ErrorMessage), "board has more than %d rows", MAX_BOARD_SIZE);
+            return SetError(LineNumber);
+        }
+        if (LineEnd - LineBegin > MAX_BOARD_SIZE)
+        {
+            snprintf(ErrorMessage, sizeof(ErrorMessage), "row has more than %d cells", MAX_BOARD_SIZE);
+            return SetError(LineNumber);
+        }
+
+        for (s32 ColIdx = 0; ColIdx < LineEnd - LineBegin; ColIdx++)
+        {
+            const u8 InputChar = (u8)LineBegin[ColIdx];
+            if (CharCellValues[InputChar] == 0xFF)
+            {
+                const bool IsPrintable = (InputChar >= 0x20 && InputChar < 0x7F);
+                snprintf(ErrorMessage, sizeof(ErrorMessage), IsPrintable ? "unexpected character '%c' in column %d" : "unexpected character 0x%02x in column %d",
+                    InputChar, ColIdx + 1);
+                return SetError(LineNumber);
+            }
+
+            Board.Cells[RowIdx][ColIdx] = (cell_value)CharCellValues[InputChar];
+            NumValidCells += (CharCellValues[InputChar] != cell_value::Invalid);
+        }
+        RowIdx++;
+
+        LineBegin = NextLineBegin;
+    }
+
+    return true;
+}
+
+// reads the whole file into OutText
+bool ReadFile(const std::string& Filename, std::vector<char>& OutText, std::string& OutError)
+{
+    FILE* FilePtr = fopen(Filename.c_str(), "rb");
+    if (!FilePtr)
+    {
+        OutError = "can't open '" + Filename + "'";
+        return false;
+    }
+
+    constexpr size_t READ_BLOCK_SIZE = 1 << 20;
+    size_t TextSize = 0;
+    while (1)
+    {
+        OutText.resize(TextSize + READ_BLOCK_SIZE);
+        const size_t NumBytesRead = fread(OutText.data() + TextSize, 1, READ_BLOCK_SIZE, FilePtr);
+        TextSize += NumBytesRead;
+        if (NumBytesRead < READ_BLOCK_SIZE)
+        {
+            break;
+        }
+    }
+    OutText.resize(TextSize);
+
+    const bool HasReadError = ferror(FilePtr) != 0;
+    fclose(FilePtr);
+    if (HasReadError)
+    {
+        OutError = "couldn't read '" + Filename + "'";
+        return false;
+    }
+
+    return true;
+}
+
+bool LoadBoards(const std::string& Filename, const solver& Solver, std::vector<board>& OutBoards, std::string& OutError)
+{
+    std::vector<char> Text;
+    if (!ReadFile(Filename, Text, OutError))
+    {
+        return false;
+    }
+
+    const size_t TextSize = Text.size();
+    const char* TextBegin = Text.data();
+    const char* TextEnd = TextBegin + TextSize;
+
+    // texts smaller than this are parsed on one thread, as starting the threads would take longer
+    constexpr size_t MIN_PARALLEL_TEXT_SIZE = 4 << 20;
+    s32 NumChunks = 1;
+    if (TextSize >= MIN_PARALLEL_TEXT_SIZE)
+    {
+        NumChunks = (s32)std::thread::hardware_concurrency();
+        NumChunks = (NumChunks > 0) ? NumChunks : 1;
+    }
+
+    // each chunk starts just after a blank line, so never in the middle of a board
+    std::vector<const char*> ChunkBegins;
+    ChunkBegins.push_back(TextBegin);
+    for (s32 ChunkIdx = 1; ChunkIdx < NumChunks; ChunkIdx++)
+    {
+        const char* Split = TextBegin + (TextSize * ChunkIdx) / NumChunks;
+        Split = (Split > ChunkBegins.back()) ? Split : ChunkBegins.back();
+        while (Split < TextEnd)
+        {
+            const char* Newline = (const char*)memchr(Split, '\n', TextEnd - Split);
+            if (!Newline)
+            {
+                Split = TextEnd;
+                break;
+            }
+
+            Split = Newline + 1;
+            const char* NextLineEnd = Split;
+            NextLineEnd += (NextLineEnd < TextEnd && *NextLineEnd == '\r');
+            if (NextLineEnd < TextEnd && *NextLineEnd == '\n')
+            {
+                Split = NextLineEnd + 1;
+                break;
+            }
+        }
+        ChunkBegins.push_back(Split);
+    }
+    ChunkBegins.push_back(TextEnd);
+
+    std::vector<std::vector<board>> ChunkBoards(NumChunks);
+    std::vector<board_parse_error> ChunkErrors(NumChunks);
+    auto ParseChunk = [&](const s32 ChunkIdx)
+    {
+        ParseBoards(ChunkBegins[ChunkIdx], ChunkBegins[ChunkIdx + 1], Solver, ChunkBoards[ChunkIdx], ChunkErrors[ChunkIdx]);
+    };
+
+    std::vector<std::thread> Threads;
+    Threads.reserve(NumChunks - 1);
+    for (s32 ChunkIdx = 1; ChunkIdx < NumChunks; ChunkIdx++)
+    {
+        Threads.emplace_back(ParseChunk, ChunkIdx);
+    }
+    ParseChunk(0);
+    for (std::thread& Thread : Threads)
+    {
+        Thread.join();
+    }
+
+    for (s32 ChunkIdx = 0; ChunkIdx < NumChunks; ChunkIdx++)
+    {
+        const board_parse_error& Error = ChunkErrors[ChunkIdx];
+        if (Error.IsSet)
+        {
+            // error line numbers are relative to their chunk
+            const s64 LineNumber = Error.LineNumber + std::count(TextBegin, ChunkBegins[ChunkIdx], '\n');
+            OutError = Filename + ":" + std::to_string(LineNumber) + ": " + Error.Message;
+            return false;
+        }
+    }
+
+    size_t NumBoards = 0;
+    for (const std::vector<board>& Boards : ChunkBoards)
+    {
+        NumBoards += Boards.size();
+    }
+    OutBoards.reserve(OutBoards.size() + NumBoards);
+    for (const std::vector<board>& Boards : ChunkBoards)
+    {
+        OutBoards.insert(OutBoards.end(), Boards.begin(), Boards.end());
+    }
+
+    if (NumBoards == 0)
+    {
+        OutError = Filename + ": no boards found";
+        return false;
+    }
+
+    return true;
+}
+
+bool ParseBoard(const std::string& Text, const solver& Solver, board& OutBoard, std::string& OutError)
+{
+    std::vector<board> Boards;
+    board_parse_error Error;
+    if (!ParseBoards(Text.data(), Text.data() + Text.size(), Solver, Boards, Error))
+    {
+        OutError = "line " + std::to_string(Error.LineNumber) + ": " + Error.Message;
+        return false;
+    }
+
+    if (Boards.size() != 1)
+    {
+        OutError = Boards.empty() ? "no board found" : "more than one board found";
+        return false;
+    }
+
+    OutBoard = Boards[0];
+    return true;
+}
+
+bool ParsePieces(const char* Text, piece_definition (&OutPieces)[NUM_PIECES], std::string& OutError)
+{
+    for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+    {
+        s32 NumBalls = 0;
+        for (s32 BallRowIdx = 0; BallRowIdx < MAX_PIECE_SIZE; BallRowIdx++)
+        {
+            for (s32 BallColIdx = 0; BallColIdx < MAX_PIECE_SIZE; BallColIdx++)
+            {
+                char* NumberEnd;
+                const long InputBit = strtol(Text, &NumberEnd, 10);
+                if (NumberEnd == Text || (InputBit != 0 && InputBit != 1))
+                {
+                    OutError = "piece " + std::to_string(PieceIdx + 1) + " should be " + std::to_string(MAX_PIECE_SIZE) + "x" +
+                        std::to_string(MAX_PIECE_SIZE) + " 0s and 1s";
+                    return false;
+                }
+                Text = NumberEnd;
+
+                OutPieces[PieceIdx].Balls[BallRowIdx][BallColIdx] = (u8)InputBit;
+                NumBalls += (s32)InputBit;
+            }
+        }
+
+        if (NumBalls == 0 || NumBalls > MAX_BALLS)
+        {
+            OutError = "piece " + std::to_string(PieceIdx + 1) + " has " + std::to_string(NumBalls) + " balls, expected 1 to " +
+                std::to_string(MAX_BALLS);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool LoadPieces(const std::string& Filename, piece_definition (&OutPieces)[NUM_PIECES], std::string& OutError)
+{
+    std::vector<char> Text;
+    if (!ReadFile(Filename, Text, OutError))
+    {
+        return false;
+    }
+    Text.push_back('\0');
+
+    if (!ParsePieces(Text.data(), OutPieces, OutError))
+    {
+        OutError = Filename + ": " + OutError;
+        return false;
+    }
+
+    return true;
+}
+
+static_assert(sizeof(subproblem_key) == (MAX_BOARD_SIZE + 1) * sizeof(u16), "database keys are compared and stored as raw bytes");
+static_assert(sizeof(solution_database::file_entry) == 64, "database entries mustn't have any implicit padding");
+
+// 64-bit FNV-1a
+u64 HashBytes(const void* Data, const size_t Size)
+{
+    const u8* Bytes = (const u8*)Data;
+    u64 Hash = 0xCBF29CE484222325ull;
+    for (size_t ByteIdx = 0; ByteIdx < Size; ByteIdx++)
+    {
+        Hash = (Hash ^ Bytes[ByteIdx]) * 0x100000001B3ull;
+    }
+    return Hash;
+}
+
+bool IsLessSubproblemKey(const subproblem_key& A, const subproblem_key& B)
+{
+    return memcmp(&A, &B, sizeof(subproblem_key)) < 0;
+}
+
+// the key a board is stored under in a solution_database, along with the board cell of each empty cell of the key in
+// the key's row-major order (which is the order the pieces of a solution are stored in)
+struct database_board_key
+{
+    subproblem_key Key;
+    s32 NumEmptyCells;
+    u8 CellIdxs[NUM_VALID_CELLS]; // row-major index into board::Cells
+};
+
+void ComputeDatabaseBoardKey(const board& Board, database_board_key& OutKey)
+{
+    s32 RowIdxs[NUM_VALID_CELLS];
+    s32 ColIdxs[NUM_VALID_CELLS];
+    s32 NumEmptyCells = 0;
+    u16 RemainingPieceBitFlags = (u16)((1u << NUM_PIECES) - 1u);
+    for (s32 RowIdx = 0; RowIdx < MAX_BOARD_SIZE; RowIdx++)
+    {
+        for (s32 ColIdx = 0; ColIdx < MAX_BOARD_SIZE; ColIdx++)
+        {
+            const cell_value CellValue = Board.Cells[RowIdx][ColIdx];
+            if (CellValue == cell_value::Empty)
+            {
+                assert(NumEmptyCells < NUM_VALID_CELLS);
+                RowIdxs[NumEmptyCells] = RowIdx;
+                ColIdxs[NumEmptyCells] = ColIdx;
+                NumEmptyCells++;
+            }
+            else if (IsPiece(CellValue))
+            {
+                RemainingPieceBitFlags &= ~(1u << CellValueToPieceIndex(CellValue));
+            }
+        }
+    }
+    OutKey.NumEmptyCells = NumEmptyCells;
+
+    // key the empty cells under each rotation/reflection (numbered as in ReduceBySymmetry), keeping the smallest key
+    for (s32 TransformIdx = 0; TransformIdx < 2 * NUM_ROTATIONS; TransformIdx++)
+    {
+        s32 TransformedRowIdxs[NUM_VALID_CELLS];
+        s32 TransformedColIdxs[NUM_VALID_CELLS];
+        s32 MinRowIdx = INT32_MAX, MinColIdx = INT32_MAX;
+        for (s32 CellIdx = 0; CellIdx < NumEmptyCells; CellIdx++)
+        {
+            s32 RowIdx = RowIdxs[CellIdx];
+            s32 ColIdx = ColIdxs[CellIdx];
+            if (TransformIdx >= NUM_ROTATIONS)
+            {
+                RowIdx = -RowIdx;
+            }
+            for (s32 RotationIdx = 0; RotationIdx < TransformIdx % NUM_ROTATIONS; RotationIdx++)
+            {
+                const s32 OldRowIdx = RowIdx;
+                RowIdx = ColIdx;
+                ColIdx = -OldRowIdx;
+            }
+
+            TransformedRowIdxs[CellIdx] = RowIdx;
+            TransformedColIdxs[CellIdx] = ColIdx;
+            MinRowIdx = (RowIdx < MinRowIdx) ? RowIdx : MinRowIdx;
+            MinColIdx = (ColIdx < MinColIdx) ? ColIdx : MinColIdx;
+        }
+
+        subproblem_key Key;
+        memset(&Key, 0, sizeof(Key));
+        Key.RemainingPieceBitFlags = RemainingPieceBitFlags;
+        u16 KeyCellIdxs[NUM_VALID_CELLS];
+        for (s32 CellIdx = 0; CellIdx < NumEmptyCells; CellIdx++)
+        {
+            TransformedRowIdxs[CellIdx] -= MinRowIdx;
+            TransformedColIdxs[CellIdx] -= MinColIdx;
+            Key.EmptyCellRows[TransformedRowIdxs[CellIdx]] |= (u16)(1u << TransformedColIdxs[CellIdx]);
+            KeyCellIdxs[CellIdx] = (u16)(TransformedRowIdxs[CellIdx] * MAX_BOARD_SIZE + TransformedColIdxs[CellIdx]);
+        }
+
+        if (TransformIdx > 0 && !IsLessSubproblemKey(Key, OutKey.Key))
+        {
+            continue;
+        }
+
+        // list the board cells in the order of the key's cells
+        s32 SortedCellIdxs[NUM_VALID_CELLS];
+        for (s32 CellIdx = 0; CellIdx < NumEmptyCells; CellIdx++)
+        {
+            SortedCellIdxs[CellIdx] = CellIdx;
+        }
+        std::sort(SortedCellIdxs, SortedCellIdxs + NumEmptyCells, [&](const s32 A, const s32 B)
+        {
+            return KeyCellIdxs[A] < KeyCellIdxs[B];
+        });
+
+        OutKey.Key = Key;
+        for (s32 KeyCellIdx = 0; KeyCellIdx < NumEmptyCells; KeyCellIdx++)
+        {
+            const s32 CellIdx = SortedCellIdxs[KeyCellIdx];
+            OutKey.CellIdxs[KeyCellIdx] = (u8)(RowIdxs[CellIdx] * MAX_BOARD_SIZE + ColIdxs[CellIdx]);
+        }
+    }
+}
+
+// bytes taken by each solution of an entry, at 4 bits per empty cell
+u64 ComputeDatabaseRecordSize(const s32 NumEmptyCells)
+{
+    return (u64)(NumEmptyCells + 1) / 2;
+}
+
+const solution_database::file_entry* FindDatabaseEntry(
+    const solution_database::file_entry* Entries,
+    const u64 NumEntries,
+    const subproblem_key& Key)
+{
+    const solution_database::file_entry* Entry = std::lower_bound(Entries, Entries + NumEntries, Key,
+        [](const solution_database::file_entry& Entry, const subproblem_key& Key)
+    {
+        return IsLessSubproblemKey(Entry.Key, Key);
+    });
+    return (Entry != Entries + NumEntries && Entry->Key == Key) ? Entry : nullptr;
+}
+
+solution_database::solution_database(const piece_definition (&Pieces)[NUM_PIECES]) :
+    FileData(nullptr), FileSize(0), Entries(nullptr), NumEntries(0), SolutionData(nullptr), SolutionDataSize(0)
+{
+    u32 PackedPieces[NUM_PIECES];
+    for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+    {
+        PackedPieces[PieceIdx] = ComputePackedRepresentation(Pieces[PieceIdx]);
+    }
+    PieceSetHash = HashBytes(PackedPieces, sizeof(PackedPieces));
+}
+
+solution_database::~solution_database()
+{
+    Close();
+}
+
+bool solution_database::Open(const std::string& Filename, std::string& OutError)
+{
+    Close();
+
+#if defined(_WIN32)
+    FILE* FilePtr = fopen(Filename.c_str(), "rb");
+    if (!FilePtr)
+    {
+        return true;
+    }
+    fclose(FilePtr);
+
+    if (!ReadFile(Filename, FileCopy, OutError))
+    {
+        return false;
+    }
+    FileData = (const u8*)FileCopy.data();
+    FileSize = FileCopy.size();
+#else
+    const int FileDesc = open(Filename.c_str(), O_RDONLY);
+    if (FileDesc < 0)
+    {
+        if (errno == ENOENT)
+        {
+            return true;
+        }
+        OutError = "can't open '" + Filename + "'";
+        return false;
+    }
+
+    struct stat FileStat;
+    const bool HasSize = (fstat(FileDesc, &FileStat) == 0 && FileStat.st_size > 0);
+    void* Mapping = HasSize ? mmap(nullptr, (size_t)FileStat.st_size, PROT_READ, MAP_PRIVATE, FileDesc, 0) : MAP_FAILED;
+    close(FileDesc);
+    if (Mapping == MAP_FAILED)
+    {
+        OutError = "couldn't map '" + Filename + "'";
+        return false;
+    }
+    FileData = (const u8*)Mapping;
+    FileSize = (size_t)FileStat.st_size;
+#endif
+
+    // only the header and the entries are checked up front, each entry's solutions are checked when it is looked up
+    const file_header* Header = (const file_header*)FileData;
+    const char* Problem = nullptr;
+    if (FileSize < sizeof(file_header) || Header->Magic != MAGIC)
+    {
+        Problem = "isn't a solution database";
+    }
+    else if (Header->Version != VERSION)
+    {
+        Problem = "was written by a different version";
+    }
+    else if (Header->PieceSetHash != PieceSetHash)
+    {
+        Problem = "was built with a different piece set";
+    }
+    else if (Header->NumEntries > (FileSize - sizeof(file_header)) / sizeof(file_entry) ||
+        Header->SolutionDataSize != FileSize - sizeof(file_header) - Header->NumEntries * sizeof(file_entry))
+    {
+        Problem = "is truncated";
+    }
+    else if (HashBytes(FileData + sizeof(file_header), Header->NumEntries * sizeof(file_entry)) != Header->EntriesChecksum)
+    {
+        Problem = "is damaged";
+    }
+
+    if (Problem)
+    {
+        Close();
+        OutError = "'" + Filename + "' " + Problem;
+        return false;
+    }
+
+    Entries = (const file_entry*)(FileData + sizeof(file_header));
+    NumEntries = Header->NumEntries;
+    SolutionData = (const u8*)(Entries + NumEntries);
+    SolutionDataSize = Header->SolutionDataSize;
+    return true;
+}
+
+void solution_database::Close()
+{
+#if defined(_WIN32)
+    std::vector<char>().swap(FileCopy);
+#else
+    if (FileData)
+    {
+        munmap((void*)FileData, FileSize);
+    }
+#endif
+    FileData = nullptr;
+    FileSize = 0;
+    Entries = nullptr;
+    NumEntries = 0;
+    SolutionData = nullptr;
+    SolutionDataSize = 0;
+}
+
+bool solution_database::Lookup(const board& InputBoard, u64& OutNumSolutions, std::vector<board>* OutSolutions) const
+{
+    database_board_key BoardKey;
+    ComputeDatabaseBoardKey(InputBoard, BoardKey);
+    const file_entry* Entry = FindDatabaseEntry(Entries, NumEntries, BoardKey.Key);
+    if (!Entry || BoardKey.NumEmptyCells == 0)
+    {
+        return false;
+    }
+
+    // a damaged entry is treated as missing, so the board is just searched again
+    const u64 RecordSize = ComputeDatabaseRecordSize(BoardKey.NumEmptyCells);
+    if (Entry->NumEmptyCells != BoardKey.NumEmptyCells ||
+        Entry->SolutionDataOffset > SolutionDataSize ||
+        Entry->NumSolutions > (SolutionDataSize - Entry->SolutionDataOffset) / RecordSize)
+    {
+        return false;
+    }
+    const u8* Records = SolutionData + Entry->SolutionDataOffset;
+    if (HashBytes(Records, Entry->NumSolutions * RecordSize) != Entry->SolutionDataChecksum)
+    {
+        return false;
+    }
+
+    OutNumSolutions = Entry->NumSolutions;
+    if (!OutSolutions)
+    {
+        return true;
+    }
+
+    OutSolutions->assign(Entry->NumSolutions, InputBoard);
+    for (u64 SolutionIdx = 0; SolutionIdx < Entry->NumSolutions; SolutionIdx++)
+    {
+        const u8* Record = Records + SolutionIdx * RecordSize;
+        cell_value* Cells = &(*OutSolutions)[SolutionIdx].Cells[0][0];
+        for (s32 KeyCellIdx = 0; KeyCellIdx < BoardKey.NumEmptyCells; KeyCellIdx++)
+        {
+            const s32 PieceIdx = (Record[KeyCellIdx / 2] >> ((KeyCellIdx % 2) * 4)) & 0xFu;
+            Cells[BoardKey.CellIdxs[KeyCellIdx]] = PieceIndexToCellValue(PieceIdx);
+        }
+    }
+
+    // solutions from boards that are the same up to symmetry would otherwise come out in a different order
+    std::sort(OutSolutions->begin(), OutSolutions->end(), [](const board& A, const board& B)
+    {
+        return memcmp(&A, &B, sizeof(board)) < 0;
+    });
+    return true;
+}
+
+void solution_database::Add(const board& InputBoard, const std::vector<board>& Solutions)
+{
+    database_board_key BoardKey;
+    ComputeDatabaseBoardKey(InputBoard, BoardKey);
+    if (BoardKey.NumEmptyCells == 0 || FindDatabaseEntry(Entries, NumEntries, BoardKey.Key))
+    {
+        return;
+    }
+    for (const file_entry& AddedEntry : AddedEntries)
+    {
+        if (AddedEntry.Key == BoardKey.Key)
+        {
+            return;
+        }
+    }
+
+    // note: the offset is into the added solutions until the entry is written out
+    file_entry Entry;
+    memset(&Entry, 0, sizeof(Entry));
+    Entry.Key = BoardKey.Key;
+    Entry.NumEmptyCells = (u16)BoardKey.NumEmptyCells;
+    Entry.NumSolutions = Solutions.size();
+    Entry.SolutionDataOffset = AddedSolutionData.size();
+
+    const u64 RecordSize = ComputeDatabaseRecordSize(BoardKey.NumEmptyCells);
+    std::vector<u8> UnsortedRecords(Solutions.size() * RecordSize, 0u);
+    for (size_t SolutionIdx = 0; SolutionIdx < Solutions.size(); SolutionIdx++)
+    {
+        u8* Record = UnsortedRecords.data() + SolutionIdx * RecordSize;
+        const cell_value* Cells = &Solutions[SolutionIdx].Cells[0][0];
+        for (s32 KeyCellIdx = 0; KeyCellIdx < BoardKey.NumEmptyCells; KeyCellIdx++)
+        {
+            const cell_value CellValue = Cells[BoardKey.CellIdxs[KeyCellIdx]];
+            assert(IsPiece(CellValue));
+            Record[KeyCellIdx / 2] |= (u8)(CellValueToPieceIndex(CellValue) << ((KeyCellIdx % 2) * 4));
+        }
+    }
+
+    // the records are sorted so that the same board is always written out the same way, whichever search found it
+    std::vector<u32> RecordOrder(Solutions.size());
+    for (size_t SolutionIdx = 0; SolutionIdx < Solutions.size(); SolutionIdx++)
+    {
+        RecordOrder[SolutionIdx] = (u32)SolutionIdx;
+    }
+    std::sort(RecordOrder.begin(), RecordOrder.end(), [&](const u32 A, const u32 B)
+    {
+        return memcmp(&UnsortedRecords[A * RecordSize], &UnsortedRecords[B * RecordSize], RecordSize) < 0;
+    });
+
+    AddedSolutionData.resize(AddedSolutionData.size() + Solutions.size() * RecordSize);
+    u8* Records = AddedSolutionData.data() + Entry.SolutionDataOffset;
+    for (size_t SolutionIdx = 0; SolutionIdx < Solutions.size(); SolutionIdx++)
+    {
+        memcpy(Records + SolutionIdx * RecordSize, &UnsortedRecords[RecordOrder[SolutionIdx] * RecordSize], RecordSize);
+    }
+    Entry.SolutionDataChecksum = HashBytes(Records, Solutions.size() * RecordSize);
+
+    AddedEntries.push_back(Entry);
+}
+
+bool solution_database::Write(const std::string& Filename, std::string& OutError) const
+{
+    // merge the opened and added entries, which never share a key
+    struct entry_source
+    {
+        const file_entry* Entry;
+        const u8* Records;
+    };
+
+    std::vector<entry_source> Sources;
+    Sources.reserve(NumEntries + AddedEntries.size());
+    for (u64 EntryIdx = 0; EntryIdx < NumEntries; EntryIdx++)
+    {
+        Sources.push_back({ &Entries[EntryIdx], SolutionData + Entries[EntryIdx].SolutionDataOffset });
+    }
+    for (const file_entry& AddedEntry : AddedEntries)
+    {
+        Sources.push_back({ &AddedEntry, AddedSolutionData.data() + AddedEntry.SolutionDataOffset });
+    }
+    std::sort(Sources.begin(), Sources.end(), [](const entry_source& A, const entry_source& B)
+    {
+        return IsLessSubproblemKey(A.Entry->Key, B.Entry->Key);
+    });
+
+    std::vector<file_entry> NewEntries(Sources.size());
+    u64 NewSolutionDataSize = 0;
+    for (size_t EntryIdx = 0; EntryIdx < Sources.size(); EntryIdx++)
+    {
+        NewEntries[EntryIdx] = *Sources[EntryIdx].Entry;
+        NewEntries[EntryIdx].SolutionDataOffset = NewSolutionDataSize;
+        NewSolutionDataSize += NewEntries[EntryIdx].NumSolutions * ComputeDatabaseRecordSize(NewEntries[EntryIdx].NumEmptyCells);
+    }
+
+    file_header Header;
+    memset(&Header, 0, sizeof(Header));
+    Header.Magic = MAGIC;
+    Header.Version = VERSION;
+    Header.PieceSetHash = PieceSetHash;
+    Header.NumEntries = NewEntries.size();
+    Header.SolutionDataSize = NewSolutionDataSize;
+    Header.EntriesChecksum = HashBytes(NewEntries.data(), NewEntries.size() * sizeof(file_entry));
+
+    // write a new file and then replace the old one with it, so that a failed write never leaves a damaged database
+    // (and the opened file's mapping stays valid until it is closed)
+    const std::string TempFilename = Filename + ".tmp";
+    FILE* FilePtr = fopen(TempFilename.c_str(), "wb");
+    if (!FilePtr)
+    {
+        OutError = "can't open '" + TempFilename + "' for writing";
+        return false;
+    }
+
+    bool IsWritten = fwrite(&Header, sizeof(Header), 1, FilePtr) == 1;
+    IsWritten = IsWritten && fwrite(NewEntries.data(), sizeof(file_entry), NewEntries.size(), FilePtr) == NewEntries.size();
+    for (size_t EntryIdx = 0; EntryIdx < Sources.size() && IsWritten; EntryIdx++)
+    {
+        const size_t NumBytes = (size_t)(NewEntries[EntryIdx].NumSolutions * ComputeDatabaseRecordSize(NewEntries[EntryIdx].NumEmptyCells));
+        IsWritten = fwrite(Sources[EntryIdx].Records, 1, NumBytes, FilePtr) == NumBytes;
+    }
+    IsWritten = (fclose(FilePtr) == 0) && IsWritten;
+
+    // note: renaming over an existing file fails on some platforms, so remove it first if need be
+    if (!IsWritten ||
+        (rename(TempFilename.c_str(), Filename.c_str()) != 0 &&
+        (remove(Filename.c_str()) != 0 || rename(TempFilename.c_str(), Filename.c_str()) != 0)))
+    {
+        remove(TempFilename.c_str());
+        OutError = "couldn't write '" + Filename + "'";
+        return false;
+    }
+
+    return true;
+}
+
+// splitmix64, which is enough to spread consecutive seeds over the whole state
+u64 NextRandom(u64& State)
+{
+    u64 Value = (State += 0x9E3779B97F4A7C15ull);
+    Value = (Value ^ (Value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    Value = (Value ^ (Value >> 27)) * 0x94D049BB133111EBull;
+    return Value ^ (Value >> 31);
+}
+
+bool solver::GenerateBoards(
+    const std::vector<board>& Templates,
+    const generate_options& Options,
+    solution_sink& OutBoards,
+    generate_result& OutResult,
+    std::string& OutError) const
+{
+    OutResult = generate_result();
+    if (Templates.empty())
+    {
+        OutError = "there are no template boards to generate from";
+        return false;
+    }
+    if (Options.NumBoards == 0 || Options.NumThreads < 1 || Options.NumPlacedPieces < 0)
+    {
+        OutError = "at least one board and one thread are needed, and the number of pieces to place can't be negative";
+        return false;
+    }
+
+    // tries this many times to place each random piece before giving up on the candidate
+    constexpr s32 MAX_PLACEMENT_ATTEMPTS = 64;
+    constexpr s32 MAX_RANDOM_PIECES = 1;
+
+    const std::chrono::steady_clock::time_point ClockStart = std::chrono::steady_clock::now();
+
+    std::atomic<u64> NextCandidateIdx(0);
+    std::atomic<bool> IsDone(false);
+
+    // accepted boards are passed on (and counted) one at a time, skipping any puzzle that was already accepted
+    std::mutex OutputLock;
+    std::set<subproblem_key, bool (*)(const subproblem_key&, const subproblem_key&)> AcceptedKeys(IsLessSubproblemKey);
+
+    auto RunThread = [&]()
+    {
+        arena Arena;
+        search_control Control;
+        Control.MaxSolutions = Options.NumSolutions + 1;
+        Control.MaxBoardStates = Options.MaxCandidateStates;
+        search_control FirstSolutionControl;
+        FirstSolutionControl.MaxSolutions = 1;
+        FirstSolutionControl.MaxBoardStates = Options.MaxCandidateStates;
+        collecting_solution_sink FirstSolution;
+        generate_result ThreadResult;
+
+        while (!IsDone.load(std::memory_order_relaxed))
+        {
+            const u64 CandidateIdx = NextCandidateIdx.fetch_add(1, std::memory_order_relaxed);
+            if (Options.MaxCandidates && CandidateIdx >= Options.MaxCandidates)
+            {
+                break;
+            }
+            ThreadResult.NumCandidates++;
+
+            u64 RandomState = Options.Seed ^ (CandidateIdx * 0xD1B54A32D192ED03ull);
+            const board& Template = Templates[NextRandom(RandomState) % Templates.size()];
+            s32 NumRows, NumCols;
+            ComputeBoardSize(Template, NumRows, NumCols);
+
+            // choose which of the template's remaining pieces to place
+            s32 PieceIdxs[NUM_PIECES];
+            s32 NumRemainingPieces = 0;
+            {
+                u16 PlacedPieceBitFlags = 0;
+                for (s32 RowIdx = 0; RowIdx < NumRows; RowIdx++)
+                {
+                    for (s32 ColIdx = 0; ColIdx < NumCols; ColIdx++)
+                    {
+                        if (IsPiece(Template.Cells[RowIdx][ColIdx]))
+                        {
+                            PlacedPieceBitFlags |= (u16)(1u << CellValueToPieceIndex(Template.Cells[RowIdx][ColIdx]));
+                        }
+                    }
+                }
+                for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+                {
+                    if (!(PlacedPieceBitFlags & (1u << PieceIdx)))
+                    {
+                        PieceIdxs[NumRemainingPieces++] = PieceIdx;
+                    }
+                }
+            }
+            const s32 NumPlacedPieces = (Options.NumPlacedPieces < NumRemainingPieces) ? Options.NumPlacedPieces : NumRemainingPieces;
+
+            // the first few pieces are placed at random, in a random orientation with a random ball on a random empty
+            // cell, until they fit. random placements almost always leave the board unsolvable though, so the rest are
+            // taken from the first solution of the board with those pieces placed
+            for (s32 PlacedIdx = 0; PlacedIdx < NumPlacedPieces; PlacedIdx++)
+            {
+                const s32 ChosenIdx = PlacedIdx + (s32)(NextRandom(RandomState) % (u64)(NumRemainingPieces - PlacedIdx));
+                std::swap(PieceIdxs[PlacedIdx], PieceIdxs[ChosenIdx]);
+            }
+            const s32 NumRandomPieces = (NumPlacedPieces < MAX_RANDOM_PIECES) ? NumPlacedPieces : MAX_RANDOM_PIECES;
+
+            board Candidate = Template;
+            bool IsPlaced = true;
+            for (s32 PlacedIdx = 0; PlacedIdx < NumRandomPieces && IsPlaced; PlacedIdx++)
+            {
+                const s32 PieceIdx = PieceIdxs[PlacedIdx];
+                const search_piece& Piece = SearchPieces[PieceIdx];
+
+                cell_ref EmptyCells[NUM_VALID_CELLS];
+                s32 NumEmptyCells = 0;
+                for (s32 RowIdx = 0; RowIdx < NumRows; RowIdx++)
+                {
+                    for (s32 ColIdx = 0; ColIdx < NumCols; ColIdx++)
+                    {
+                        if (Candidate.Cells[RowIdx][ColIdx] == cell_value::Empty)
+                        {
+                            EmptyCells[NumEmptyCells].RowIdx = (u8)RowIdx;
+                            EmptyCells[NumEmptyCells].ColIdx = (u8)ColIdx;
+                            NumEmptyCells++;
+                        }
+                    }
+                }
+
+                IsPlaced = false;
+                for (s32 AttemptIdx = 0; AttemptIdx < MAX_PLACEMENT_ATTEMPTS && NumEmptyCells > 0 && !IsPlaced; AttemptIdx++)
+                {
+                    const piece_orientation& Orientation = Piece.Orientations[NextRandom(RandomState) % (u64)Piece.NumOrientations];
+                    const cell_ref EmptyCell = EmptyCells[NextRandom(RandomState) % (u64)NumEmptyCells];
+                    const cell_ref PlacedBall = Orientation.Balls[NextRandom(RandomState) % (u64)Piece.NumBalls];
+                    const s32 OffsetRowIdx = EmptyCell.RowIdx - PlacedBall.RowIdx;
+                    const s32 OffsetColIdx = EmptyCell.ColIdx - PlacedBall.ColIdx;
+
+                    bool CanPlace = true;
+                    for (s32 BallIdx = 0; BallIdx < Piece.NumBalls && CanPlace; BallIdx++)
+                    {
+                        const s32 BallRowIdx = OffsetRowIdx + Orientation.Balls[BallIdx].RowIdx;
+                        const s32 BallColIdx = OffsetColIdx + Orientation.Balls[BallIdx].ColIdx;
+                        CanPlace = (BallRowIdx >= 0) && (BallRowIdx < NumRows) && (BallColIdx >= 0) && (BallColIdx < NumCols) &&
+                            Candidate.Cells[BallRowIdx][BallColIdx] == cell_value::Empty;
+                    }
+                    if (CanPlace)
+                    {
+                        for (s32 BallIdx = 0; BallIdx < Piece.NumBalls; BallIdx++)
+                        {
+                            Candidate.Cells[OffsetRowIdx + Orientation.Balls[BallIdx].RowIdx][OffsetColIdx + Orientation.Balls[BallIdx].ColIdx] = PieceIndexToCellValue(PieceIdx);
+                        }
+                        IsPlaced = true;
+                    }
+                }
+            }
+            if (!IsPlaced)
+            {
+                ThreadResult.NumUnplaceable++;
+                continue;
+            }
+
+            if (NumPlacedPieces > NumRandomPieces)
+            {
+                FirstSolution.Solutions.clear();
+                if (Options.Cache)
+                {
+                    SolveCached(Candidate, NumRows, NumCols, Options.Search, *Options.Cache, &FirstSolutionControl, FirstSolution, nullptr, &Arena);
+                }
+                else
+                {
+                    SolveBitboard(Candidate, NumRows, NumCols, Options.Search, &FirstSolutionControl, FirstSolution, nullptr, &Arena);
+                }
+                if (FirstSolutionControl.GetStatus() == search_status::StateLimitReached)
+                {
+                    ThreadResult.NumAbandoned++;
+                    continue;
+                }
+                if (FirstSolution.Solutions.empty())
+                {
+                    ThreadResult.NumUnsolvable++;
+                    continue;
+                }
+
+                const board& Solution = FirstSolution.Solutions[0];
+                for (s32 RowIdx = 0; RowIdx < NumRows; RowIdx++)
+                {
+                    for (s32 ColIdx = 0; ColIdx < NumCols; ColIdx++)
+                    {
+                        const cell_value CellValue = Solution.Cells[RowIdx][ColIdx];
+                        for (s32 PlacedIdx = NumRandomPieces; PlacedIdx < NumPlacedPieces; PlacedIdx++)
+                        {
+                            if (Candidate.Cells[RowIdx][ColIdx] == cell_value::Empty && CellValue == PieceIndexToCellValue(PieceIdxs[PlacedIdx]))
+                            {
+                                Candidate.Cells[RowIdx][ColIdx] = CellValue;
+                            }
+                        }
+                    }
+                }
+            }
+
+            // counting stops at one solution more than wanted, which is usually found long before every solution
+            const u64 NumSolutions = CountSolutions(Candidate, NumRows, NumCols, Options.Search, Options.Cache, &Control, nullptr, &Arena);
+            const search_status Status = Control.GetStatus();
+            if (Status == search_status::StateLimitReached)
+            {
+                ThreadResult.NumAbandoned++;
+                continue;
+            }
+            if (NumSolutions != Options.NumSolutions)
+            {
+                if (NumSolutions == 0)
+                {
+                    ThreadResult.NumUnsolvable++;
+                }
+                else
+                {
+                    ThreadResult.NumWrongSolutionCount++;
+                }
+                continue;
+            }
+
+            database_board_key Key;
+            ComputeDatabaseBoardKey(Candidate, Key);
+
+            std::lock_guard<std::mutex> Lock(OutputLock);
+            if (IsDone.load(std::memory_order_relaxed))
+            {
+                break;
+            }
+            if (!AcceptedKeys.insert(Key.Key).second)
+            {
+                ThreadResult.NumDuplicates++;
+                continue;
+            }
+
+            OutBoards.BeginBoard(Candidate, NumRows, NumCols);
+            OutBoards.Add(Candidate);
+            OutBoards.EndBoard();
+            if (AcceptedKeys.size() >= Options.NumBoards)
+            {
+                IsDone.store(true, std::memory_order_relaxed);
+            }
+        }
+
+        std::lock_guard<std::mutex> Lock(OutputLock);
+        OutResult.NumCandidates += ThreadResult.NumCandidates;
+        OutResult.NumUnplaceable += ThreadResult.NumUnplaceable;
+        OutResult.NumUnsolvable += ThreadResult.NumUnsolvable;
+        OutResult.NumWrongSolutionCount += ThreadResult.NumWrongSolutionCount;
+        OutResult.NumAbandoned += ThreadResult.NumAbandoned;
+        OutResult.NumDuplicates += ThreadResult.NumDuplicates;
+    };
+
+    std::vector<std::thread> Threads;
+    Threads.reserve(Options.NumThreads - 1);
+    for (s32 ThreadIdx = 1; ThreadIdx < Options.NumThreads; ThreadIdx++)
+    {
+        Threads.emplace_back(RunThread);
+    }
+    RunThread();
+    for (std::thread& Thread : Threads)
+    {
+        Thread.join();
+    }
+
+    const std::chrono::steady_clock::time_point ClockEnd = std::chrono::steady_clock::now();
+    OutResult.NumAccepted = AcceptedKeys.size();
+    OutResult.ElapsedTimeSec = std::chrono::duration<f64>(ClockEnd - ClockStart).count();
+    return true;
+}
+
+// steps Idxs on to the next combination of NumIdxs increasing values below NumValues, in lexicographic order. returns
+// false once every combination has been visited
+bool NextCombination(s32* Idxs, const s32 NumIdxs, const s32 NumValues)
+{
+    s32 IdxIdx = NumIdxs - 1;
+    while (IdxIdx >= 0 && Idxs[IdxIdx] == NumValues - NumIdxs + IdxIdx)
+    {
+        IdxIdx--;
+    }
+    if (IdxIdx < 0)
+    {
+        return false;
+    }
+
+    Idxs[IdxIdx]++;
+    for (s32 NextIdxIdx = IdxIdx + 1; NextIdxIdx < NumIdxs; NextIdxIdx++)
+    {
+        Idxs[NextIdxIdx] = Idxs[NextIdxIdx - 1] + 1;
+    }
+    return true;
+}
+
+// the valid and blocked cells of a board, under whichever rotation/reflection gives the smallest key. unlike a
+// subproblem_key, blocked and invalid cells are told apart, so only boards that are the same up to symmetry match
+struct arrangement_key
+{
+    u16 ValidCellRows[MAX_BOARD_SIZE];
+    u16 BlockedCellRows[MAX_BOARD_SIZE];
+
+    bool operator<(const arrangement_key& Other) const
+    {
+        return memcmp(this, &Other, sizeof(arrangement_key)) < 0;
+    }
+
+    bool operator==(const arrangement_key& Other) const
+    {
+        return memcmp(this, &Other, sizeof(arrangement_key)) == 0;
+    }
+};
+
+// with NumTransforms = NUM_ROTATIONS, only rotations are tried
+void ComputeArrangementKey(const board& Board, const s32 NumTransforms, arrangement_key& OutKey)
+{
+    for (s32 TransformIdx = 0; TransformIdx < NumTransforms; TransformIdx++)
+    {
+        s32 TransformedRowIdxs[NUM_VALID_CELLS];
+        s32 TransformedColIdxs[NUM_VALID_CELLS];
+        bool IsBlocked[NUM_VALID_CELLS];
+        s32 NumValidCells = 0;
+        s32 MinRowIdx = INT32_MAX, MinColIdx = INT32_MAX;
+        for (s32 BoardRowIdx = 0; BoardRowIdx < MAX_BOARD_SIZE; BoardRowIdx++)
+        {
+            for (s32 BoardColIdx = 0; BoardColIdx < MAX_BOARD_SIZE; BoardColIdx++)
+            {
+                if (Board.Cells[BoardRowIdx][BoardColIdx] == cell_value::Invalid)
+                {
+                    continue;
+                }
+
+                s32 RowIdx = (TransformIdx >= NUM_ROTATIONS) ? -BoardRowIdx : BoardRowIdx;
+                s32 ColIdx = BoardColIdx;
+                for (s32 RotationIdx = 0; RotationIdx < TransformIdx % NUM_ROTATIONS; RotationIdx++)
+                {
+                    const s32 OldRowIdx = RowIdx;
+                    RowIdx = ColIdx;
+                    ColIdx = -OldRowIdx;
+                }
+
+                assert(NumValidCells < NUM_VALID_CELLS);
+                TransformedRowIdxs[NumValidCells] = RowIdx;
+                TransformedColIdxs[NumValidCells] = ColIdx;
+                IsBlocked[NumValidCells] = (Board.Cells[BoardRowIdx][BoardColIdx] == cell_value::Blocked);
+                NumValidCells++;
+                MinRowIdx = (RowIdx < MinRowIdx) ? RowIdx : MinRowIdx;
+                MinColIdx = (ColIdx < MinColIdx) ? ColIdx : MinColIdx;
+            }
+        }
+
+        arrangement_key Key;
+        memset(&Key, 0, sizeof(Key));
+        for (s32 CellIdx = 0; CellIdx < NumValidCells; CellIdx++)
+        {
+            const u16 ColBit = (u16)(1u << (TransformedColIdxs[CellIdx] - MinColIdx));
+            Key.ValidCellRows[TransformedRowIdxs[CellIdx] - MinRowIdx] |= ColBit;
+            Key.BlockedCellRows[TransformedRowIdxs[CellIdx] - MinRowIdx] |= IsBlocked[CellIdx] ? ColBit : 0u;
+        }
+
+        if (TransformIdx == 0 || Key < OutKey)
+        {
+            OutKey = Key;
+        }
+    }
+}
+
+void EnumerateArrangements(
+    const grid_tile (&Tiles)[NUM_TILES],
+    const u64 FirstBoardIdx,
+    const u64 MaxBoards,
+    std::vector<board>& OutBoards)
+{
+    // tiles are placed in steps of half a tile
+    constexpr s32 HALF_TILE_SIZE = TILE_SIZE / 2;
+    constexpr s32 NUM_STEPS = (MAX_BOARD_SIZE - TILE_SIZE) / HALF_TILE_SIZE + 1; // positions along each axis
+    constexpr s32 NUM_POSITIONS = NUM_STEPS * NUM_STEPS;
+    static_assert(NUM_TILES * TILE_SIZE * TILE_SIZE == NUM_VALID_CELLS, "the tiles must make up every valid cell");
+
+    // every tile's sides in each rotation, rotating clockwise as in ReduceBySymmetry
+    u8 RotatedHoles[NUM_TILES][2][NUM_ROTATIONS][TILE_SIZE][TILE_SIZE];
+    for (s32 TileIdx = 0; TileIdx < NUM_TILES; TileIdx++)
+    {
+        for (s32 SideIdx = 0; SideIdx < 2; SideIdx++)
+        {
+            memcpy(RotatedHoles[TileIdx][SideIdx][0], Tiles[TileIdx].Holes[SideIdx], sizeof(RotatedHoles[TileIdx][SideIdx][0]));
+            for (s32 RotationIdx = 1; RotationIdx < NUM_ROTATIONS; RotationIdx++)
+            {
+                for (s32 RowIdx = 0; RowIdx < TILE_SIZE; RowIdx++)
+                {
+                    for (s32 ColIdx = 0; ColIdx < TILE_SIZE; ColIdx++)
+                    {
+                        RotatedHoles[TileIdx][SideIdx][RotationIdx][RowIdx][ColIdx] = RotatedHoles[TileIdx][SideIdx][RotationIdx - 1][TILE_SIZE - 1 - ColIdx][RowIdx];
+                    }
+                }
+            }
+        }
+    }
+
+    // tiles can't be mirrored, so a layout and its reflection have different boards. the layouts are grouped by
+    // their shape up to rotation/reflection, keeping one layout of each shape up to rotation, and boards are only
+    // compared with the others of their group (as boards of different shapes can never match)
+    struct tile_layout
+    {
+        s32 StepRowIdxs[NUM_TILES];
+        s32 StepColIdxs[NUM_TILES];
+    };
+
+    struct layout_group
+    {
+        std::vector<arrangement_key> LayoutKeys; // up to rotation, of each layout
+        std::vector<tile_layout> Layouts;
+    };
+
+    auto SetLayoutCells = [&](const tile_layout& Layout, board& OutBoard)
+    {
+        SetCells(OutBoard, cell_value::Invalid);
+        for (s32 PositionIdx = 0; PositionIdx < NUM_TILES; PositionIdx++)
+        {
+            for (s32 RowIdx = 0; RowIdx < TILE_SIZE; RowIdx++)
+            {
+                for (s32 ColIdx = 0; ColIdx < TILE_SIZE; ColIdx++)
+                {
+                    OutBoard.Cells[Layout.StepRowIdxs[PositionIdx] * HALF_TILE_SIZE + RowIdx][Layout.StepColIdxs[PositionIdx] * HALF_TILE_SIZE + ColIdx] = cell_value::Empty;
+                }
+            }
+        }
+    };
+
+    // every set of tile positions, in steps, with the first tile in the top row and a tile in the left column
+    std::map<arrangement_key, layout_group> LayoutGroups;
+    s32 Positions[NUM_TILES] = { 0, 1, 2, 3 };
+    do
+    {
+        tile_layout Layout;
+        s32 MinStepColIdx = NUM_STEPS;
+        for (s32 PositionIdx = 0; PositionIdx < NUM_TILES; PositionIdx++)
+        {
+            Layout.StepRowIdxs[PositionIdx] = Positions[PositionIdx] / NUM_STEPS;
+            Layout.StepColIdxs[PositionIdx] = Positions[PositionIdx] % NUM_STEPS;
+            MinStepColIdx = (Layout.StepColIdxs[PositionIdx] < MinStepColIdx) ? Layout.StepColIdxs[PositionIdx] : MinStepColIdx;
+        }
+        if (Layout.StepRowIdxs[0] != 0 || MinStepColIdx != 0)
+        {
+            continue;
+        }
+
+        // tiles overlap if they're less than a tile apart on both axes, and touch if they're a tile apart on one axis
+        // and at most half a tile apart on the other
+        bool IsOverlapping = false;
+        u32 TouchingBitFlags[NUM_TILES] = {};
+        for (s32 PositionIdx = 0; PositionIdx < NUM_TILES; PositionIdx++)
+        {
+            for (s32 OtherPositionIdx = PositionIdx + 1; OtherPositionIdx < NUM_TILES; OtherPositionIdx++)
+            {
+                const s32 RowDistance = abs(Layout.StepRowIdxs[PositionIdx] - Layout.StepRowIdxs[OtherPositionIdx]);
+                const s32 ColDistance = abs(Layout.StepColIdxs[PositionIdx] - Layout.StepColIdxs[OtherPositionIdx]);
+                IsOverlapping |= (RowDistance < 2 && ColDistance < 2);
+                if ((RowDistance == 2 && ColDistance <= 1) || (ColDistance == 2 && RowDistance <= 1))
+                {
+                    TouchingBitFlags[PositionIdx] |= 1u << OtherPositionIdx;
+                    TouchingBitFlags[OtherPositionIdx] |= 1u << PositionIdx;
+                }
+            }
+        }
+        u32 ConnectedBitFlags = 1u;
+        for (s32 PassIdx = 0; PassIdx < NUM_TILES; PassIdx++)
+        {
+            for (s32 PositionIdx = 0; PositionIdx < NUM_TILES; PositionIdx++)
+            {
+                if (ConnectedBitFlags & (1u << PositionIdx))
+                {
+                    ConnectedBitFlags |= TouchingBitFlags[PositionIdx];
+                }
+            }
+        }
+        if (IsOverlapping || ConnectedBitFlags != (1u << NUM_TILES) - 1u)
+        {
+            continue;
+        }
+
+        board Board;
+        SetLayoutCells(Layout, Board);
+        arrangement_key ShapeKey, LayoutKey;
+        ComputeArrangementKey(Board, 2 * NUM_ROTATIONS, ShapeKey);
+        ComputeArrangementKey(Board, NUM_ROTATIONS, LayoutKey);
+
+        layout_group& Group = LayoutGroups[ShapeKey];
+        if (std::find(Group.LayoutKeys.begin(), Group.LayoutKeys.end(), LayoutKey) == Group.LayoutKeys.end())
+        {
+            Group.LayoutKeys.push_back(LayoutKey);
+            Group.Layouts.push_back(Layout);
+        }
+    }
+    while (NextCombination(Positions, NUM_TILES, NUM_POSITIONS));
+
+    // every choice of tile, side and rotation at each position
+    std::set<arrangement_key> BoardKeys;
+    u64 NumBoards = 0;
+    for (const std::pair<const arrangement_key, layout_group>& Group : LayoutGroups)
+    {
+        BoardKeys.clear();
+        for (const tile_layout& Layout : Group.second.Layouts)
+        {
+            board Board;
+            SetLayoutCells(Layout, Board);
+
+            s32 TileOrder[NUM_TILES] = { 0, 1, 2, 3 };
+            do
+            {
+                for (u32 SideBitFlags = 0; SideBitFlags < (1u << NUM_TILES); SideBitFlags++)
+                {
+                    for (u32 Rotations = 0; Rotations < (1u << (2 * NUM_TILES)); Rotations++)
+                    {
+                        for (s32 PositionIdx = 0; PositionIdx < NUM_TILES; PositionIdx++)
+                        {
+                            const s32 TileIdx = TileOrder[PositionIdx];
+                            const u8 (&Holes)[TILE_SIZE][TILE_SIZE] = RotatedHoles[TileIdx][(SideBitFlags >> TileIdx) & 1u][(Rotations >> (2 * TileIdx)) & 3u];
+                            for (s32 RowIdx = 0; RowIdx < TILE_SIZE; RowIdx++)
+                            {
+                                for (s32 ColIdx = 0; ColIdx < TILE_SIZE; ColIdx++)
+                                {
+                                    Board.Cells[Layout.StepRowIdxs[PositionIdx] * HALF_TILE_SIZE + RowIdx][Layout.StepColIdxs[PositionIdx] * HALF_TILE_SIZE + ColIdx] =
+                                        Holes[RowIdx][ColIdx] ? cell_value::Blocked : cell_value::Empty;
+                                }
+                            }
+                        }
+
+                        arrangement_key BoardKey;
+                        ComputeArrangementKey(Board, 2 * NUM_ROTATIONS, BoardKey);
+                        if (!BoardKeys.insert(BoardKey).second)
+                        {
+                            continue;
+                        }
+
+                        if (NumBoards++ < FirstBoardIdx)
+                        {
+                            continue;
+                        }
+                        OutBoards.push_back(Board);
+                        if (MaxBoards && NumBoards - FirstBoardIdx >= MaxBoards)
+                        {
+                            return;
+                        }
+                    }
+                }
+            }
+            while (std::next_permutation(TileOrder, TileOrder + NUM_TILES));
+        }
+    }
+}
+
+solve_service::solve_service(const solver& InSolver, const solve_options& InOptions, const s32 NumThreads)
+    : Solver(InSolver), Options(InOptions), IsStopping(false)
+{
+    assert(NumThreads >= 1);
+    Options.NumThreads = 1;
+    Options.Control = nullptr;
+    Options.KeepSolutions = false;
+
+    Threads.reserve(NumThreads);
+    for (s32 ThreadIdx = 0; ThreadIdx < NumThreads; ThreadIdx++)
+    {
+        Threads.emplace_back([this]() { RunThread(); });
+    }
+}
+
+solve_service::~solve_service()
+{
+    {
+        std::lock_guard<std::mutex> Lock(QueueLock);
+        IsStopping = true;
+    }
+    QueueChanged.notify_all();
+    for (std::thread& Thread : Threads)
+    {
+        Thread.join();
+    }
+}
+
+void solve_service::Submit(const request& Request)
+{
+    assert(Request.Responder);
+    {
+        std::lock_guard<std::mutex> Lock(QueueLock);
+        Queue.push_back({ Request, std::chrono::steady_clock::now() });
+    }
+    QueueChanged.notify_one();
+}
+
+void solve_service::RunThread()
+{
+    // passes a request's solutions on to its responder as they're found
+    struct responder_solution_sink : solution_sink
+    {
+        const request* Request;
+        s32 NumRows, NumCols;
+
+        bool NeedsSolutions() const override
+        {
+            return true;
+        }
+
+    protected:
+        void OnBeginBoard(const board& InputBoard, const s32 InNumRows, const s32 InNumCols) override
+        {
+            NumRows = InNumRows;
+            NumCols = InNumCols;
+        }
+
+        void OnSolution(const board& Solution) override
+        {
+            Request->Responder->OnSolution(Request->Id, Solution, NumRows, NumCols);
+        }
+    };
+
+    solver::arena Arena;
+    search_control Control;
+    solve_result Result;
+    responder_solution_sink Solutions;
+    std::unique_ptr<solver::hint_session> HintSession;
+    hint_result Hint;
+
+    while (1)
+    {
+        queued_request Queued;
+        {
+            std::unique_lock<std::mutex> Lock(QueueLock);
+            QueueChanged.wait(Lock, [this]() { return IsStopping || !Queue.empty(); });
+            if (Queue.empty())
+            {
+                return;
+            }
+            Queued = Queue.front();
+            Queue.pop_front();
+        }
+        const request& Request = Queued.Request;
+
+        // the searches assume a board's pieces are consistent, so a bad board from one client mustn't reach them
+        std::string BoardError;
+        if (!Solver.CheckBoard(Request.Board, BoardError))
+        {
+            Result = solve_result();
+            Request.Responder->OnResult(Request.Id, Result, BoardError);
+            continue;
+        }
+
+        // the time limit started when the request was submitted, so a request that waited too long isn't searched
+        f64 MaxTimeSec = 0.f;
+        if (Request.MaxTimeSec > 0.f)
+        {
+            const f64 QueuedTimeSec = std::chrono::duration<f64>(std::chrono::steady_clock::now() - Queued.SubmitTime).count();
+            MaxTimeSec = Request.MaxTimeSec - QueuedTimeSec;
+            if (MaxTimeSec <= 0.f)
+            {
+                Result = solve_result();
+                ComputeBoardSize(Request.Board, Result.NumRows, Result.NumCols);
+                Result.Status = search_status::TimeLimitReached;
+                Request.Responder->OnResult(Request.Id, Result, std::string());
+                continue;
+            }
+        }
+
+        Control.MaxTimeSec = MaxTimeSec;
+        Control.MaxBoardStates = Request.MaxBoardStates;
+        Control.MaxSolutions = Request.MaxSolutions;
+
+        if (Request.Hint)
+        {
+            // the session starts from the board's empty layout, so that it can move to any board on the same cells
+            std::string Error;
+            if (!HintSession || HintSession->Answers.size() > MAX_HINT_ANSWERS || !Solver.SetHintBoard(*HintSession, Request.Board, Error))
+            {
+                board StartBoard = Request.Board;
+                for (s32 CellIdx = 0; CellIdx < MAX_BOARD_SIZE * MAX_BOARD_SIZE; CellIdx++)
+                {
+                    cell_value& CellValue = (&StartBoard.Cells[0][0])[CellIdx];
+                    CellValue = IsPiece(CellValue) ? cell_value::Empty : CellValue;
+                }
+
+                HintSession.reset(new solver::hint_session());
+                Error.clear();
+                if (!Solver.BeginHints(StartBoard, Options.Search, Options.Cache, *HintSession, Error) ||
+                    !Solver.SetHintBoard(*HintSession, Request.Board, Error))
+                {
+                    HintSession.reset();
+                    Request.Responder->OnResult(Request.Id, solve_result(), Error);
+                    continue;
+                }
+            }
+
+            Control.MaxSolutions = 0;
+            Solver.QueryHint(*HintSession, &Control, Hint);
+
+            Result = solve_result();
+            ComputeBoardSize(Request.Board, Result.NumRows, Result.NumCols);
+            Result.NumSolutions = Hint.NumSolutions;
+            Result.Status = Hint.Status;
+            Result.ElapsedTimeSec = Hint.ElapsedTimeSec;
+            if (Hint.HasSuggestion)
+            {
+                board Suggestion = Request.Board;
+                for (s32 BallIdx = 0; BallIdx < Hint.Suggestion.NumBalls; BallIdx++)
+                {
+                    Suggestion.Cells[Hint.Suggestion.RowIdxs[BallIdx]][Hint.Suggestion.ColIdxs[BallIdx]] = PieceIndexToCellValue(Hint.Suggestion.PieceIdx);
+                }
+                Request.Responder->OnSuggestion(Request.Id, Suggestion, Result.NumRows, Result.NumCols);
+            }
+            Request.Responder->OnResult(Request.Id, Result, std::string());
+            continue;
+        }
+
+        solve_options RequestOptions = Options;
+        RequestOptions.CountOnly = Request.CountOnly;
+        RequestOptions.Control = &Control;
+
+        Solutions.Request = &Request;
+        std::string Error;
+        if (!Solver.SolveBoard(Request.Board, RequestOptions, Request.CountOnly ? nullptr : &Solutions, Result, Error, &Arena))
+        {
+            Result = solve_result();
+        }
+        Request.Responder->OnResult(Request.Id, Result, Error);
+    }
+}
+
+bool solver::BeginHints(
+    const board& StartBoard,
+    const search_options& Options,
+    solution_cache* Cache,
+    hint_session& OutSession,
+    std::string& OutError) const
+{
+    s32 NumValidCells = 0;
+    for (s32 CellIdx = 0; CellIdx < MAX_BOARD_SIZE * MAX_BOARD_SIZE; CellIdx++)
+    {
+        NumValidCells += ((&StartBoard.Cells[0][0])[CellIdx] != cell_value::Invalid);
+    }
+    if (NumValidCells != NUM_VALID_CELLS)
+    {
+        OutError = "board has " + std::to_string(NumValidCells) + " valid cells, expected " + std::to_string(NUM_VALID_CELLS);
+        return false;
+    }
+
+    s32 NumRows, NumCols;
+    ComputeBoardSize(StartBoard, NumRows, NumCols);
+    BuildBitboardTables(StartBoard, NumRows, NumCols, OutSession.Tables);
+
+    bitboard_task InitialTask;
+    InitializeBitboardTask(StartBoard, NumRows, NumCols, OutSession.Tables, InitialTask);
+
+    OutSession.Board = StartBoard;
+    OutSession.StartBoard = StartBoard;
+    OutSession.Options = &Options;
+    OutSession.Cache = Cache;
+
+    for (s32 RowIdx = 0; RowIdx < MAX_BOARD_SIZE; RowIdx++)
+    {
+        for (s32 ColIdx = 0; ColIdx < MAX_BOARD_SIZE; ColIdx++)
+        {
+            OutSession.CellBitIdxs[RowIdx][ColIdx] = -1;
+        }
+    }
+    for (s32 BitIdx = 0; BitIdx < NUM_VALID_CELLS; BitIdx++)
+    {
+        const cell_ref Cell = OutSession.Tables.BitCells[BitIdx];
+        if (!((OutSession.Tables.InitialOccupiedMask >> BitIdx) & 1u))
+        {
+            OutSession.CellBitIdxs[Cell.RowIdx][Cell.ColIdx] = BitIdx;
+        }
+    }
+
+    OutSession.States.assign(1, { InitialTask.OccupiedMask, InitialTask.RemainingPieceBitFlags });
+    OutSession.Answers.clear();
+    return true;
+}
+
+bool solver::IsHintPlacement(
+    const hint_session& Session,
+    const s32 PieceIdx,
+    const u64 PlacementMask) const
+{
+    // every placement is listed under each cell it covers, so look under its first cell
+    const bitboard_tables& Tables = Session.Tables;
+    const s32 BitIdx = CountTrailingZeros(PlacementMask);
+    for (s32 PlacementIdx = Tables.PlacementOffsets[BitIdx][PieceIdx]; PlacementIdx < Tables.PlacementOffsets[BitIdx][PieceIdx + 1]; PlacementIdx++)
+    {
+        if (Tables.Placements[PlacementIdx] == PlacementMask)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void solver::MoveHintSession(
+    hint_session& Session,
+    const hint_key& Key) const
+{
+    for (size_t StateIdx = 0; StateIdx < Session.States.size(); StateIdx++)
+    {
+        const hint_key& State = Session.States[StateIdx];
+        if (State.OccupiedMask == Key.OccupiedMask && State.RemainingPieceBitFlags == Key.RemainingPieceBitFlags)
+        {
+            Session.States.resize(StateIdx + 1);
+            return;
+        }
+    }
+    Session.States.push_back(Key);
+}
+
+bool solver::PlaceHintPiece(
+    hint_session& Session,
+    const piece_placement& Placement,
+    std::string& OutError) const
+{
+    const hint_key& State = Session.States.back();
+    const s32 PieceIdx = Placement.PieceIdx;
+    if (PieceIdx < 0 || PieceIdx >= NUM_PIECES || !((State.RemainingPieceBitFlags >> PieceIdx) & 1u))
+    {
+        OutError = "piece " + std::to_string(PieceIdx) + " isn't left to place";
+        return false;
+    }
+
+    u64 PlacementMask = 0u;
+    for (s32 BallIdx = 0; BallIdx < Placement.NumBalls && BallIdx < MAX_BALLS; BallIdx++)
+    {
+        const s32 RowIdx = Placement.RowIdxs[BallIdx];
+        const s32 ColIdx = Placement.ColIdxs[BallIdx];
+        const bool IsCell = (RowIdx >= 0) && (RowIdx < MAX_BOARD_SIZE) && (ColIdx >= 0) && (ColIdx < MAX_BOARD_SIZE);
+        const s32 BitIdx = IsCell ? Session.CellBitIdxs[RowIdx][ColIdx] : -1;
+        if (BitIdx < 0 || ((State.OccupiedMask >> BitIdx) & 1u))
+        {
+            OutError = "cell [" + std::to_string(RowIdx) + "][" + std::to_string(ColIdx) + "] isn't empty";
+            return false;
+        }
+        PlacementMask |= (1ull << BitIdx);
+    }
+    if (!PlacementMask || !IsHintPlacement(Session, PieceIdx, PlacementMask))
+    {
+        OutError = "the cells aren't a placement of piece " + std::to_string(PieceIdx);
+        return false;
+    }
+
+    PlaceBitboardPiece(Session.Tables, PieceIdx, PlacementMask, Session.Board);
+    MoveHintSession(Session, { State.OccupiedMask | PlacementMask, (u16)(State.RemainingPieceBitFlags & ~(1u << PieceIdx)) });
+    return true;
+}
+
+bool solver::RemoveHintPiece(
+    hint_session& Session,
+    const s32 PieceIdx,
+    std::string& OutError) const
+{
+    const hint_key& State = Session.States.back();
+    if (PieceIdx < 0 || PieceIdx >= NUM_PIECES || ((State.RemainingPieceBitFlags >> PieceIdx) & 1u))
+    {
+        OutError = "piece " + std::to_string(PieceIdx) + " isn't on the board";
+        return false;
+    }
+
+    const cell_value PieceCellValue = PieceIndexToCellValue(PieceIdx);
+    u64 PlacementMask = 0u;
+    for (s32 RowIdx = 0; RowIdx < MAX_BOARD_SIZE; RowIdx++)
+    {
+        for (s32 ColIdx = 0; ColIdx < MAX_BOARD_SIZE; ColIdx++)
+        {
+            if (Session.Board.Cells[RowIdx][ColIdx] == PieceCellValue && Session.CellBitIdxs[RowIdx][ColIdx] >= 0)
+            {
+                PlacementMask |= (1ull << Session.CellBitIdxs[RowIdx][ColIdx]);
+            }
+        }
+    }
+    if (!PlacementMask)
+    {
+        OutError = "piece " + std::to_string(PieceIdx) + " was on the starting board";
+        return false;
+    }
+
+    for (u64 Mask = PlacementMask; Mask; Mask &= Mask - 1u)
+    {
+        const cell_ref Cell = Session.Tables.BitCells[CountTrailingZeros(Mask)];
+        Session.Board.Cells[Cell.RowIdx][Cell.ColIdx] = cell_value::Empty;
+    }
+    MoveHintSession(Session, { State.OccupiedMask & ~PlacementMask, (u16)(State.RemainingPieceBitFlags | (1u << PieceIdx)) });
+    return true;
+}
+
+bool solver::SetHintBoard(
+    hint_session& Session,
+    const board& Board,
+    std::string& OutError) const
+{
+    const hint_key& StartState = Session.States.front();
+
+    // the cells covered since the start, by piece
+    u64 PlacementMasks[NUM_PIECES] = {};
+    for (s32 RowIdx = 0; RowIdx < MAX_BOARD_SIZE; RowIdx++)
+    {
+        for (s32 ColIdx = 0; ColIdx < MAX_BOARD_SIZE; ColIdx++)
+        {
+            const cell_value CellValue = Board.Cells[RowIdx][ColIdx];
+            const s32 BitIdx = Session.CellBitIdxs[RowIdx][ColIdx];
+            if (BitIdx < 0 && CellValue != Session.StartBoard.Cells[RowIdx][ColIdx])
+            {
+                OutError = "cell [" + std::to_string(RowIdx) + "][" + std::to_string(ColIdx) + "] differs from the starting board";
+                return false;
+            }
+            if (BitIdx >= 0 && CellValue != cell_value::Empty)
+            {
+                if (!IsPiece(CellValue) || !((StartState.RemainingPieceBitFlags >> CellValueToPieceIndex(CellValue)) & 1u))
+                {
+                    OutError = "cell [" + std::to_string(RowIdx) + "][" + std::to_string(ColIdx) + "] was empty on the starting board, and can only be covered by a piece left to place";
+                    return false;
+                }
+                PlacementMasks[CellValueToPieceIndex(CellValue)] |= (1ull << BitIdx);
+            }
+        }
+    }
+
+    hint_key Key = StartState;
+    for (s32 PieceIdx = 0; PieceIdx < NUM_PIECES; PieceIdx++)
+    {
+        if (PlacementMasks[PieceIdx])
+        {
+            if (!IsHintPlacement(Session, PieceIdx, PlacementMasks[PieceIdx]))
+            {
+                OutError = "the cells of piece " + std::to_string(PieceIdx) + " aren't one of its placements";
+                return false;
+            }
+            Key.OccupiedMask |= PlacementMasks[PieceIdx];
+            Key.RemainingPieceBitFlags &= ~(1u << PieceIdx);
+        }
+    }
+
+    Session.Board = Board;
+    MoveHintSession(Session, Key);
+    return true;
+}
+
+void solver::QueryHint(
+    hint_session& Session,
+    search_control* Control,
+    hint_result& OutResult) const
+{
+    const std::chrono::steady_clock::time_point ClockStart = std::chrono::steady_clock::now();
+    const bitboard_tables& Tables = Session.Tables;
+    const hint_key Key = Session.States.back();
+
+    OutResult = hint_result();
+    hint_answer Answer = {};
+    Answer.IsQueried = true;
+
+    const std::map<hint_key, hint_answer>::const_iterator Found = Session.Answers.find(Key);
+    if (Found != Session.Answers.end() && Found->second.IsQueried)
+    {
+        Answer = Found->second;
+        OutResult.IsFromSession = true;
+    }
+    else if (!Key.RemainingPieceBitFlags)
+    {
+        // every piece has been placed, so the board is solved
+        Answer.NumSolutions = 1;
+        Session.Answers[Key] = Answer;
+    }
+    else
+    {
+        cached_search_context Context;
+        Context.InputBoard = &Session.Board;
+        Context.Tables = &Tables;
+        Context.Options = Session.Options;
+        Context.Cache = Session.Cache;
+        Context.OutSolutions = nullptr;
+        Context.Control = Control;
+        Context.NumUncheckedStates = 0;
+        Context.MaxSolutions = 0;
+        Context.NumSolutionsFound = 0;
+        Context.IsStopped = false;
+        Context.NumBoardStatesTested = 0;
+        InitializePieceRanking(Session.Options->PieceOrder, false, Context.PieceRanking);
+
+        if (Control)
+        {
+            Control->Begin();
+        }
+
+        // count the solutions after each placement covering the next cell, so that the best can be suggested. the
+        // counts are kept too, as the next move is likely to be one of them
+        const s32 BitIdx = SelectBitboardCell(Tables, Session.Options->CellOrder, Key.OccupiedMask, Key.RemainingPieceBitFlags);
+        const bool IsDead = (BitIdx < 0) ||
+            (Session.Options->PruneDeadRegions && HasDeadRegion(Tables, Key.OccupiedMask, Key.RemainingPieceBitFlags));
+        for (u32 PieceBitFlags = IsDead ? 0u : Key.RemainingPieceBitFlags; PieceBitFlags && !Context.IsStopped; PieceBitFlags &= PieceBitFlags - 1u)
+        {
+            const s32 PieceIdx = CountTrailingZeros(PieceBitFlags);
+            const u16 PlacementBegin = Tables.PlacementOffsets[BitIdx][PieceIdx];
+            const u16 PlacementEnd = Tables.PlacementOffsets[BitIdx][PieceIdx + 1];
+            const u64* Placements = Tables.Placements.data() + PlacementBegin;
+            for (u64 FreeMask = FindFreePlacements(Placements, PlacementEnd - PlacementBegin, Key.OccupiedMask); FreeMask && !Context.IsStopped; FreeMask &= FreeMask - 1u)
+            {
+                const u64 PlacementMask = Placements[CountTrailingZeros(FreeMask)];
+                const hint_key NextKey = { Key.OccupiedMask | PlacementMask, (u16)(Key.RemainingPieceBitFlags & ~(1u << PieceIdx)) };
+
+                u64 NumNextSolutions;
+                const std::map<hint_key, hint_answer>::const_iterator NextFound = Session.Answers.find(NextKey);
+                if (NextFound != Session.Answers.end())
+                {
+                    NumNextSolutions = NextFound->second.NumSolutions;
+                }
+                else if (!NextKey.RemainingPieceBitFlags)
+                {
+                    NumNextSolutions = 1;
+                }
+                else
+                {
+                    const s32 Depth = NUM_PIECES - CountSetBits(NextKey.RemainingPieceBitFlags);
+                    NumNextSolutions = SearchBitboardCached<false>(Context, NextKey.OccupiedMask, NextKey.RemainingPieceBitFlags, Depth);
+                    if (!Context.IsStopped)
+                    {
+                        hint_answer NextAnswer = {};
+                        NextAnswer.NumSolutions = NumNextSolutions;
+                        Session.Answers[NextKey] = NextAnswer;
+                    }
+                }
+
+                Answer.NumSolutions += NumNextSolutions;
+                if (NumNextSolutions > Answer.NumSuggestionSolutions)
+                {
+                    Answer.HasSuggestion = true;
+                    Answer.SuggestedPieceIdx = (u8)PieceIdx;
+                    Answer.SuggestedMask = PlacementMask;
+                    Answer.NumSuggestionSolutions = NumNextSolutions;
+                }
+            }
+        }
+
+        EndControlledSearch(Control, Context.NumUncheckedStates);
+        OutResult.Status = Control ? Control->GetStatus() : search_status::Complete;
+        if (OutResult.Status == search_status::Complete)
+        {
+            Session.Answers[Key] = Answer;
+        }
+    }
+
+    OutResult.NumSolutions = Answer.NumSolutions;
+    OutResult.HasSuggestion = Answer.HasSuggestion;
+    if (Answer.HasSuggestion)
+    {
+        OutResult.Suggestion.PieceIdx = Answer.SuggestedPieceIdx;
+        OutResult.Suggestion.NumBalls = 0;
+        for (u64 Mask = Answer.SuggestedMask; Mask; Mask &= Mask - 1u)
+        {
+            const cell_ref Cell = Tables.BitCells[CountTrailingZeros(Mask)];
+            OutResult.Suggestion.RowIdxs[OutResult.Suggestion.NumBalls] = Cell.RowIdx;
+            OutResult.Suggestion.ColIdxs[OutResult.Suggestion.NumBalls] = Cell.ColIdx;
+            OutResult.Suggestion.NumBalls++;
+        }
+        OutResult.NumSuggestionSolutions = Answer.NumSuggestionSolutions;
+    }
+    OutResult.ElapsedTimeSec = std::chrono::duration<f64>(std::chrono::steady_clock::now() - ClockStart).count();
+}
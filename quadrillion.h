@@ -0,0 +1,1715 @@
+/*
+    MIT License
+
+    Copyright (c) 2020 George Prosser
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+/*
+    Solver library for Quadrillion puzzle by SmartGames.
+    https://www.smartgamesandpuzzles.com/quadrillion.html
+*/
+
+#ifndef QUADRILLION_H
+#define QUADRILLION_H
+
+#include <cstdio>
+#include <cstdint>
+#include <cassert>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <thread>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef float f32;
+typedef double f64;
+
+constexpr s32 MAX_BOARD_SIZE = 16; // max width/height of a puzzle board
+constexpr s32 NUM_VALID_CELLS = 64; // number of valid cells on a puzzle board (4 * 16)
+constexpr s32 NUM_PIECES = 12; // number of puzzle pieces
+constexpr s32 MAX_PIECE_SIZE = 4; // max horizontal/vertical size of piece
+constexpr s32 MAX_BALLS = 5; // max number of 'balls' that make up a piece
+constexpr s32 NUM_ROTATIONS = 4; // 4 x 90 degree rotations
+
+enum cell_value : u8
+{
+    Empty = 0u,
+    Invalid,
+    Blocked,
+    Piece01,
+    Piece02,
+    Piece03,
+    Piece04,
+    Piece05,
+    Piece06,
+    Piece07,
+    Piece08,
+    Piece09,
+    Piece10,
+    Piece11,
+    Piece12
+};
+
+inline bool IsPiece(const cell_value CellValue)
+{
+    return CellValue >= Piece01 && CellValue <= Piece12;
+}
+
+inline s32 CellValueToPieceIndex(const cell_value CellValue)
+{
+    return (s32) (CellValue - cell_value::Piece01);
+}
+
+inline cell_value PieceIndexToCellValue(const s32 PieceIdx)
+{
+    return (cell_value) (cell_value::Piece01 + PieceIdx);
+}
+
+inline char CellValueToOutputChar(const cell_value CellValue)
+{
+    switch (CellValue)
+    {
+        case cell_value::Invalid:
+            return ' ';
+        case cell_value::Empty: 
+            return '.';
+        case cell_value::Blocked:
+            return '*';
+        case cell_value::Piece01:
+        case cell_value::Piece02:
+        case cell_value::Piece03:
+        case cell_value::Piece04:
+        case cell_value::Piece05:
+        case cell_value::Piece06:
+        case cell_value::Piece07:
+        case cell_value::Piece08:
+        case cell_value::Piece09:
+        case cell_value::Piece10:
+        case cell_value::Piece11:
+        case cell_value::Piece12:
+            return 'A' + CellValueToPieceIndex(CellValue);
+        default:
+            assert(false);
+            return '?';
+    }
+}
+
+inline cell_value InputCharToCellValue(const char InputChar)
+{
+    switch (InputChar)
+    {
+        case ' ':
+            return cell_value::Invalid;
+        case '.':
+            return cell_value::Empty;
+        case '*':
+            return cell_value::Blocked;
+        case 'A':
+        case 'B':
+        case 'C':
+        case 'D':
+        case 'E':
+        case 'F':
+        case 'G':
+        case 'H':
+        case 'I':
+        case 'J':
+        case 'K':
+        case 'L':
+            return PieceIndexToCellValue(InputChar - 'A');
+        default:
+            assert(false);
+            return cell_value::Invalid;
+    }
+}
+
+struct piece_definition
+{
+    u8 Balls[MAX_PIECE_SIZE][MAX_PIECE_SIZE];
+};
+
+// the 12 pieces of the standard Quadrillion set, as in pieces.txt
+constexpr piece_definition STANDARD_PIECES[NUM_PIECES] =
+{
+    { { { 1, 1, 1, 0 }, { 1, 0, 0, 0 }, { 1, 0, 0, 0 }, { 0, 0, 0, 0 } } },
+    { { { 1, 1, 1, 1 }, { 1, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 0, 0, 0 } } },
+    { { { 1, 1, 1, 0 }, { 0, 1, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 0, 0 } } },
+    { { { 1, 1, 1, 1 }, { 0, 1, 0, 0 }, { 0, 0, 0, 0 }, { 0, 0, 0, 0 } } },
+    { { { 1, 0, 0, 0 }, { 1, 1, 1, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 0 } } },
+    { { { 1, 0, 0, 0 }, { 1, 1, 1, 0 }, { 0, 1, 0, 0 }, { 0, 0, 0, 0 } } },
+    { { { 1, 1, 0, 0 }, { 1, 1, 0, 0 }, { 1, 0, 0, 0 }, { 0, 0, 0, 0 } } },
+    { { { 1, 0, 0, 0 }, { 1, 0, 0, 0 }, { 1, 1, 0, 0 }, { 0, 1, 0, 0 } } },
+    { { { 1, 1, 0, 0 }, { 1, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 0, 0, 0 } } },
+    { { { 1, 1, 1, 0 }, { 1, 0, 1, 0 }, { 0, 0, 0, 0 }, { 0, 0, 0, 0 } } },
+    { { { 1, 0, 0, 0 }, { 1, 1, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 0, 0 } } },
+    { { { 1, 0, 0, 0 }, { 1, 1, 0, 0 }, { 0, 1, 1, 0 }, { 0, 0, 0, 0 } } }
+};
+
+constexpr s32 NUM_TILES = 4; // number of grid tiles a board is laid out from
+constexpr s32 TILE_SIZE = 4; // width/height of a grid tile
+
+// a double-sided grid tile, with a 1 for each hole (a blocked cell) on either side
+struct grid_tile
+{
+    u8 Holes[2][TILE_SIZE][TILE_SIZE];
+};
+
+// the 4 tiles of the standard Quadrillion set, as they're laid out in boards.txt
+constexpr grid_tile STANDARD_TILES[NUM_TILES] =
+{
+    { { { { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 1, 1, 0 } }, { { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 0, 1 } } } },
+    { { { { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 1, 0, 1, 0 } }, { { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 1, 0, 0, 1 } } } },
+    { { { { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 0, 1, 0 } }, { { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 1, 0, 0 } } } },
+    { { { { 0, 0, 0, 0 }, { 0, 0, 0, 1 }, { 0, 0, 0, 0 }, { 1, 0, 0, 0 } }, { { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 0, 1, 0 }, { 1, 0, 0, 0 } } } }
+};
+
+struct board
+{
+    cell_value Cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE];
+};
+
+// finds the number of rows and columns up to the last valid cell
+void ComputeBoardSize(const board& Board, s32& OutNumRows, s32& OutNumCols);
+
+void SetCells(board& Board, const cell_value CellValue);
+
+constexpr s32 MAX_BOARD_TEXT_SIZE = MAX_BOARD_SIZE * (MAX_BOARD_SIZE + 1); // chars of a full board, with newlines
+
+// writes the board as text, one line per row, and returns the number of chars written (at most MAX_BOARD_TEXT_SIZE).
+// OutText must have room for MAX_BOARD_TEXT_SIZE chars, as whole rows may be written past the end of a smaller board
+s32 FormatBoard(const board& Board, const s32 NumRows, const s32 NumCols, char* OutText);
+
+void PrintBoard(const board& Board, const s32 NumRows = MAX_BOARD_SIZE, const s32 NumCols = MAX_BOARD_SIZE);
+
+// the valid cells of a board, in row-major order. boards with the same valid cells can share one layout for their
+// packed boards
+struct board_layout
+{
+    u8 ValidCellIdxs[NUM_VALID_CELLS]; // row-major index into board::Cells of each valid cell
+};
+
+// a board stored as the 4-bit cell_value of each of its valid cells, in the order of a board_layout (low nibble first).
+// 8x smaller than a board, for keeping many solutions in memory
+struct packed_board
+{
+    u8 Cells[NUM_VALID_CELLS / 2];
+};
+
+void ComputeBoardLayout(const board& Board, board_layout& OutLayout);
+
+void PackBoard(const board& Board, const board_layout& Layout, packed_board& OutPacked);
+
+// cells that aren't in the layout are set to cell_value::Invalid
+void UnpackBoard(const packed_board& Packed, const board_layout& Layout, board& OutBoard);
+
+// 64-bit FNV-1a
+u64 HashBytes(const void* Data, const size_t Size);
+
+// receives solutions as the search finds them, so they can be written out without keeping them all in memory. on its
+// own, it only counts them
+struct solution_sink
+{
+    u64 NumSolutions = 0; // added since the last BeginBoard
+
+    virtual ~solution_sink() {}
+
+    void BeginBoard(const board& InputBoard, const s32 NumRows, const s32 NumCols)
+    {
+        NumSolutions = 0;
+        OnBeginBoard(InputBoard, NumRows, NumCols);
+    }
+
+    void Add(const board& Solution)
+    {
+        NumSolutions++;
+        OnSolution(Solution);
+    }
+
+    void EndBoard()
+    {
+        OnEndBoard();
+    }
+
+    // false if the sink only counts solutions, so that they needn't be kept for it
+    virtual bool NeedsSolutions() const
+    {
+        return false;
+    }
+
+protected:
+    virtual void OnBeginBoard(const board& InputBoard, const s32 NumRows, const s32 NumCols) {}
+    virtual void OnSolution(const board& Solution) {}
+    virtual void OnEndBoard() {}
+};
+
+// keeps every solution, for searches that have to sort or expand them before passing them on
+struct collecting_solution_sink : solution_sink
+{
+    std::vector<board> Solutions;
+
+    bool NeedsSolutions() const override
+    {
+        return true;
+    }
+
+protected:
+    void OnSolution(const board& Solution) override
+    {
+        Solutions.push_back(Solution);
+    }
+};
+
+void AddSolutions(const std::vector<board>& Solutions, solution_sink& Sink);
+
+// sums a hash of each solution, so that two searches can be checked to find the same set of solutions in any order.
+// every solution is passed on to Next, if there is one
+struct digest_solution_sink : solution_sink
+{
+    solution_sink* Next;
+    board_layout Layout;
+    std::vector<u64> Digests; // one for each board, in the order they were begun
+
+    explicit digest_solution_sink(solution_sink* InNext) : Next(InNext) {}
+
+    bool NeedsSolutions() const override
+    {
+        return true;
+    }
+
+protected:
+    void OnBeginBoard(const board& InputBoard, const s32 NumRows, const s32 NumCols) override
+    {
+        Digests.push_back(0);
+        ComputeBoardLayout(InputBoard, Layout);
+        if (Next)
+        {
+            Next->BeginBoard(InputBoard, NumRows, NumCols);
+        }
+    }
+
+    void OnSolution(const board& Solution) override
+    {
+        packed_board Packed;
+        PackBoard(Solution, Layout, Packed);
+        Digests.back() += HashBytes(&Packed, sizeof(Packed));
+        if (Next)
+        {
+            Next->Add(Solution);
+        }
+    }
+
+    void OnEndBoard() override
+    {
+        if (Next)
+        {
+            Next->EndBoard();
+        }
+    }
+};
+
+// batches writes to a file, which is flushed at the end of each board
+struct buffered_solution_sink : solution_sink
+{
+    static constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+    FILE* File;
+    size_t BufferUsed;
+    char Buffer[BUFFER_SIZE];
+
+    explicit buffered_solution_sink(FILE* OutFile) : File(OutFile), BufferUsed(0) {}
+    ~buffered_solution_sink() override
+    {
+        Flush();
+    }
+
+    bool NeedsSolutions() const override
+    {
+        return true;
+    }
+
+    // returns space for Size bytes at the end of the buffer, writing out the buffer first if it's too full
+    char* Reserve(const size_t Size)
+    {
+        assert(Size <= BUFFER_SIZE);
+        if (BufferUsed + Size > BUFFER_SIZE)
+        {
+            Flush();
+        }
+        return Buffer + BufferUsed;
+    }
+
+    void Flush()
+    {
+        if (BufferUsed)
+        {
+            fwrite(Buffer, 1, BufferUsed, File);
+            BufferUsed = 0;
+        }
+        fflush(File);
+    }
+
+protected:
+    void OnEndBoard() override
+    {
+        Flush();
+    }
+};
+
+// writes each solution as text, in the same format as the input boards, followed by a blank line
+struct text_solution_sink : buffered_solution_sink
+{
+    s32 NumRows = MAX_BOARD_SIZE;
+    s32 NumCols = MAX_BOARD_SIZE;
+
+    explicit text_solution_sink(FILE* OutFile) : buffered_solution_sink(OutFile) {}
+
+protected:
+    void OnBeginBoard(const board& InputBoard, const s32 InNumRows, const s32 InNumCols) override
+    {
+        NumRows = InNumRows;
+        NumCols = InNumCols;
+    }
+
+    void OnSolution(const board& Solution) override
+    {
+        char* Text = Reserve(MAX_BOARD_TEXT_SIZE + 1);
+        const s32 Length = FormatBoard(Solution, NumRows, NumCols, Text);
+        Text[Length] = '\n';
+        BufferUsed += Length + 1;
+    }
+};
+
+// writes fixed-size 32-byte records: for each board, a header with the valid cells (bit n of little-endian u16 m is set
+// if cell [m][n] is valid), then one record per solution holding the 4-bit cell_value of each of the 64 valid cells in
+// row-major order (low nibble first), then a trailer whose first byte is 0xFF followed by the little-endian u64
+// solution count at byte 8. a solution can't start with 0xF, as 0xF isn't a cell_value
+struct binary_solution_sink : buffered_solution_sink
+{
+    static constexpr s32 RECORD_SIZE = sizeof(packed_board);
+
+    board_layout Layout;
+
+    explicit binary_solution_sink(FILE* OutFile) : buffered_solution_sink(OutFile) {}
+
+protected:
+    void OnBeginBoard(const board& InputBoard, const s32 NumRows, const s32 NumCols) override
+    {
+        u8* Record = (u8*)Reserve(RECORD_SIZE);
+        memset(Record, 0, RECORD_SIZE);
+
+        ComputeBoardLayout(InputBoard, Layout);
+        for (s32 ValidCellIdx = 0; ValidCellIdx < NUM_VALID_CELLS; ValidCellIdx++)
+        {
+            const s32 RowIdx = Layout.ValidCellIdxs[ValidCellIdx] / MAX_BOARD_SIZE;
+            const s32 ColIdx = Layout.ValidCellIdxs[ValidCellIdx] % MAX_BOARD_SIZE;
+            Record[RowIdx * 2 + ColIdx / 8] |= (u8)(1u << (ColIdx % 8));
+        }
+        BufferUsed += RECORD_SIZE;
+    }
+
+    void OnSolution(const board& Solution) override
+    {
+        // solution records are packed boards. 0xF isn't a cell_value, so a record can't be mistaken for the trailer
+        PackBoard(Solution, Layout, *(packed_board*)Reserve(RECORD_SIZE));
+        BufferUsed += RECORD_SIZE;
+    }
+
+    void OnEndBoard() override
+    {
+        u8* Record = (u8*)Reserve(RECORD_SIZE);
+        memset(Record, 0, RECORD_SIZE);
+        Record[0] = 0xFF;
+        for (s32 ByteIdx = 0; ByteIdx < 8; ByteIdx++)
+        {
+            Record[8 + ByteIdx] = (u8)(NumSolutions >> (ByteIdx * 8));
+        }
+        BufferUsed += RECORD_SIZE;
+
+        buffered_solution_sink::OnEndBoard();
+    }
+};
+
+// identifies a sub-problem by the shape of its empty cells and the pieces left to place. the empty cells are
+// translated as far up and to the left as possible, so that equal sub-problems match even across different boards
+struct subproblem_key
+{
+    u16 EmptyCellRows[MAX_BOARD_SIZE]; // bit n of row m is set if the translated cell [m][n] is empty
+    u16 RemainingPieceBitFlags;
+
+    bool operator==(const subproblem_key& Other) const
+    {
+        return memcmp(EmptyCellRows, Other.EmptyCellRows, sizeof(EmptyCellRows)) == 0 &&
+            RemainingPieceBitFlags == Other.RemainingPieceBitFlags;
+    }
+};
+
+// fixed-size, set-associative cache of sub-problem solution counts (a count of zero marks a dead sub-problem).
+// when a bucket is full the entry that took the least work to compute is evicted. safe to share between threads
+struct solution_cache
+{
+    struct entry
+    {
+        subproblem_key Key;
+        bool IsValid;
+        u32 NumStatesSearched; // work done to compute the entry, saturated; used to choose which entry to evict
+        u64 NumSolutions;
+    };
+
+    static constexpr s32 NUM_WAYS = 4;
+    static constexpr s32 NUM_LOCKS = 64;
+
+    struct bucket
+    {
+        entry Entries[NUM_WAYS];
+    };
+
+    std::vector<bucket> Buckets;
+    u64 BucketIdxMask;
+    std::mutex Locks[NUM_LOCKS];
+
+    std::atomic<u64> NumHits;
+    std::atomic<u64> NumMisses;
+    std::atomic<u64> NumStores;
+    std::atomic<u64> NumEvictions;
+
+    explicit solution_cache(const size_t MaxBytes);
+
+    bool Lookup(const subproblem_key& Key, u64& OutNumSolutions);
+    void Store(const subproblem_key& Key, const u64 NumSolutions, const u64 NumStatesSearched);
+};
+
+// solved boards kept in a file between runs, so that a board solved before is answered without searching. a board is
+// keyed by the subproblem_key of all its empty cells, under whichever rotation/reflection gives the smallest key, so it
+// matches every board that is the same up to symmetry, blocked cells and the pieces already placed. each entry holds the
+// solution count and the solutions, as the piece on each empty cell (4 bits a cell, in row-major order of the keyed
+// cells). the file is memory-mapped and looked up with a binary search of its sorted entries, so opening it costs the
+// same however many boards it holds. note: the file is little-endian, as with binary_solution_sink
+struct solution_database
+{
+    static constexpr u32 MAGIC = 0x31424451u; // "QDB1"
+    static constexpr u32 VERSION = 1;
+
+    struct file_header
+    {
+        u32 Magic;
+        u32 Version;
+        u64 PieceSetHash; // files built with a different piece set are rejected
+        u64 NumEntries;
+        u64 SolutionDataSize; // bytes of packed solutions, after the entries
+        u64 EntriesChecksum;
+    };
+
+    struct file_entry
+    {
+        subproblem_key Key;
+        u16 NumEmptyCells;
+        u32 Padding;
+        u64 NumSolutions;
+        u64 SolutionDataOffset;
+        u64 SolutionDataChecksum; // checked on each lookup, so a damaged entry is just a miss
+    };
+
+    u64 PieceSetHash;
+
+    // the opened file, mapped read-only
+    const u8* FileData;
+    size_t FileSize;
+    const file_entry* Entries;
+    u64 NumEntries;
+    const u8* SolutionData;
+    u64 SolutionDataSize;
+    std::vector<char> FileCopy; // used instead of a mapping where memory-mapping isn't supported
+
+    // boards added since the file was opened, written out along with it by Write
+    std::vector<file_entry> AddedEntries;
+    std::vector<u8> AddedSolutionData;
+
+    explicit solution_database(const piece_definition (&Pieces)[NUM_PIECES]);
+    ~solution_database();
+
+    solution_database(const solution_database&) = delete;
+    solution_database& operator=(const solution_database&) = delete;
+
+    // maps a database file. a file that doesn't exist opens as an empty database, so that the first run can create it.
+    // returns false, filling in OutError, if the file can't be read or fails its checks
+    bool Open(const std::string& Filename, std::string& OutError);
+    void Close();
+
+    // finds a board in the opened file, and if OutSolutions isn't null decodes its solutions (sorted by their cell
+    // values). safe to call from any number of threads at once, but not at the same time as Add or Write
+    bool Lookup(const board& InputBoard, u64& OutNumSolutions, std::vector<board>* OutSolutions) const;
+
+    // records every solution of a board, to be written out by Write. boards that are already in the database, or have
+    // no empty cells, are ignored
+    void Add(const board& InputBoard, const std::vector<board>& Solutions);
+
+    // writes the opened and added boards to a new file, which then replaces Filename (which may be the opened file)
+    bool Write(const std::string& Filename, std::string& OutError) const;
+};
+
+// order in which the bitboard engine chooses cells to fill
+enum cell_order : u8
+{
+    RowMajor = 0u, // left-to-right, top-to-bottom
+    FewestEmptyNeighbors, // the empty cell with the fewest empty neighbors
+    FewestPlacements // the empty cell that can be covered by the fewest placements of the remaining pieces
+};
+
+// the order the bitboard engine tries the remaining pieces in, at each cell. every remaining piece is still tried, so
+// this changes which solutions are found first (and how soon a limited search stops) rather than the states searched
+// for every solution
+enum piece_order : u8
+{
+    ByIndex = 0u, // in order of piece index
+    LargestFirst, // the pieces with the most balls first, then in order of piece index
+    FailFirst // the pieces whose placements have most often not fit so far in the search first, starting largest first
+};
+
+// a timeline of what each thread spent its time on, written as a Chrome trace (for chrome://tracing or Perfetto).
+// spans can be added from any thread, and a span inside another on the same thread is shown nested under it
+struct trace_recorder
+{
+    struct span
+    {
+        const char* Name; // not copied, so usually a string literal
+        u32 ThreadId; // see GetThreadId
+        f64 BeginSec; // since the recorder was created
+        f64 DurationSec;
+        const char* ArgName; // optional, shown alongside the span
+        u64 ArgValue;
+    };
+
+    const std::chrono::steady_clock::time_point StartTime;
+    std::mutex Lock;
+    std::vector<span> Spans;
+
+    trace_recorder() : StartTime(std::chrono::steady_clock::now())
+    {
+    }
+
+    // the calling thread's id for its spans: small numbers, given out when a thread first asks, and reused once it exits
+    static u32 GetThreadId();
+
+    void Add(
+        const char* Name,
+        const u32 ThreadId,
+        const std::chrono::steady_clock::time_point Begin,
+        const std::chrono::steady_clock::time_point End,
+        const char* ArgName = nullptr,
+        const u64 ArgValue = 0);
+
+    bool Write(const std::string& Filename, std::string& OutError);
+};
+
+// adds a span to the recorder (if there is one) from when the scope is constructed to when it's destroyed. the
+// argument can be filled in at any point before then
+struct trace_scope
+{
+    trace_recorder* Recorder;
+    const char* Name;
+    const char* ArgName = nullptr;
+    u64 ArgValue = 0;
+    u32 ThreadId = 0;
+    std::chrono::steady_clock::time_point Begin;
+
+    trace_scope(trace_recorder* InRecorder, const char* InName) : Recorder(InRecorder), Name(InName)
+    {
+        if (Recorder)
+        {
+            ThreadId = trace_recorder::GetThreadId();
+            Begin = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~trace_scope()
+    {
+        if (Recorder)
+        {
+            Recorder->Add(Name, ThreadId, Begin, std::chrono::steady_clock::now(), ArgName, ArgValue);
+        }
+    }
+
+    trace_scope(const trace_scope&) = delete;
+    trace_scope& operator=(const trace_scope&) = delete;
+};
+
+struct search_options
+{
+    cell_order CellOrder = cell_order::RowMajor;
+    piece_order PieceOrder = piece_order::ByIndex;
+
+    // abandon states with a region of empty cells whose size can't be made from the sizes of the remaining pieces
+    bool PruneDeadRegions = false;
+
+    // if the empty cells of a board are symmetric, only search for solutions with one piece in a canonical placement
+    // and generate the rest by applying the symmetries. solutions are then sorted by their cell values
+    bool UseSymmetry = false;
+
+    // when only counting, count breadth first in at most this many megabytes of states, merging the states that have
+    // the same occupied cells and remaining pieces (see solver::CountSolutions). 0 counts depth first
+    s32 FrontierMemoryMB = 0;
+
+    // optional, records when the bitboard searches build their tables and how long each thread searches for. also
+    // records every solver::SolveBoard, whatever the engine
+    trace_recorder* Trace = nullptr;
+};
+
+// counters gathered while searching, when asked for. each thread keeps its own (aligned to a cache line, so threads
+// never write to the same line) and they are added together once the search is done
+struct alignas(64) search_stats
+{
+    u64 NumBoardStatesTested = 0;
+    u64 NumOrientationsTested = 0;
+    u64 NumBallsTested = 0; // only the grid engine tests balls one at a time
+    u64 NumStatesPruned = 0;
+    u64 NumCacheHits = 0;
+    u64 MaxStackDepth = 0; // most states waiting on the search stack, or the deepest recursion for recursive searches
+
+    void Add(const search_stats& Other)
+    {
+        NumBoardStatesTested += Other.NumBoardStatesTested;
+        NumOrientationsTested += Other.NumOrientationsTested;
+        NumBallsTested += Other.NumBallsTested;
+        NumStatesPruned += Other.NumStatesPruned;
+        NumCacheHits += Other.NumCacheHits;
+        MaxStackDepth = (Other.MaxStackDepth > MaxStackDepth) ? Other.MaxStackDepth : MaxStackDepth;
+    }
+};
+
+// why a search stopped before it had found every solution
+enum search_status : u8
+{
+    Complete = 0u, // the search wasn't stopped, so found every solution
+    Cancelled,
+    TimeLimitReached,
+    StateLimitReached,
+    SolutionLimitReached
+};
+
+// limits on a search, and a way to cancel it from another thread. searches only check for cancellation and the time
+// and state limits every CHECK_INTERVAL board states (on each thread), so can run slightly past them, but never pass
+// on more than MaxSolutions solutions. a control is used by one search at a time, which resets it when it begins, and
+// afterwards says how the search ended
+struct search_control
+{
+    static constexpr u64 CHECK_INTERVAL = 1024;
+
+    // 0 for no limit. the time limit starts when the search begins
+    f64 MaxTimeSec = 0.f;
+    u64 MaxBoardStates = 0;
+    u64 MaxSolutions = 0; // with a search reduced by symmetry, counts the solutions found before expanding them
+
+    std::atomic<bool> IsCancelled;
+    std::atomic<u8> Status;
+    std::atomic<u64> NumBoardStates; // searched so far, counted even without search_stats
+    std::atomic<u64> NumSolutions; // only counted with MaxSolutions, to enforce it
+    std::chrono::steady_clock::time_point Deadline;
+
+    search_control() : IsCancelled(false), Status(search_status::Complete), NumBoardStates(0), NumSolutions(0)
+    {
+    }
+
+    // stops the search at its next check, or any search started afterwards straight away (a cancelled control stays
+    // cancelled). safe to call from any thread
+    void Cancel()
+    {
+        IsCancelled.store(true, std::memory_order_relaxed);
+    }
+
+    search_status GetStatus() const
+    {
+        return (search_status)Status.load(std::memory_order_relaxed);
+    }
+
+    bool IsStopped() const
+    {
+        return GetStatus() != search_status::Complete;
+    }
+
+    // called by the searches: Begin resets the control for a new search, CheckLimits adds the states searched since the
+    // last check and returns true if the search should stop, and TryAddSolution returns false once MaxSolutions have
+    // been added, so that the solution is dropped
+    void Begin();
+    bool CheckLimits(const u64 NumNewBoardStates);
+    bool TryAddSolution();
+
+    // only the first reason a search is stopped for is kept
+    void Stop(const search_status Reason);
+};
+
+// sparse 0/1 matrix for exact cover problems, stored as Knuth's "dancing links": every 1 is a node linked to its
+// neighbors in the same row and column, so covering/uncovering a column (and every row that uses it) only relinks
+// nodes and is undone in exactly the reverse order. node 0 is the root, nodes 1..NumColumns are the column headers
+struct exact_cover_matrix
+{
+    struct node
+    {
+        s32 Left, Right, Up, Down;
+        s32 ColumnIdx; // header node of the node's column
+        s32 RowIdx; // caller-supplied row identifier, -1 for headers
+    };
+
+    std::vector<node> Nodes;
+    std::vector<s32> ColumnSizes; // number of rows with a 1 in each column, indexed by header node
+    s32 NumColumns;
+
+    void Reset(const s32 NewNumColumns);
+
+    // removes a column from the list of columns that must be covered, before any rows are added
+    void RemoveColumn(const s32 ColumnIdx);
+
+    void AddRow(const s32 RowIdx, const s32* ColumnIdxs, const s32 NumColumnIdxs);
+
+    void Cover(const s32 HeaderIdx);
+    void Uncover(const s32 HeaderIdx);
+
+    // the uncovered column with the fewest rows (Knuth's "S heuristic"), or 0 if every column has been covered
+    s32 ChooseColumn() const;
+};
+
+enum search_engine : u8
+{
+    Grid = 0u, // fills cells of a 16x16 cell_value grid
+    Bitboard, // fills bits of a 64-bit occupancy mask
+    ExactCover // dancing links over a cell/piece exact cover matrix
+};
+
+// how solver::SolveBoard solves a board. options that an engine doesn't support are rejected rather than ignored
+struct solve_options
+{
+    search_engine Engine = search_engine::Bitboard;
+    search_options Search; // bitboard engine only, apart from its Trace
+    bool InPlace = false; // grid engine only, see solver::SolveInPlace
+    s32 NumThreads = 1; // bitboard engine only
+    bool DeterministicOrder = false; // with NumThreads > 1, see solver::SolveParallel
+    solution_cache* Cache = nullptr; // single-threaded bitboard engine only, see solver::SolveCached
+    bool CountOnly = false; // single-threaded bitboard engine only, see solver::CountSolutions
+    search_control* Control = nullptr; // optional limits and cancellation, not shared with any other solve at once
+    const solution_database* Database = nullptr; // boards found in it are answered without searching, see solver::SolveBoard
+    bool CollectStats = false;
+    bool KeepSolutions = false; // fill in solve_result::Solutions, not with CountOnly
+};
+
+struct solve_result
+{
+    u64 NumSolutions = 0;
+    search_status Status = search_status::Complete; // if the search was stopped by Control, there may be more solutions
+    bool IsFromDatabase = false; // answered from solve_options::Database without searching
+    s32 NumRows = 0, NumCols = 0; // size of the input board
+    std::vector<board> Solutions; // only filled in with KeepSolutions
+    search_stats Stats; // only filled in with CollectStats
+    f64 ElapsedTimeSec = 0.f;
+};
+
+// returns false if the options can't be used together, with OutError saying why
+bool CheckSolveOptions(const solve_options& Options, std::string& OutError);
+
+// how solver::GenerateBoards makes new puzzles: each candidate is a template board with some of its remaining pieces
+// placed at random, and it's accepted if it has exactly NumSolutions solutions
+struct generate_options
+{
+    u64 NumBoards = 1; // stop once this many boards have been accepted
+    u64 NumSolutions = 1; // eg. 1 for puzzles with a unique solution
+    s32 NumPlacedPieces = 4; // pieces placed on each candidate, on top of any the template already has
+    u64 MaxCandidates = 0; // stop after testing this many candidates, 0 for no limit
+    u64 MaxCandidateStates = 0; // give up on a candidate after searching this many board states, 0 for no limit
+    u64 Seed = 1;
+    s32 NumThreads = 1;
+    search_options Search; // Search.UseSymmetry is ignored, as for solver::CountSolutions
+    solution_cache* Cache = nullptr; // optional, shared by every thread
+};
+
+struct generate_result
+{
+    u64 NumCandidates = 0; // tested, including those rejected below
+    u64 NumAccepted = 0;
+    u64 NumUnplaceable = 0; // the pieces didn't fit on the template
+    u64 NumUnsolvable = 0;
+    u64 NumWrongSolutionCount = 0; // solvable, but with too few or too many solutions
+    u64 NumAbandoned = 0; // hit MaxCandidateStates
+    u64 NumDuplicates = 0; // the same puzzle as an accepted board, up to symmetry and which pieces were placed
+    f64 ElapsedTimeSec = 0.f;
+};
+
+// a piece on a board, as the cells its balls cover
+struct piece_placement
+{
+    s32 PieceIdx = -1;
+    s32 NumBalls = 0;
+    s32 RowIdxs[MAX_BALLS];
+    s32 ColIdxs[MAX_BALLS];
+};
+
+// the answer to solver::QueryHint, about the board a hint session is on
+struct hint_result
+{
+    u64 NumSolutions = 0; // 0 if the board can no longer be solved
+    search_status Status = search_status::Complete; // if stopped, NumSolutions only counts what was searched
+    bool HasSuggestion = false; // false if the board is already solved or can't be solved
+    piece_placement Suggestion; // the placement of the next piece that leaves the most solutions
+    u64 NumSuggestionSolutions = 0;
+    bool IsFromSession = false; // answered from an earlier query of the session, without searching
+    f64 ElapsedTimeSec = 0.f;
+};
+
+struct solver
+{
+private:
+    struct cell_ref
+    {
+        u8 RowIdx, ColIdx;
+    };
+
+    struct piece_orientation
+    {
+        cell_ref Balls[MAX_BALLS];
+    };
+
+    struct search_piece
+    {
+        piece_orientation Orientations[2 * NUM_ROTATIONS];
+        s32 NumOrientations;
+        s32 NumBalls;
+    };
+
+    search_piece SearchPieces[NUM_PIECES];
+
+    struct search_piece_table
+    {
+        search_piece Pieces[NUM_PIECES];
+    };
+
+    // expands each piece into its unique orientations. constexpr, so that the standard set is expanded while compiling
+    static constexpr search_piece_table BuildSearchPieces(const piece_definition (&Pieces)[NUM_PIECES]);
+
+    // per-board tables for the bitboard engine, where each valid cell of the board is mapped onto a bit of a u64
+    struct bitboard_tables
+    {
+        cell_ref BitCells[NUM_VALID_CELLS]; // board cell represented by each bit, in row-major order
+        u64 InitialOccupiedMask; // bits for every cell that isn't empty on the input board
+        u16 PlacementOffsets[NUM_VALID_CELLS][NUM_PIECES + 1]; // range of placements covering each cell, per piece
+        std::vector<u64> Placements;
+
+        // runs of valid cells that are adjacent in a row, used to convert masks back to board rows
+        struct row_segment
+        {
+            u8 BitIdx, NumBits, RowIdx, ColIdx;
+        };
+
+        row_segment RowSegments[NUM_VALID_CELLS];
+        s32 NumRowSegments;
+
+        u64 NeighborMasks[NUM_VALID_CELLS]; // bits of the cells above, below, left and right of each cell
+
+        // rotations/reflections that map the empty cells onto themselves, as the bit each bit is moved to
+        u8 Symmetries[2 * NUM_ROTATIONS][NUM_VALID_CELLS];
+        s32 NumSymmetries; // including the identity
+
+        std::vector<u64> RestrictedPlacements; // scratch for ReduceBySymmetry, kept so its memory is reused
+    };
+
+    // per-board tables for the grid engine
+    struct grid_tables
+    {
+        cell_ref EmptyCells[NUM_VALID_CELLS]; // empty cells of the input board, in row-major order
+        s32 NumEmptyCells;
+
+        // every placement of every piece/orientation/ball covering each empty cell (and only cells that are empty on
+        // the input board), grouped by piece in the order they are tried
+        struct placement
+        {
+            cell_ref Balls[MAX_BALLS];
+        };
+
+        u16 PlacementOffsets[NUM_VALID_CELLS][NUM_PIECES + 1];
+        std::vector<placement> Placements;
+    };
+
+    struct grid_search_state
+    {
+        board Board;
+        u16 RemainingPieceBitFlags : NUM_PIECES;
+        u8 EmptyCellIdx;
+    };
+
+    struct bitboard_search_state
+    {
+        u64 OccupiedMask;
+        u16 RemainingPieceBitFlags;
+        u8 PieceIdx; // piece placed to reach this state
+        u8 Depth; // number of pieces placed to reach this state
+    };
+
+    // a subtree of the bitboard search, along with the placements made to reach it
+    struct bitboard_task
+    {
+        u64 OccupiedMask;
+        u16 RemainingPieceBitFlags;
+        u8 Depth; // number of pieces placed to reach this state
+        u8 PlacedPieceIdxs[NUM_PIECES];
+        u64 PlacedMasks[NUM_PIECES];
+    };
+
+    // shared by the threads of a parallel solve, see solver::SolveParallel
+    struct work_stealing_context;
+
+    // passes solutions on to another sink, one thread at a time
+    struct locked_solution_sink : solution_sink
+    {
+        solution_sink* Sink;
+        std::mutex* Lock;
+
+        bool NeedsSolutions() const override
+        {
+            return Sink->NeedsSolutions();
+        }
+
+    protected:
+        void OnSolution(const board& Solution) override
+        {
+            std::lock_guard<std::mutex> Guard(*Lock);
+            Sink->Add(Solution);
+        }
+    };
+
+    // passes solutions on to another sink until the control's solution limit is reached
+    struct limited_solution_sink : solution_sink
+    {
+        solution_sink* Sink;
+        search_control* Control;
+
+        bool NeedsSolutions() const override
+        {
+            return Sink->NeedsSolutions();
+        }
+
+    protected:
+        void OnSolution(const board& Solution) override
+        {
+            if (Control->TryAddSolution())
+            {
+                Sink->Add(Solution);
+            }
+        }
+    };
+
+    // keeps solutions in a solve_result, as well as passing them on to another sink if there is one
+    struct result_solution_sink : solution_sink
+    {
+        std::vector<board>* Solutions;
+        solution_sink* Sink; // optional
+
+        bool NeedsSolutions() const override
+        {
+            return true;
+        }
+
+    protected:
+        void OnSolution(const board& Solution) override
+        {
+            Solutions->push_back(Solution);
+            if (Sink)
+            {
+                Sink->Add(Solution);
+            }
+        }
+    };
+
+    // the search of one board by any number of threads, set up by BeginParallelSearch. each thread that calls
+    // RunParallelSearch takes tasks until there are none left, and EndParallelSearch gathers up their results
+    struct parallel_search;
+
+    // the order a bitboard search tries pieces in, as the rank of each piece. the pieces of a state are tried in order
+    // by scanning the set bits of RankPieces
+    struct piece_ranking
+    {
+        static constexpr u32 UPDATE_INTERVAL = 1024; // board states between re-ranking, for piece_order::FailFirst
+
+        u8 PieceIdxs[NUM_PIECES]; // piece with each rank
+        u8 Ranks[NUM_PIECES];
+        bool IsByIndex;
+        bool IsAdaptive;
+        bool IsReversed; // for searches that push states on a stack, so search the piece ranked last first
+
+        // placements tested and how many of them didn't fit, per piece, halved each time the pieces are re-ranked so
+        // the ranks follow the current part of the search
+        u32 NumPlacementsTested[NUM_PIECES];
+        u32 NumPlacementsFailed[NUM_PIECES];
+        u32 NumStatesUntilUpdate;
+    };
+
+    // state shared by the recursive calls of a cached bitboard search
+    struct cached_search_context
+    {
+        const board* InputBoard;
+        const bitboard_tables* Tables;
+        const search_options* Options;
+        solution_cache* Cache; // optional
+        solution_sink* OutSolutions; // if null, solutions are only counted
+        search_control* Control; // optional
+        u64 NumUncheckedStates; // searched since the control's limits were last checked
+        u64 MaxSolutions; // search stops once this many solutions are found, 0 for no limit
+        u64 NumSolutionsFound;
+        bool IsStopped;
+        u8 PlacedPieceIdxs[NUM_PIECES];
+        u64 PlacedMasks[NUM_PIECES];
+        u64 NumBoardStatesTested; // always counted, as it is used to choose which cache entries to evict
+        piece_ranking PieceRanking;
+        search_stats Stats;
+    };
+
+    // a state of a breadth-first count, reached by NumWays different placements of the pieces placed so far
+    struct frontier_state
+    {
+        u64 OccupiedMask;
+        u64 NumWays;
+        u16 RemainingPieceBitFlags;
+    };
+
+    // the states being expanded and the states they lead to, each split into buckets by a hash of the state so that
+    // equal states are always in the same bucket (see solver::RunFrontierCount)
+    struct frontier_buffers
+    {
+        static constexpr s32 NUM_BUCKET_BITS = 8;
+        static constexpr s32 NUM_BUCKETS = 1 << NUM_BUCKET_BITS;
+
+        std::vector<frontier_state> Layers[2][NUM_BUCKETS];
+        std::vector<u32> Slots; // hash table for merging one bucket
+    };
+
+    // a row of the exact cover matrix: one placement of a piece, covering the cells of its balls
+    struct exact_cover_row
+    {
+        cell_ref Balls[MAX_BALLS];
+        u8 PieceIdx;
+    };
+
+    struct exact_cover_context
+    {
+        const board* InputBoard;
+        exact_cover_matrix Matrix;
+        std::vector<exact_cover_row> Rows;
+        solution_sink* OutSolutions;
+        search_control* Control; // optional
+        u64 NumUncheckedStates;
+        bool IsStopped;
+        s32 ChosenRowIdxs[NUM_PIECES];
+        search_stats Stats;
+    };
+
+    // a state of a hint session: the pieces placed on its bitboard
+    struct hint_key
+    {
+        u64 OccupiedMask;
+        u16 RemainingPieceBitFlags;
+
+        bool operator<(const hint_key& Other) const
+        {
+            return (OccupiedMask != Other.OccupiedMask) ? (OccupiedMask < Other.OccupiedMask) : (RemainingPieceBitFlags < Other.RemainingPieceBitFlags);
+        }
+    };
+
+    // everything a hint session has counted for a state. the suggestion is only known for states that were queried,
+    // rather than only counted as a possible next move
+    struct hint_answer
+    {
+        u64 NumSolutions;
+        bool HasSuggestion; // whether the suggestion was looked for, and was found
+        bool IsQueried;
+        u8 SuggestedPieceIdx;
+        u64 SuggestedMask;
+        u64 NumSuggestionSolutions;
+    };
+
+public:
+    // scratch memory for the searches, kept between calls so that it only grows to the most any board has needed.
+    // when a null arena is passed in, each thread uses an arena of its own (shared by every solver on that thread), so
+    // a solve mustn't be started from a sink's callbacks without passing in a separate arena
+    struct arena
+    {
+        grid_tables GridTables;
+        std::vector<grid_search_state> GridSearchStates;
+        bitboard_tables BitboardTables;
+        std::vector<bitboard_search_state> BitboardSearchStates;
+        collecting_solution_sink ReducedSolutions; // solutions of a search reduced by symmetry, before expanding them
+        exact_cover_context ExactCover;
+        frontier_buffers Frontier;
+        std::vector<arena> HelperArenas; // for the other threads of a parallel solve started with this arena
+    };
+
+    // a board being filled in one move at a time, as by a player asking for hints (see solver::BeginHints). the tables
+    // are built once for the starting board, so a move only changes the occupied cells and remaining pieces, and every
+    // state's count is kept so that going back to an earlier state, or on to a state that was counted as a possible
+    // next move, doesn't search again
+    struct hint_session
+    {
+        board Board; // the current board
+        board StartBoard; // its pieces can't be removed
+        const search_options* Options = nullptr;
+        solution_cache* Cache = nullptr;
+        bitboard_tables Tables;
+        s32 CellBitIdxs[MAX_BOARD_SIZE][MAX_BOARD_SIZE]; // bit of each cell in the tables, or -1 if it's not empty on the starting board
+        std::vector<hint_key> States; // the states moved through since the start, ending with the current state
+        std::map<hint_key, hint_answer> Answers; // only complete counts
+    };
+
+private:
+    // the arena passed in, or the calling thread's arena if that is null
+    static arena& ResolveArena(arena* Arena);
+
+    // resets the control (if there is one) for a new search, and returns the sink the search should pass its solutions
+    // to: OutSolutions, or LimitedSolutions wrapped around it if the control limits the number of solutions
+    static solution_sink& BeginControlledSearch(
+        search_control* Control,
+        solution_sink& OutSolutions,
+        limited_solution_sink& LimitedSolutions);
+
+    // answers SolveBoard from its options' database, honouring the control as a search would. returns false if the
+    // board isn't in the database
+    bool SolveFromDatabase(
+        const board& InputBoard,
+        const s32 NumRows,
+        const s32 NumCols,
+        const solve_options& Options,
+        solution_sink* OutSolutions,
+        solve_result& OutResult) const;
+
+    // sub-problems with fewer pieces than this to place are cheaper to search than to look up. on one pass over
+    // boards.txt about 2% of lookups hit at any threshold, and 6 or 10 pieces were no faster than 8 (see README)
+    static constexpr s32 MIN_CACHED_PIECES = 8;
+
+    // layers of the frontier count with fewer states than this (1.5 MB of them) are always counted breadth first,
+    // as they mostly stay in the cache (measured on boards.txt, see solver::RunFrontierCount)
+    static constexpr size_t MIN_FRONTIER_CHECKED_STATES = 1u << 16;
+
+    void BuildBitboardTables(
+        const board& InputBoard,
+        const s32 NumRows,
+        const s32 NumCols,
+        bitboard_tables& OutTables) const;
+
+    void InitializeBitboardTask(
+        const board& InputBoard,
+        const s32 NumRows,
+        const s32 NumCols,
+        const bitboard_tables& Tables,
+        bitboard_task& OutTask) const;
+
+    void InitializePieceRanking(
+        const piece_order PieceOrder,
+        const bool IsReversed,
+        piece_ranking& OutRanking) const;
+
+    void UpdatePieceRanking(piece_ranking& Ranking) const;
+
+    // returns the bits of PieceBitFlags moved to the ranks of their pieces
+    u32 RankPieces(
+        const piece_ranking& Ranking,
+        const u32 PieceBitFlags) const;
+
+    // returns the empty cell to fill next in the given order, or -1 if the state has no solutions because there are
+    // no empty cells left or (with FewestPlacements) one of them can't be filled
+    s32 SelectBitboardCell(
+        const bitboard_tables& Tables,
+        const cell_order CellOrder,
+        const u64 OccupiedMask,
+        const u16 RemainingPieceBitFlags) const;
+
+    // SelectBitboardCell for the orders other than row-major, on a board with at least one empty cell
+    s32 SelectBestBitboardCell(
+        const bitboard_tables& Tables,
+        const cell_order CellOrder,
+        const u64 OccupiedMask,
+        const u16 RemainingPieceBitFlags) const;
+
+    template <bool COLLECT_STATS>
+    void SearchBitboardTask(
+        const board& InputBoard,
+        const bitboard_tables& Tables,
+        const search_options& Options,
+        const bitboard_task& Task,
+        work_stealing_context* Context,
+        const s32 ThreadIdx,
+        search_control* Control,
+        solution_sink& OutSolutions,
+        search_stats& OutStats,
+        arena& Arena) const;
+
+    bool HasDeadRegion(
+        const bitboard_tables& Tables,
+        const u64 OccupiedMask,
+        const u16 RemainingPieceBitFlags) const;
+
+    // returns the piece whose placements were restricted, or -1 if the board has no symmetries
+    s32 ReduceBySymmetry(
+        bitboard_tables& Tables,
+        const u16 RemainingPieceBitFlags) const;
+
+    u64 ApplyBitboardSymmetry(
+        const bitboard_tables& Tables,
+        const s32 SymmetryIdx,
+        u64 Mask) const;
+
+    // also sorts the solutions, keeping the first MaxSolutions of them (0 for all)
+    void ExpandSymmetricSolutions(
+        const bitboard_tables& Tables,
+        const u64 MaxSolutions,
+        std::vector<board>& Solutions) const;
+
+    void PlaceBitboardPiece(
+        const bitboard_tables& Tables,
+        const s32 PieceIdx,
+        u64 PlacementMask,
+        board& Board) const;
+
+    // whether the mask is one of the piece's placements on the session's starting board
+    bool IsHintPlacement(
+        const hint_session& Session,
+        const s32 PieceIdx,
+        const u64 PlacementMask) const;
+
+    // goes back to the state if it was moved through before, forgetting the moves since, and otherwise moves on to it
+    void MoveHintSession(
+        hint_session& Session,
+        const hint_key& Key) const;
+
+    void ComputeSubproblemKey(
+        const bitboard_tables& Tables,
+        const u64 OccupiedMask,
+        const u16 RemainingPieceBitFlags,
+        subproblem_key& OutKey) const;
+
+    template <bool COLLECT_STATS>
+    u64 SearchBitboardCached(
+        cached_search_context& Context,
+        const u64 OccupiedMask,
+        const u16 RemainingPieceBitFlags,
+        const s32 Depth) const;
+
+    void RunCachedSearch(
+        cached_search_context& Context,
+        const bitboard_task& InitialTask,
+        search_stats* OutStats) const;
+
+    // counts the solutions a piece at a time, expanding every state with the same number of pieces placed before any
+    // with more, so that equal states can be merged (a bucket at a time, see frontier_buffers). falls back on
+    // counting depth first from each state once the states take more than MaxBytes
+    void RunFrontierCount(
+        cached_search_context& Context,
+        const bitboard_task& InitialTask,
+        const size_t MaxBytes,
+        frontier_buffers& Frontier,
+        search_stats* OutStats) const;
+
+    template <bool COLLECT_STATS>
+    void SearchExactCover(
+        exact_cover_context& Context,
+        const s32 Depth) const;
+
+    void BuildGridTables(
+        const board& InputBoard,
+        const s32 NumRows,
+        const s32 NumCols,
+        grid_tables& OutTables) const;
+
+    // if OutSolutions is null the solutions are always collected, otherwise only when they have to be sorted/expanded
+    void BeginParallelSearch(
+        const board& InputBoard,
+        const s32 NumRows,
+        const s32 NumCols,
+        const search_options& Options,
+        const bool DeterministicOrder,
+        const bool CollectStats,
+        search_control* Control,
+        solution_sink* OutSolutions,
+        const s32 ThreadIdx,
+        arena& Arena,
+        parallel_search& Search) const;
+
+    void RunParallelSearch(
+        parallel_search& Search,
+        const s32 ThreadIdx,
+        arena& Arena) const;
+
+    // must only be called once every thread has returned from RunParallelSearch. OutSolutions is only filled in if the
+    // solutions were collected
+    void EndParallelSearch(
+        parallel_search& Search,
+        std::vector<board>& OutSolutions,
+        search_stats* OutStats) const;
+
+    // index of the first ball of the placement whose cell isn't empty, or NUM_BALLS if they all are. the ball count is
+    // a template argument (see DispatchNumBalls) so that the loop has a fixed trip count
+    template <s32 NUM_BALLS>
+    static s32 FindFilledBall(
+        const board& Board,
+        const grid_tables::placement& Placement);
+
+    // tries each placement of a piece with NUM_BALLS balls in [PlacementBegin, PlacementEnd), pushing a state for
+    // each that fits
+    template <bool COLLECT_STATS, s32 NUM_BALLS>
+    void TryGridPlacements(
+        const grid_search_state& SearchState,
+        const grid_tables& Tables,
+        const s32 PieceIdx,
+        const u32 PlacementBegin,
+        const u32 PlacementEnd,
+        const bool IsLastPiece,
+        std::vector<grid_search_state>& SearchStates,
+        solution_sink& OutSolutions,
+        search_stats& Stats) const;
+
+    // the last placement in [PlacementBegin, PlacementEnd) of a piece with NUM_BALLS balls that fits on the board, or -1
+    // if none of them do
+    template <bool COLLECT_STATS, s32 NUM_BALLS>
+    s32 FindGridPlacement(
+        const board& Board,
+        const grid_tables& Tables,
+        const s32 PlacementBegin,
+        const s32 PlacementEnd,
+        search_stats& Stats) const;
+
+    template <bool COLLECT_STATS>
+    void SolveGrid(
+        const board& InputBoard,
+        const s32 NumRows,
+        const s32 NumCols,
+        search_control* Control,
+        solution_sink& OutSolutions,
+        search_stats& OutStats,
+        arena& Arena) const;
+
+    template <bool COLLECT_STATS>
+    void SolveGridInPlace(
+        const board& InputBoard,
+        const s32 NumRows,
+        const s32 NumCols,
+        search_control* Control,
+        solution_sink& OutSolutions,
+        search_stats& OutStats,
+        arena& Arena) const;
+
+public:
+    // once initialized, a solver is never modified by a solve: every solve function is const and keeps its state in
+    // an arena, so a single solver can be shared by any number of threads
+    // a default solver uses STANDARD_PIECES
+    solver();
+    explicit solver(const piece_definition (&Pieces)[NUM_PIECES])
+    {
+        Initialize(Pieces);
+    }
+
+    void Initialize(const piece_definition (&Pieces)[NUM_PIECES]);
+
+    // checks that every piece on the board covers as many cells as it has balls, in one of its orientations, and that
+    // the remaining pieces have as many balls as there are empty cells. the searches assume both, so boards from
+    // outside should be checked first. on failure, OutError says which is wrong, eg. "piece A covers 8 cells, expected 3"
+    bool CheckBoard(const board& Board, std::string& OutError) const;
+
+    // note: counters are only gathered if OutStats isn't null. the search is compiled separately for each case, so
+    // there is no cost when they aren't wanted
+    // Control is optional as well, and can stop a search part of the way through (see search_control). the solutions
+    // found up to that point are still passed on
+
+    void Solve(
+        const board& InputBoard,
+        const s32 NumRows,
+        const s32 NumCols,
+        search_control* Control,
+        solution_sink& OutSolutions,
+        search_stats* OutStats,
+        arena* Arena) const;
+
+    // same search as Solve, but fills a single board in place and undoes each placement when backtracking, rather
+    // than copying the whole board for every search state
+    void SolveInPlace(
+        const board& InputBoard,
+        const s32 NumRows,
+        const s32 NumCols,
+        search_control* Control,
+        solution_sink& OutSolutions,
+        search_stats* OutStats,
+        arena* Arena) const;
+
+    void SolveBitboard(
+        const board& InputBoard,
+        const s32 NumRows,
+        const s32 NumCols,
+        const search_options& Options,
+        search_control* Control,
+        solution_sink& OutSolutions,
+        search_stats* OutStats,
+        arena* Arena) const;
+
+    // bitboard search split across threads; with DeterministicOrder the solutions are sorted by their cell values,
+    // otherwise they are passed to OutSolutions as they're found, from any of the threads (one at a time). the threads
+    // are started for each call, but the arenas of the other threads are kept in the calling thread's arena, so they
+    // only grow to the most any board has needed
+    void SolveParallel(
+        const board& InputBoard,
+        const s32 NumRows,
+        const s32 NumCols,
+        const search_options& Options,
+        const s32 NumThreads,
+        const bool DeterministicOrder,
+        search_control* Control,
+        solution_sink& OutSolutions,
+        search_stats* OutStats,
+        arena* Arena) const;
+
+    // bitboard search that skips sub-problems already known (through Cache) to have no solutions, and records the
+    // solution counts of the sub-problems it searches. the cache can be shared between boards
+    void SolveCached(
+        const board& InputBoard,
+        const s32 NumRows,
+        const s32 NumCols,
+        const search_options& Options,
+        solution_cache& Cache,
+        search_control* Control,
+        solution_sink& OutSolutions,
+        search_stats* OutStats,
+        arena* Arena) const;
+
+    // solves the board as an exact cover problem with Knuth's dancing links (Algorithm X), always branching on the
+    // cell or piece with the fewest remaining ways to cover it
+    void SolveExactCover(
+        const board& InputBoard,
+        const s32 NumRows,
+        const s32 NumCols,
+        search_control* Control,
+        solution_sink& OutSolutions,
+        search_stats* OutStats,
+        arena* Arena) const;
+
+    struct batch_result
+    {
+        u64 NumSolutions = 0;
+        search_stats Stats; // only filled in if CollectStats
+        f64 ElapsedTimeSec = 0.f; // from the board being taken by a thread to its search finishing
+    };
+
+    // solves many boards with the bitboard engine, handing whole boards out to NumThreads threads as they become free.
+    // once there are no boards left to hand out, threads that run out of work join in on the boards that are still
+    // being searched, so only long-running boards end up split across threads. solutions are passed to OutSolutions
+    // in input order, between BeginBoard/EndBoard calls for each board, with DeterministicOrder as for SolveParallel.
+    // note: batches can't be limited or cancelled
+    void SolveBatch(
+        const std::vector<board>& InputBoards,
+        const search_options& Options,
+        const s32 NumThreads,
+        const bool DeterministicOrder,
+        const bool CollectStats,
+        solution_sink& OutSolutions,
+        std::vector<batch_result>& OutResults) const;
+
+    // counts solutions without building them, stopping early once the control's MaxSolutions have been found, eg. a
+    // limit of 1 just tests whether the board is solvable. Cache is optional. note: Options.UseSymmetry is ignored, as
+    // the solutions of a reduced search would have to be enumerated to count them. with Options.FrontierMemoryMB the
+    // count is breadth first, unless the control limits the number of solutions (which a breadth-first count only
+    // knows once it's finished)
+    u64 CountSolutions(
+        const board& InputBoard,
+        const s32 NumRows,
+        const s32 NumCols,
+        const search_options& Options,
+        solution_cache* Cache,
+        search_control* Control,
+        search_stats* OutStats,
+        arena* Arena) const;
+
+    // solves a board with whichever of the functions above the options choose, timing the search. solutions are
+    // passed to OutSolutions (between BeginBoard/EndBoard calls made here) if it isn't null, except with CountOnly.
+    // with a null arena this is safe to call from any number of threads at once. a board found in Options.Database is
+    // answered from it without searching (its solutions sorted by their cell values). returns false, filling in
+    // OutError, if the options fail CheckSolveOptions
+    bool SolveBoard(
+        const board& InputBoard,
+        const solve_options& Options,
+        solution_sink* OutSolutions,
+        solve_result& OutResult,
+        std::string& OutError,
+        arena* Arena) const;
+
+    // makes puzzles from the template boards, passing each accepted board to OutBoards (as the single solution
+    // between its own BeginBoard/EndBoard calls, so a text_solution_sink writes them in the board file format). the
+    // threads test candidates at once, each counting its candidate's solutions only up to one more than wanted, so a
+    // candidate with too many is given up on as soon as that's known. candidate n is always made the same way from
+    // Options.Seed, but with more than one thread the boards are accepted (and passed on) in whichever order they're
+    // found. returns false, filling in OutError, if the options can't be used
+    bool GenerateBoards(
+        const std::vector<board>& Templates,
+        const generate_options& Options,
+        solution_sink& OutBoards,
+        generate_result& OutResult,
+        std::string& OutError) const;
+
+    // starts a hint session on the board, which is the starting point for the moves made by PlaceHintPiece,
+    // RemoveHintPiece and SetHintBoard. the options (only the cell order, piece order and pruning are used) and the
+    // cache, which is optional and can be shared with other searches, must outlive the session. returns false if the
+    // board doesn't have NUM_VALID_CELLS valid cells
+    bool BeginHints(
+        const board& StartBoard,
+        const search_options& Options,
+        solution_cache* Cache,
+        hint_session& OutSession,
+        std::string& OutError) const;
+
+    // returns false, leaving the session as it was, if the piece has already been placed or the placement doesn't fit
+    bool PlaceHintPiece(
+        hint_session& Session,
+        const piece_placement& Placement,
+        std::string& OutError) const;
+
+    // removes a piece placed since the start of the session. taking back the last move goes back to the previous state
+    bool RemoveHintPiece(
+        hint_session& Session,
+        const s32 PieceIdx,
+        std::string& OutError) const;
+
+    // moves the session to any board with the same cells as the starting board, except for empty cells that may since
+    // have been covered. returns false if the board has different cells, or removes the starting board's pieces
+    bool SetHintBoard(
+        hint_session& Session,
+        const board& Board,
+        std::string& OutError) const;
+
+    // counts the solutions of the session's current board, and of the board after each placement that covers the next
+    // cell to fill (chosen by the session's cell order), suggesting the placement that leaves the most solutions. only
+    // the control's time and state limits and cancellation apply, as every solution has to be counted
+    void QueryHint(
+        hint_session& Session,
+        search_control* Control,
+        hint_result& OutResult) const;
+};
+
+// solves boards sent one at a time to a long-lived program, such as a server, so that the solver and cache are only
+// set up once. requests are queued and solved in the order they're submitted, by a pool of threads that each keep their
+// own arena and solve one request at a time
+struct solve_service
+{
+    // receives the answers to requests, on the service's threads. a request's solutions all come before its result,
+    // but the calls for different requests can come from different threads at once
+    struct responder
+    {
+        virtual ~responder() {}
+        virtual void OnSolution(const u64 RequestId, const board& Solution, const s32 NumRows, const s32 NumCols) {}
+
+        // for a hint request, the board with the suggested piece placed (see solver::QueryHint). not called if there's
+        // no suggestion, as when the board is already solved or can't be solved
+        virtual void OnSuggestion(const u64 RequestId, const board& Suggestion, const s32 NumRows, const s32 NumCols) {}
+
+        // Error is empty unless the request couldn't be solved, eg. because its options can't be used together
+        virtual void OnResult(const u64 RequestId, const solve_result& Result, const std::string& Error) = 0;
+    };
+
+    struct request
+    {
+        u64 Id = 0; // passed back to the responder, not otherwise used
+        board Board;
+        bool CountOnly = false;
+        bool Hint = false; // count the solutions and suggest the next placement, instead of solving
+        u64 MaxSolutions = 0; // 0 for no limit, not used for hints
+        u64 MaxBoardStates = 0;
+        f64 MaxTimeSec = 0.f; // from when the request is submitted, so includes the time it waits in the queue
+        responder* Responder = nullptr;
+    };
+
+    // Options are used for every request except for their control (each request has its own limits) and number of
+    // threads (each request is solved on one thread). the solver, and any cache or database in Options, must outlive
+    // the service. each thread keeps a hint session for the last layout of cells it gave hints for, so hints for a
+    // board that is being filled in (or taken apart) move the session along rather than start again
+    solve_service(const solver& InSolver, const solve_options& InOptions, const s32 NumThreads);
+
+    // solves every request that has been submitted before returning
+    ~solve_service();
+
+    // boards that fail solver::CheckBoard are answered with an error rather than searched
+    void Submit(const request& Request);
+
+private:
+    struct queued_request
+    {
+        request Request;
+        std::chrono::steady_clock::time_point SubmitTime;
+    };
+
+    // a thread's hint session is started again once it holds this many answers, to bound its memory
+    static constexpr size_t MAX_HINT_ANSWERS = 1u << 20;
+
+    void RunThread();
+
+    const solver& Solver;
+    solve_options Options;
+    std::mutex QueueLock;
+    std::condition_variable QueueChanged;
+    std::deque<queued_request> Queue;
+    bool IsStopping;
+    std::vector<std::thread> Threads;
+};
+
+// reads the whole file at once and parses it, splitting large files at blank lines to parse the pieces in parallel.
+// each board is also checked against the solver's pieces (see solver::CheckBoard). on failure, OutError describes the
+// first malformed board, eg. "boards.txt:12: row has more than 16 cells"
+bool LoadBoards(const std::string& Filename, const solver& Solver, std::vector<board>& OutBoards, std::string& OutError);
+
+// parses a single board, in the same format as a board file (trailing blank lines are allowed), eg. for a board sent to
+// a service. on failure, OutError describes the problem, eg. "line 3: unexpected character 'x' in column 5"
+bool ParseBoard(const std::string& Text, const solver& Solver, board& OutBoard, std::string& OutError);
+
+// piece definitions are NUM_PIECES grids of MAX_PIECE_SIZE x MAX_PIECE_SIZE 0s and 1s (1 for a ball), separated by
+// whitespace. on failure, OutError says which piece is malformed
+bool ParsePieces(const char* Text, piece_definition (&OutPieces)[NUM_PIECES], std::string& OutError);
+bool LoadPieces(const std::string& Filename, piece_definition (&OutPieces)[NUM_PIECES], std::string& OutError);
+
+// lays the tiles out in every legal arrangement: each tile is used once, on either side and in any rotation, and the
+// tiles are placed on a grid of half a tile with each one sharing at least half an edge with another, as in the
+// physical puzzle. boards that are the same up to rotation/reflection are only counted once. the arrangements come in
+// the same order every time, and boards FirstBoardIdx onwards are added until MaxBoards have been (0 for no limit).
+// note: the standard tiles have about 9 million arrangements, so they're best taken a slice at a time
+void EnumerateArrangements(
+    const grid_tile (&Tiles)[NUM_TILES],
+    const u64 FirstBoardIdx,
+    const u64 MaxBoards,
+    std::vector<board>& OutBoards);
+
+// the bitboard engine's placement test: sets bit n of the result if Placements[n] doesn't overlap OccupiedMask.
+// NumPlacements can be at most 64, and up to 7 masks past the end may be read. the search uses the widest version the
+// compiler targets; they're all declared here for the benchmarks
+u64 FindFreePlacementsScalar(const u64* Placements, const s32 NumPlacements, const u64 OccupiedMask);
+#if defined(__AVX2__)
+u64 FindFreePlacementsAVX2(const u64* Placements, const s32 NumPlacements, const u64 OccupiedMask);
+#endif
+#if defined(__AVX512F__)
+u64 FindFreePlacementsAVX512(const u64* Placements, const s32 NumPlacements, const u64 OccupiedMask);
+#endif
+
+#endif // QUADRILLION_H
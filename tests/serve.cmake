@@ -0,0 +1,17 @@
+# sends the requests in INPUT to QUADRILLION --serve on stdin, and checks that the answers match every regular
+# expression in EXPECTED (a ;-separated list)
+execute_process(
+    COMMAND ${QUADRILLION} --serve --engine=bitboard
+    INPUT_FILE ${INPUT}
+    OUTPUT_VARIABLE Answers
+    RESULT_VARIABLE Result)
+message("${Answers}")
+
+if(NOT Result EQUAL 0)
+    message(FATAL_ERROR "--serve exited with ${Result}")
+endif()
+foreach(Expected IN LISTS EXPECTED)
+    if(NOT Answers MATCHES "${Expected}")
+        message(FATAL_ERROR "no answer matches '${Expected}'")
+    endif()
+endforeach()